@@ -0,0 +1,293 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include "PerfCounters.h"
+
+#include <lb/encoding/base64.h>
+#include <lb/encoding/base64stream.h>
+#include <lb/encoding/bits.h>
+#include <lb/encoding/hex.h>
+#include <lb/encoding/sha1.h>
+#include <lb/encoding/websocket.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <sched.h>
+#include <x86intrin.h>
+
+
+// Throughput of every codec over input sizes from 16 B to 64 MiB.
+//
+// Each benchmark pins itself to one CPU for its duration, the one it starts
+// on or the one named by the environment variable LB_ENCODING_BENCH_CPU, so
+// that migrations do not add noise.
+//
+// Hardware counters are read around the timed loop where the PMU allows,
+// see PerfCounters.h, giving cycles_per_byte, ipc, and branch, L1D and LLC
+// misses per byte to tell front end, branch and memory bound code apart.
+// Without them cycles_per_byte falls back to the time stamp counter, which
+// on modern x86 ticks at a constant rate rather than the current core clock,
+// so is only a comparison between runs on the same machine. tsc_cycles says
+// which was used.
+//
+// To compare two commits write JSON with make bench-json on each and use
+// compare.py from google benchmark's tools directory.
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+// Restricts the calling thread to a single CPU until destroyed.
+class PinnedToCpu
+{
+public:
+  PinnedToCpu()
+  {
+    isPinned = sched_getaffinity( 0, sizeof( previous ), &previous ) == 0;
+    if ( !isPinned )
+    {
+      return;
+    }
+
+    const char* env{ std::getenv( "LB_ENCODING_BENCH_CPU" ) };
+    const int cpu{ env ? std::atoi( env ) : sched_getcpu() };
+    cpu_set_t only;
+    CPU_ZERO( &only );
+    CPU_SET( cpu, &only );
+    isPinned = sched_setaffinity( 0, sizeof( only ), &only ) == 0;
+  }
+
+  ~PinnedToCpu()
+  {
+    if ( isPinned )
+    {
+      sched_setaffinity( 0, sizeof( previous ), &previous );
+    }
+  }
+
+  PinnedToCpu( const PinnedToCpu& ) = delete;
+  PinnedToCpu& operator=( const PinnedToCpu& ) = delete;
+
+private:
+  cpu_set_t previous;
+  bool isPinned;
+};
+
+std::vector<char> input( size_t size )
+{
+  std::vector<char> bytes( size );
+  uint32_t x{ 2463534242U };
+  for ( char& byte : bytes )
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    byte = char( x );
+  }
+  return bytes;
+}
+
+// Runs encode( src, numSrcBytes, dst ) on the given input.
+template< class Encode >
+void run( benchmark::State& state, const std::vector<char>& src, size_t numDstBytes, Encode&& encode )
+{
+  PinnedToCpu pinned;
+  const size_t numSrcBytes( src.size() );
+  std::vector<char> dst( numDstBytes );
+
+  PerfCounters counters{ PerfCounters::codecEvents() };
+
+  counters.start();
+  const uint64_t startTsc{ __rdtsc() };
+  for ( auto _ : state )
+  {
+    encode( src.data(), numSrcBytes, dst.data() );
+    benchmark::DoNotOptimize( dst.data() );
+    benchmark::ClobberMemory();
+  }
+  const uint64_t numTscCycles{ __rdtsc() - startTsc };
+  counters.stop();
+
+  const double numBytes( double( state.iterations() ) * double( numSrcBytes ) );
+  state.SetBytesProcessed( int64_t( numBytes ) );
+
+  counters.report( state, double( numSrcBytes ), "byte" );
+  const auto cycles{ counters.value( "cycles" ) };
+  const auto instructions{ counters.value( "instructions" ) };
+  if ( cycles && instructions && *cycles > 0 )
+  {
+    state.counters[ "ipc" ] = *instructions / *cycles;
+  }
+  if ( !cycles )
+  {
+    state.counters[ "cycles_per_byte" ] = double( numTscCycles ) / numBytes;
+  }
+  state.counters[ "tsc_cycles" ] = cycles ? 0 : 1;
+}
+
+// Runs encode( src, numSrcBytes, dst ) on an input of state.range(0) bytes.
+template< class Encode >
+void run( benchmark::State& state, size_t numDstBytes, Encode&& encode )
+{
+  run( state, input( state.range(0) ), numDstBytes, std::forward<Encode>( encode ) );
+}
+
+void sizes( benchmark::internal::Benchmark* benchmark )
+{
+  benchmark->RangeMultiplier( 4 )->Range( 16, 64 << 20 );
+}
+
+
+} // End of anonymous namespace
+
+
+static void BM_CodecBase64Encode( benchmark::State& state )
+{
+  run( state, ( state.range(0) + 2 ) / 3 * 4, []( const char* src, size_t n, char* dst )
+  {
+    lb::encoding::base64::encode( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecBase64Encode)->Apply( sizes );
+
+// The input is state.range(0) characters of base64, all of it valid.
+static void BM_CodecBase64Decode( benchmark::State& state )
+{
+  const std::vector<char> bytes{ input( state.range(0) / 4 * 3 ) };
+  std::vector<char> src( state.range(0) );
+  lb::encoding::base64::encode( bytes.data(), bytes.size(), src.data() );
+
+  run( state, src, bytes.size(), []( const char* src, size_t n, char* dst )
+  {
+    lb::encoding::base64::decode( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecBase64Decode)->Apply( sizes );
+
+// The unpadded url alphabet of JSON Web Tokens, through the same kernels.
+static void BM_CodecBase64UrlEncode( benchmark::State& state )
+{
+  run( state, ( state.range(0) + 2 ) / 3 * 4, []( const char* src, size_t n, char* dst )
+  {
+    lb::encoding::base64::encode<lb::encoding::base64::UrlUnpadded>( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecBase64UrlEncode)->Apply( sizes );
+
+static void BM_CodecBase64UrlDecode( benchmark::State& state )
+{
+  namespace base64 = lb::encoding::base64;
+
+  const std::vector<char> bytes{ input( state.range(0) / 4 * 3 ) };
+  std::vector<char> src( state.range(0) );
+  base64::encode<base64::UrlUnpadded>( bytes.data(), bytes.size(), src.data() );
+
+  run( state, src, bytes.size(), []( const char* src, size_t n, char* dst )
+  {
+    base64::decode<base64::UrlUnpadded>( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecBase64UrlDecode)->Apply( sizes );
+
+// As BM_CodecBase64Encode but through base64::Encoder in chunks of 4093
+// bytes, a prime so that a remainder is carried from almost every chunk to the
+// next.
+static void BM_CodecBase64EncodeStream( benchmark::State& state )
+{
+  run( state, ( state.range(0) + 2 ) / 3 * 4, []( const char* src, size_t n, char* dst )
+  {
+    const size_t chunkSize{ 4093 };
+    lb::encoding::base64::Encoder encoder;
+    for ( size_t i = 0; i < n; i += chunkSize )
+    {
+      dst += encoder.update( src + i, std::min( chunkSize, n - i ), dst );
+    }
+    encoder.finish( dst );
+  } );
+}
+BENCHMARK(BM_CodecBase64EncodeStream)->Apply( sizes );
+
+// As BM_CodecBase64Decode but through base64::Decoder, chunked as above.
+static void BM_CodecBase64DecodeStream( benchmark::State& state )
+{
+  const std::vector<char> bytes{ input( state.range(0) / 4 * 3 ) };
+  std::vector<char> src( state.range(0) );
+  lb::encoding::base64::encode( bytes.data(), bytes.size(), src.data() );
+
+  run( state, src, bytes.size(), []( const char* src, size_t n, char* dst )
+  {
+    const size_t chunkSize{ 4093 };
+    lb::encoding::base64::Decoder decoder;
+    for ( size_t i = 0; i < n; i += chunkSize )
+    {
+      dst += decoder.update( src + i, std::min( chunkSize, n - i ), dst ).numDstBytes;
+    }
+    decoder.finish();
+  } );
+}
+BENCHMARK(BM_CodecBase64DecodeStream)->Apply( sizes );
+
+static void BM_CodecHexEncode( benchmark::State& state )
+{
+  run( state, state.range(0) * 2, []( const char* src, size_t n, char* dst )
+  {
+    lb::encoding::hex::encode( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecHexEncode)->Apply( sizes );
+
+// bits only has a single byte encode. At eight output bytes per input byte
+// the output goes round a 64 KiB window rather than taking 512 MiB.
+static void BM_CodecBitsEncode( benchmark::State& state )
+{
+  const size_t windowSize{ 64 * 1024 };
+  run( state, windowSize, [windowSize]( const char* src, size_t n, char* dst )
+  {
+    for ( size_t i = 0; i < n; ++i )
+    {
+      lb::encoding::bits::encode( src[i], dst + ( i * 8 ) % windowSize );
+    }
+  } );
+}
+BENCHMARK(BM_CodecBitsEncode)->Apply( sizes );
+
+static void BM_CodecSha1Encode( benchmark::State& state )
+{
+  run( state, 20, []( const char* src, size_t n, char* dst )
+  {
+    lb::encoding::sha1::encode( src, n, dst );
+  } );
+}
+BENCHMARK(BM_CodecSha1Encode)->Apply( sizes );
+
+static void BM_CodecMaskPayload( benchmark::State& state )
+{
+  run( state, state.range(0), []( const char* src, size_t n, char* dst )
+  {
+    const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+    ws::encodeMaskedPayload( src, n, mask, dst );
+  } );
+}
+BENCHMARK(BM_CodecMaskPayload)->Apply( sizes );
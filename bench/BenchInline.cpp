@@ -0,0 +1,138 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/base64.h>
+#include <lb/encoding/base64inline.h>
+#include <lb/encoding/bits.h>
+#include <lb/encoding/bitsinline.h>
+#include <lb/encoding/hex.h>
+#include <lb/encoding/hexinline.h>
+
+#include <vector>
+
+
+// The per byte primitives called from a loop in the caller, as they usually
+// are, through liblbEncoding.so and then from the header-only versions. The
+// difference is the cost of a call through the PLT for each byte plus
+// whatever the compiler can do with the loop once it sees inside it.
+//
+// Only meaningful from a release build.
+
+
+namespace
+{
+
+
+const size_t numBytes{ 4096 };
+
+// Sixteen byte keys, e.g. Sec-WebSocket-Key nonces, encode to 24 characters.
+const size_t keySize{ 16 };
+const size_t encodedKeySize{ 24 };
+
+std::vector<char> input()
+{
+  std::vector<char> bytes( numBytes );
+  for ( size_t i = 0; i < numBytes; ++i )
+  {
+    bytes[i] = char( i * 131 + 7 );
+  }
+  return bytes;
+}
+
+// Calls encode( byte, dst ) for every byte of the input.
+template< size_t NumDstBytes, class Encode >
+void perByte( benchmark::State& state, Encode&& encode )
+{
+  const std::vector<char> src{ input() };
+  std::vector<char> dst( NumDstBytes * numBytes );
+
+  for ( auto _ : state )
+  {
+    for ( size_t i = 0; i < numBytes; ++i )
+    {
+      encode( src[i], dst.data() + NumDstBytes * i );
+    }
+    benchmark::DoNotOptimize( dst.data() );
+    benchmark::ClobberMemory();
+  }
+
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numBytes );
+}
+
+// Calls encode( src, keySize, dst ) for each key sized piece of the input.
+template< class Encode >
+void perKey( benchmark::State& state, Encode&& encode )
+{
+  const std::vector<char> src{ input() };
+  const size_t numKeys{ numBytes / keySize };
+  std::vector<char> dst( encodedKeySize * numKeys );
+
+  for ( auto _ : state )
+  {
+    for ( size_t k = 0; k < numKeys; ++k )
+    {
+      encode( src.data() + keySize * k, keySize, dst.data() + encodedKeySize * k );
+    }
+    benchmark::DoNotOptimize( dst.data() );
+    benchmark::ClobberMemory();
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numKeys );
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numBytes );
+}
+
+
+} // End of anonymous namespace
+
+
+static void BM_InlineHexLibrary( benchmark::State& state )
+{
+  perByte<2>( state, []( char src, char* dst ) { lb::encoding::hex::encode( src, dst ); } );
+}
+BENCHMARK(BM_InlineHexLibrary);
+
+static void BM_InlineHexHeader( benchmark::State& state )
+{
+  perByte<2>( state, []( char src, char* dst ) { lb::encoding::hex::inlined::encode( src, dst ); } );
+}
+BENCHMARK(BM_InlineHexHeader);
+
+static void BM_InlineBitsLibrary( benchmark::State& state )
+{
+  perByte<8>( state, []( char src, char* dst ) { lb::encoding::bits::encode( src, dst ); } );
+}
+BENCHMARK(BM_InlineBitsLibrary);
+
+static void BM_InlineBitsHeader( benchmark::State& state )
+{
+  perByte<8>( state, []( char src, char* dst ) { lb::encoding::bits::inlined::encode( src, dst ); } );
+}
+BENCHMARK(BM_InlineBitsHeader);
+
+static void BM_InlineBase64KeyLibrary( benchmark::State& state )
+{
+  perKey( state, []( const char* src, size_t n, char* dst ) { lb::encoding::base64::encode( src, n, dst ); } );
+}
+BENCHMARK(BM_InlineBase64KeyLibrary);
+
+static void BM_InlineBase64KeyHeader( benchmark::State& state )
+{
+  perKey( state, []( const char* src, size_t n, char* dst ) { lb::encoding::base64::inlined::encode( src, n, dst ); } );
+}
+BENCHMARK(BM_InlineBase64KeyHeader);
@@ -0,0 +1,94 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/sha1.h>
+
+#include <string>
+#include <vector>
+
+
+namespace
+{
+
+
+const size_t numMessages{ 1024 };
+
+// numMessages distinct messages of the same size, as if from many clients.
+struct Messages
+{
+  Messages( size_t size )
+  {
+    for ( size_t m = 0; m < numMessages; ++m )
+    {
+      std::string message( size, '\0' );
+      for ( size_t i = 0; i < size; ++i )
+      {
+        message[i] = char( m * 131 + i * 7 );
+      }
+      messages.push_back( message );
+    }
+    for ( const auto& message : messages )
+    {
+      srcs.push_back( message.data() );
+      sizes.push_back( message.size() );
+    }
+  }
+
+  std::vector<std::string> messages;
+  std::vector<const char*> srcs;
+  std::vector<size_t> sizes;
+  std::vector<char> digests = std::vector<char>( 20 * numMessages );
+};
+
+
+} // End of anonymous namespace
+
+
+static void BM_Sha1ScalarLoop( benchmark::State& state )
+{
+  Messages m( state.range(0) );
+
+  for ( auto _ : state )
+  {
+    for ( size_t i = 0; i < numMessages; ++i )
+    {
+      lb::encoding::sha1::encode( m.srcs[i], m.sizes[i], &m.digests[ 20 * i ] );
+    }
+    benchmark::DoNotOptimize( m.digests.data() );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numMessages );
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numMessages * state.range(0) );
+}
+BENCHMARK(BM_Sha1ScalarLoop)->Arg( 60 )->Arg( 1024 );
+
+static void BM_Sha1Batch( benchmark::State& state )
+{
+  Messages m( state.range(0) );
+
+  for ( auto _ : state )
+  {
+    lb::encoding::sha1::encodeBatch( m.srcs.data(), m.sizes.data(), numMessages, m.digests.data() );
+    benchmark::DoNotOptimize( m.digests.data() );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numMessages );
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numMessages * state.range(0) );
+}
+BENCHMARK(BM_Sha1Batch)->Arg( 60 )->Arg( 1024 );
@@ -0,0 +1,135 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketbatch.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t numFramesPerTick{ 256 };
+
+// A unix socket pair with a thread on the receiving end that discards
+// everything.
+class DrainedSocket
+{
+public:
+  DrainedSocket()
+  {
+    int sockets[2];
+    socketpair( AF_UNIX, SOCK_STREAM, 0, sockets );
+    sender = sockets[0];
+    const int receiver{ sockets[1] };
+    drainer = std::thread( [receiver]()
+    {
+      std::vector<char> buffer( 1 << 18 );
+      while ( read( receiver, buffer.data(), buffer.size() ) > 0 )
+      {
+      }
+      close( receiver );
+    } );
+  }
+
+  ~DrainedSocket()
+  {
+    close( sender );
+    drainer.join();
+  }
+
+  int sender;
+
+private:
+  std::thread drainer;
+};
+
+
+} // End of anonymous namespace
+
+
+// The baseline: one header encode and one send per frame.
+static void BM_WebSocketSendPerFrame( benchmark::State& state )
+{
+  DrainedSocket socket;
+  const std::string payload( state.range(0), 'x' );
+  std::vector<char> buffer( ws::Header::maxSizeInBytes + payload.size() );
+
+  ws::Header header;
+  header.opCode = ws::Header::OpCode::eText;
+  header.payloadSize = payload.size();
+
+  for ( auto _ : state )
+  {
+    for ( size_t i = 0; i < numFramesPerTick; ++i )
+    {
+      const size_t numHeaderBytes{ header.encodedSizeInBytes() };
+      header.encode( buffer.data() );
+      std::copy( payload.begin(), payload.end(), buffer.data() + numHeaderBytes );
+      if ( send( socket.sender, buffer.data(), numHeaderBytes + payload.size(), MSG_NOSIGNAL ) < 0 )
+      {
+        state.SkipWithError( "send failed" );
+        break;
+      }
+    }
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFramesPerTick );
+}
+BENCHMARK(BM_WebSocketSendPerFrame)->Arg( 16 )->Arg( 128 )->UseRealTime();
+
+// Every frame of the tick appended to a FrameBatcher then a single flush.
+static void BM_WebSocketSendBatched( benchmark::State& state )
+{
+  DrainedSocket socket;
+  const std::string payload( state.range(0), 'x' );
+  ws::FrameBatcher batcher;
+
+  ws::Header header;
+  header.opCode = ws::Header::OpCode::eText;
+  header.payloadSize = payload.size();
+
+  for ( auto _ : state )
+  {
+    for ( size_t i = 0; i < numFramesPerTick; ++i )
+    {
+      if ( batcher.append( header, payload ) )
+      {
+        batcher.flush( socket.sender );
+      }
+    }
+    if ( batcher.flush( socket.sender ) != ws::FrameBatcher::Status::eComplete )
+    {
+      state.SkipWithError( "flush failed" );
+      break;
+    }
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFramesPerTick );
+}
+BENCHMARK(BM_WebSocketSendBatched)->Arg( 16 )->Arg( 128 )->UseRealTime();
@@ -0,0 +1,646 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketbatch.h>
+#include <lb/encoding/websockethandshake.h>
+#include <lb/encoding/websocketlatency.h>
+#include <lb/encoding/websocketmask.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+// End to end: an epoll echo server and a load generator talking WebSocket
+// over loopback TCP, handshake and closing handshake included. Every client
+// connection sends a masked binary message, waits for the echo and repeats.
+//
+//   make bench-e2e
+
+
+namespace ws = lb::encoding::websocket;
+namespace closestatus = ws::closestatus;
+namespace handshake = ws::handshake;
+
+
+namespace
+{
+
+
+const size_t readBufferSize{ 64 * 1024 };
+
+void setNoDelay( int fd )
+{
+  const int one{ 1 };
+  setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+}
+
+// Only for blocking sockets, the server queues its responses instead.
+void sendAll( int fd, const char* p, size_t numBytes )
+{
+  while ( numBytes > 0 )
+  {
+    const ssize_t n{ send( fd, p, numBytes, MSG_NOSIGNAL ) };
+    if ( n < 0 )
+    {
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+      throw std::runtime_error( std::string( "send: " ) + strerror( errno ) );
+    }
+    p += n;
+    numBytes -= n;
+  }
+}
+
+// The payload is copied in unmasked.
+void unmaskTo( const ws::FrameView& view, std::string& dst )
+{
+  dst.resize( view.header.payloadSize );
+  if ( view.header.isMasked )
+  {
+    ws::decodeMaskedPayload( view.payload, view.header.payloadSize, view.header.mask, dst.data() );
+  }
+  else
+  {
+    std::memcpy( dst.data(), view.payload, view.header.payloadSize );
+  }
+}
+
+ws::Header closeHeader( size_t payloadSize )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eConnectionClose;
+  header.payloadSize = payloadSize;
+  return header;
+}
+
+
+// Single threaded, level triggered, non-blocking.
+class EchoServer
+{
+public:
+  EchoServer()
+  {
+    listenFd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0 );
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    socklen_t addressSize{ sizeof( address ) };
+    if ( bind( listenFd, reinterpret_cast<sockaddr*>( &address ), addressSize ) != 0
+      || listen( listenFd, 1024 ) != 0
+      || getsockname( listenFd, reinterpret_cast<sockaddr*>( &address ), &addressSize ) != 0 )
+    {
+      throw std::runtime_error( std::string( "listen: " ) + strerror( errno ) );
+    }
+    port = ntohs( address.sin_port );
+
+    epollFd = epoll_create1( 0 );
+    stopFd = eventfd( 0, EFD_NONBLOCK );
+    watch( listenFd, EPOLL_CTL_ADD, EPOLLIN );
+    watch( stopFd, EPOLL_CTL_ADD, EPOLLIN );
+
+    thread = std::thread( &EchoServer::run, this );
+  }
+
+  ~EchoServer()
+  {
+    const uint64_t one{ 1 };
+    if ( write( stopFd, &one, sizeof( one ) ) != sizeof( one ) )
+    {
+      std::terminate();
+    }
+    thread.join();
+    for ( auto& connection : connections )
+    {
+      if ( connection )
+      {
+        close( connection->fd );
+      }
+    }
+    close( stopFd );
+    close( epollFd );
+    close( listenFd );
+  }
+
+  uint16_t port;
+
+private:
+  struct Connection
+  {
+    int fd;
+    bool isUpgraded{ false };
+    bool isWatchingOut{ false };
+    bool isClosing{ false };
+    std::string request;
+    std::string response; // Handshake response not yet sent
+    ws::Decoder decoder;
+    ws::FrameBatcher out;
+    std::string payload;
+  };
+
+  void watch( int fd, int op, uint32_t events )
+  {
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    epoll_ctl( epollFd, op, fd, &event );
+  }
+
+  void run()
+  {
+    epoll_event events[ 256 ];
+    std::unique_ptr<char[]> buffer{ new char[ readBufferSize ] };
+    while ( true )
+    {
+      const int numEvents{ epoll_wait( epollFd, events, 256, -1 ) };
+      for ( int i = 0; i < numEvents; ++i )
+      {
+        const int fd{ events[i].data.fd };
+        if ( fd == stopFd )
+        {
+          return;
+        }
+        if ( fd == listenFd )
+        {
+          accept();
+          continue;
+        }
+
+        Connection& connection{ *connections[ fd ] };
+        bool isOpen{ true };
+        if ( events[i].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) )
+        {
+          isOpen = read( connection, buffer.get() );
+        }
+        if ( isOpen )
+        {
+          isOpen = flush( connection );
+        }
+        if ( !isOpen )
+        {
+          close( fd );
+          connections[ fd ].reset();
+        }
+      }
+    }
+  }
+
+  void accept()
+  {
+    int fd;
+    while ( ( fd = accept4( listenFd, nullptr, nullptr, SOCK_NONBLOCK ) ) >= 0 )
+    {
+      setNoDelay( fd );
+      if ( size_t( fd ) >= connections.size() )
+      {
+        connections.resize( fd + 1 );
+      }
+      connections[ fd ] = std::make_unique<Connection>();
+      connections[ fd ]->fd = fd;
+      watch( fd, EPOLL_CTL_ADD, EPOLLIN );
+    }
+  }
+
+  // False once the connection should be closed.
+  bool read( Connection& connection, char* buffer )
+  {
+    while ( true )
+    {
+      const ssize_t n{ recv( connection.fd, buffer, readBufferSize, 0 ) };
+      if ( n > 0 )
+      {
+        if ( !received( connection, buffer, n ) )
+        {
+          return false;
+        }
+      }
+      else
+      {
+        return n < 0 && ( errno == EAGAIN || errno == EINTR );
+      }
+    }
+  }
+
+  bool received( Connection& connection, const char* p, size_t numBytes )
+  {
+    if ( connection.isClosing && !connection.isUpgraded )
+    {
+      return true;
+    }
+    if ( !connection.isUpgraded )
+    {
+      connection.request.append( p, numBytes );
+      handshake::Request request;
+      const auto result{ handshake::parse( connection.request.data(), connection.request.size(), request ) };
+      if ( result == handshake::ParseResult::eIncomplete )
+      {
+        return true;
+      }
+      if ( result != handshake::ParseResult::eSuccess )
+      {
+        connection.response = handshake::errorResponse( result );
+        connection.isClosing = true;
+        return true;
+      }
+
+      connection.response.resize( handshake::encodedResponseSize() );
+      connection.response.resize( handshake::encodeResponse( request, connection.response.data() ) );
+      connection.isUpgraded = true;
+
+      const std::string rest{ connection.request.substr( request.numBytes ) };
+      connection.request.clear();
+      return received( connection, rest.data(), rest.size() );
+    }
+
+    const bool isValid{ connection.decoder.decodeEach( p, numBytes, [&]( const ws::FrameView& view )
+    {
+      echo( connection, view );
+    } ) };
+    if ( !isValid )
+    {
+      std::string code( 2, '\0' );
+      closestatus::encodePayloadCode( closestatus::toPayload( closestatus::ProtocolCode::eProtocolError ), code );
+      connection.out.append( closeHeader( code.size() ), code );
+      connection.isClosing = true;
+    }
+    return true;
+  }
+
+  void echo( Connection& connection, const ws::FrameView& view )
+  {
+    unmaskTo( view, connection.payload );
+
+    ws::Header header;
+    header.fin = view.header.fin;
+    header.payloadSize = view.header.payloadSize;
+
+    switch ( view.header.opCode )
+    {
+    case ws::Header::OpCode::eContinuation:
+    case ws::Header::OpCode::eText:
+    case ws::Header::OpCode::eBinary:
+      header.opCode = view.header.opCode;
+      connection.out.append( header, connection.payload );
+      break;
+    case ws::Header::OpCode::ePing:
+      header.opCode = ws::Header::OpCode::ePong;
+      connection.out.append( header, connection.payload );
+      break;
+    case ws::Header::OpCode::ePong:
+      break;
+    case ws::Header::OpCode::eConnectionClose:
+    {
+      // Echo the status code back, as RFC 6455 Section 5.5.1 suggests.
+      const auto code{ closestatus::decodePayloadCode( connection.payload.data(), connection.payload.size() ) };
+      std::string reply;
+      if ( closestatus::toProtocol( code ) != closestatus::ProtocolCode::eNoCodeProvided )
+      {
+        reply.resize( 2 );
+        closestatus::encodePayloadCode( code, reply );
+      }
+      connection.out.append( closeHeader( reply.size() ), reply );
+      connection.isClosing = true;
+      break;
+    }
+    }
+  }
+
+  // Any handshake response goes out ahead of the frames.
+  ws::FrameBatcher::Status sendResponse( Connection& connection )
+  {
+    size_t numSent{ 0 };
+    while ( numSent < connection.response.size() )
+    {
+      const ssize_t n{ send( connection.fd, connection.response.data() + numSent
+                           , connection.response.size() - numSent, MSG_NOSIGNAL ) };
+      if ( n < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        connection.response.erase( 0, numSent );
+        return errno == EAGAIN ? ws::FrameBatcher::Status::eWouldBlock
+                               : ws::FrameBatcher::Status::eError;
+      }
+      numSent += n;
+    }
+    connection.response.clear();
+    return ws::FrameBatcher::Status::eComplete;
+  }
+
+  bool flush( Connection& connection )
+  {
+    auto status{ sendResponse( connection ) };
+    if ( status == ws::FrameBatcher::Status::eComplete )
+    {
+      status = connection.out.flush( connection.fd );
+    }
+    switch ( status )
+    {
+    case ws::FrameBatcher::Status::eComplete:
+      if ( connection.isWatchingOut )
+      {
+        watch( connection.fd, EPOLL_CTL_MOD, EPOLLIN );
+        connection.isWatchingOut = false;
+      }
+      return !connection.isClosing;
+    case ws::FrameBatcher::Status::eWouldBlock:
+      if ( !connection.isWatchingOut )
+      {
+        watch( connection.fd, EPOLL_CTL_MOD, EPOLLIN | EPOLLOUT );
+        connection.isWatchingOut = true;
+      }
+      return true;
+    case ws::FrameBatcher::Status::eError:
+      return false;
+    }
+    return false;
+  }
+
+  int listenFd;
+  int epollFd;
+  int stopFd;
+  std::vector<std::unique_ptr<Connection>> connections; // Indexed by fd
+  std::thread thread;
+};
+
+
+// A client connection, past the opening handshake, with blocking sends.
+struct Client
+{
+  Client( uint16_t port )
+  {
+    fd = socket( AF_INET, SOCK_STREAM, 0 );
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    address.sin_port = htons( port );
+    if ( connect( fd, reinterpret_cast<sockaddr*>( &address ), sizeof( address ) ) != 0 )
+    {
+      throw std::runtime_error( std::string( "connect: " ) + strerror( errno ) );
+    }
+    setNoDelay( fd );
+
+    static const std::string key{ "dGhlIHNhbXBsZSBub25jZQ==" };
+    const std::string request{ "GET /echo HTTP/1.1\r\n"
+                               "Host: localhost\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Key: " + key + "\r\n"
+                               "Sec-WebSocket-Version: 13\r\n\r\n" };
+    sendAll( fd, request.data(), request.size() );
+
+    std::string response;
+    char buffer[ 512 ];
+    while ( response.find( "\r\n\r\n" ) == std::string::npos )
+    {
+      const ssize_t n{ recv( fd, buffer, sizeof( buffer ), 0 ) };
+      if ( n <= 0 )
+      {
+        throw std::runtime_error( "handshake failed" );
+      }
+      response.append( buffer, n );
+    }
+    char acceptKey[ handshake::acceptKeySize ];
+    handshake::computeAcceptKey( key.data(), acceptKey );
+    if ( response.find( std::string_view( acceptKey, sizeof( acceptKey ) ) ) == std::string::npos )
+    {
+      throw std::runtime_error( "handshake not accepted" );
+    }
+  }
+
+  ~Client()
+  {
+    close( fd );
+  }
+
+  void sendMessage( const std::string& payload )
+  {
+    ws::Header header;
+    header.fin = true;
+    header.opCode = ws::Header::OpCode::eBinary;
+    header.payloadSize = payload.size();
+    ws::setRandomMask( header );
+    out.append( header, payload );
+    sentAt = std::chrono::steady_clock::now();
+    if ( out.flush( fd ) != ws::FrameBatcher::Status::eComplete )
+    {
+      throw std::runtime_error( "send failed" );
+    }
+  }
+
+  void sendClose()
+  {
+    std::string code( 2, '\0' );
+    closestatus::encodePayloadCode( closestatus::toPayload( closestatus::ProtocolCode::eNormal ), code );
+    ws::Header header{ closeHeader( code.size() ) };
+    ws::setRandomMask( header );
+    out.append( header, code );
+    if ( out.flush( fd ) != ws::FrameBatcher::Status::eComplete )
+    {
+      throw std::runtime_error( "send failed" );
+    }
+  }
+
+  int fd;
+  ws::Decoder decoder;
+  ws::FrameBatcher out;
+  std::string payload;
+  std::chrono::steady_clock::time_point sentAt;
+  size_t numRemaining{ 0 };
+  bool isClosed{ false };
+};
+
+// Runs clients to completion, one message in flight on each.
+void runClients( const std::vector<Client*>& clients
+               , const std::string& message
+               , ws::LatencyHistogram& latencies )
+{
+  const int epollFd{ epoll_create1( 0 ) };
+  for ( Client* client : clients )
+  {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    epoll_ctl( epollFd, EPOLL_CTL_ADD, client->fd, &event );
+    client->sendMessage( message );
+  }
+
+  std::unique_ptr<char[]> buffer{ new char[ readBufferSize ] };
+  epoll_event events[ 64 ];
+  size_t numOpen{ clients.size() };
+  while ( numOpen > 0 )
+  {
+    const int numEvents{ epoll_wait( epollFd, events, 64, -1 ) };
+    for ( int i = 0; i < numEvents; ++i )
+    {
+      Client& client{ *static_cast<Client*>( events[i].data.ptr ) };
+      const ssize_t n{ recv( client.fd, buffer.get(), readBufferSize, 0 ) };
+      if ( n <= 0 )
+      {
+        throw std::runtime_error( "server hung up" );
+      }
+
+      const auto now{ std::chrono::steady_clock::now() };
+      client.decoder.decodeEach( buffer.get(), n, [&]( const ws::FrameView& view )
+      {
+        if ( view.header.opCode == ws::Header::OpCode::eBinary )
+        {
+          if ( view.header.payloadSize != message.size() )
+          {
+            throw std::runtime_error( "bad echo" );
+          }
+          latencies.record( std::chrono::duration_cast<std::chrono::nanoseconds>( now - client.sentAt ).count() );
+          if ( --client.numRemaining > 0 )
+          {
+            client.sendMessage( message );
+          }
+          else
+          {
+            client.sendClose();
+          }
+        }
+        else if ( view.header.opCode == ws::Header::OpCode::eConnectionClose )
+        {
+          unmaskTo( view, client.payload );
+          const auto code{ closestatus::decodePayloadCode( client.payload.data(), client.payload.size() ) };
+          if ( closestatus::toProtocol( code ) != closestatus::ProtocolCode::eNormal )
+          {
+            throw std::runtime_error( "unexpected close status " + std::to_string( code ) );
+          }
+          client.isClosed = true;
+        }
+      } );
+
+      if ( client.isClosed )
+      {
+        epoll_ctl( epollFd, EPOLL_CTL_DEL, client.fd, nullptr );
+        --numOpen;
+      }
+    }
+  }
+  close( epollFd );
+}
+
+
+} // End of anonymous namespace
+
+
+// Arguments are the message size and the number of connections. A fixed
+// number of bytes is echoed, within limits, whatever the message size.
+static void BM_WebSocketEndToEnd( benchmark::State& state )
+{
+  const size_t messageSize( state.range(0) );
+  const size_t numConnections( state.range(1) );
+  const size_t numMessages{ std::clamp<size_t>( ( 64 << 20 ) / messageSize, 1000, 20000 ) };
+  const size_t numThreads{ std::min<size_t>( numConnections, std::max( 2U, std::thread::hardware_concurrency() ) ) };
+  const std::string message( messageSize, 'm' );
+
+  EchoServer server;
+  ws::LatencyHistogram latencies;
+
+  for ( auto _ : state )
+  {
+    std::vector<std::unique_ptr<Client>> clients;
+    try
+    {
+      for ( size_t i = 0; i < numConnections; ++i )
+      {
+        clients.push_back( std::make_unique<Client>( server.port ) );
+        clients.back()->numRemaining = numMessages / numConnections + ( i < numMessages % numConnections );
+      }
+    }
+    catch ( const std::exception& e )
+    {
+      state.SkipWithError( e.what() );
+      return;
+    }
+
+    // An exception escaping a thread would terminate, so each thread keeps
+    // its error for reporting once they have all been joined.
+    std::vector<ws::LatencyHistogram> threadLatencies( numThreads );
+    std::vector<std::string> threadErrors( numThreads );
+    std::vector<std::thread> threads;
+    const auto start{ std::chrono::steady_clock::now() };
+    for ( size_t t = 0; t < numThreads; ++t )
+    {
+      std::vector<Client*> mine;
+      for ( size_t i = t; i < numConnections; i += numThreads )
+      {
+        mine.push_back( clients[i].get() );
+      }
+      threads.emplace_back( [&, t, mine = std::move( mine )]()
+      {
+        try
+        {
+          runClients( mine, message, threadLatencies[t] );
+        }
+        catch ( const std::exception& e )
+        {
+          threadErrors[t] = e.what();
+        }
+      } );
+    }
+    for ( auto& thread : threads )
+    {
+      thread.join();
+    }
+    const auto error{ std::find_if( threadErrors.begin(), threadErrors.end(), []( const std::string& e ) { return !e.empty(); } ) };
+    if ( error != threadErrors.end() )
+    {
+      state.SkipWithError( error->c_str() );
+      return;
+    }
+    state.SetIterationTime( std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count() );
+
+    for ( const auto& threadLatency : threadLatencies )
+    {
+      latencies += threadLatency;
+    }
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numMessages );
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numMessages * messageSize * 2 );
+  state.counters[ "client_threads" ] = double( numThreads );
+  state.counters[ "p50_us" ]  = latencies.valueAtPercentile( 50 ) / 1e3;
+  state.counters[ "p99_us" ]  = latencies.valueAtPercentile( 99 ) / 1e3;
+  state.counters[ "p999_us" ] = latencies.valueAtPercentile( 99.9 ) / 1e3;
+  state.counters[ "max_us" ]  = latencies.maxValue() / 1e3;
+}
+BENCHMARK(BM_WebSocketEndToEnd)->ArgNames( { "size", "connections" } )
+                               ->ArgsProduct( { { 16, 1024, 65536 }, { 1, 16, 128 } } )
+                               ->UseManualTime()
+                               ->Iterations( 1 )
+                               ->Unit( benchmark::kMillisecond );
@@ -0,0 +1,96 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketgroup.h>
+
+#include <algorithm>
+#include <thread>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t numConnections{ 256 };
+const size_t numFramesPerConnection{ 16 };
+
+// What one connection might have read in one go.
+std::string connectionInput( size_t payloadSize )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eBinary;
+  header.payloadSize = payloadSize;
+  header.isMasked = true;
+  header.mask[0] = 1;
+  header.mask[1] = 2;
+  header.mask[2] = 3;
+  header.mask[3] = 4;
+  std::string frame( header.encodedSizeInBytes(), '\0' );
+  header.encode( frame.data() );
+  frame += ws::encodeMaskedPayload( std::string( payloadSize, 'x' ), header.mask );
+
+  std::string input;
+  for ( size_t i = 0; i < numFramesPerConnection; ++i )
+  {
+    input += frame;
+  }
+  return input;
+}
+
+// 1, 2, 4, ... threads up to the number of hardware threads.
+void threadCounts( benchmark::internal::Benchmark* benchmark )
+{
+  const size_t numHardwareThreads{ std::max( 1U, std::thread::hardware_concurrency() ) };
+  for ( size_t numThreads = 1; numThreads < numHardwareThreads; numThreads *= 2 )
+  {
+    benchmark->Args( { int64_t( numThreads ) } );
+  }
+  benchmark->Args( { int64_t( numHardwareThreads ) } );
+}
+
+
+} // End of anonymous namespace
+
+
+// One batch of numConnections buffers per iteration, as after an epoll_wait.
+static void BM_WebSocketDecoderGroup( benchmark::State& state )
+{
+  const std::string input{ connectionInput( 1024 ) };
+  std::vector<ws::Decoder> decoders( numConnections );
+  std::vector<ws::DecoderGroup::Job> jobs;
+  for ( auto& decoder : decoders )
+  {
+    jobs.push_back( { &decoder, input.data(), input.size() } );
+  }
+  std::vector<ws::Decoder::Result> results;
+  ws::DecoderGroup group( state.range(0) );
+
+  for ( auto _ : state )
+  {
+    group.decode( jobs, results );
+    benchmark::DoNotOptimize( results.data() );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numConnections * numFramesPerConnection );
+  state.SetBytesProcessed( int64_t( state.iterations() ) * numConnections * input.size() );
+}
+BENCHMARK(BM_WebSocketDecoderGroup)->Apply( threadCounts )->UseRealTime();
@@ -0,0 +1,61 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketmask.h>
+
+#include <random>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+// What our load generators used to do, one trip to the kernel per frame.
+static void BM_WebSocketMaskRandomDevice( benchmark::State& state )
+{
+  std::random_device device;
+  ws::Header header;
+  header.isMasked = true;
+
+  for ( auto _ : state )
+  {
+    const uint32_t value{ device() };
+    header.mask[0] = value >> 24;
+    header.mask[1] = value >> 16;
+    header.mask[2] = value >>  8;
+    header.mask[3] = value;
+    benchmark::DoNotOptimize( header.mask );
+  }
+
+  state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_WebSocketMaskRandomDevice);
+
+static void BM_WebSocketMaskGenerate( benchmark::State& state )
+{
+  ws::Header header;
+
+  for ( auto _ : state )
+  {
+    ws::setRandomMask( header );
+    benchmark::DoNotOptimize( header.mask );
+  }
+
+  state.SetItemsProcessed( state.iterations() );
+}
+BENCHMARK(BM_WebSocketMaskGenerate);
@@ -0,0 +1,173 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketreader.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t numFrames{ 1000 };
+const size_t readSize{ 4096 };
+
+// numFrames small text frames back to back.
+std::string frameStream( size_t payloadSize )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eText;
+  header.payloadSize = payloadSize;
+  std::string frame( header.encodedSizeInBytes(), '\0' );
+  header.encode( frame.data() );
+  frame += std::string( payloadSize, 'x' );
+
+  std::string stream;
+  for ( size_t i = 0; i < numFrames; ++i )
+  {
+    stream += frame;
+  }
+  return stream;
+}
+
+struct MemorySource
+{
+  struct Read
+  {
+    size_t numBytes;
+
+    bool await_ready() noexcept { return true; }
+    void await_suspend( std::coroutine_handle<> ) noexcept {}
+    size_t await_resume() noexcept { return numBytes; }
+  };
+
+  Read read( char* dst, size_t maxBytes )
+  {
+    const size_t numBytes{ std::min( { maxBytes, readSize, data.size() - offset } ) };
+    std::memcpy( dst, data.data() + offset, numBytes );
+    offset += numBytes;
+    return { numBytes };
+  }
+
+  const std::string& data;
+  size_t offset{ 0 };
+};
+
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+Task consume( MemorySource& source, ws::Decoder& decoder, size_t& numBytes )
+{
+  auto reader{ ws::readFrames( source, decoder ) };
+  while ( const ws::Frame* frame = co_await reader.next() )
+  {
+    numBytes += frame->payload.size();
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+// Push model: the same reads through Decoder::decode and its Result vector.
+static void BM_WebSocketDecodePush( benchmark::State& state )
+{
+  const std::string stream{ frameStream( state.range(0) ) };
+  ws::Decoder decoder;
+  char buffer[ readSize ];
+
+  for ( auto _ : state )
+  {
+    size_t numBytes{ 0 };
+    for ( size_t offset = 0; offset < stream.size(); offset += readSize )
+    {
+      const size_t n{ std::min( readSize, stream.size() - offset ) };
+      std::memcpy( buffer, stream.data() + offset, n );
+      for ( const auto& frame : decoder.decode( buffer, n ).frames )
+      {
+        numBytes += frame.payload.size();
+      }
+    }
+    benchmark::DoNotOptimize( numBytes );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFrames );
+}
+BENCHMARK(BM_WebSocketDecodePush)->Arg( 16 )->Arg( 256 );
+
+// Pull model without coroutines, the floor for FrameReader.
+static void BM_WebSocketDecodeNext( benchmark::State& state )
+{
+  const std::string stream{ frameStream( state.range(0) ) };
+  ws::Decoder decoder;
+  ws::Frame frame;
+  char buffer[ readSize ];
+
+  for ( auto _ : state )
+  {
+    size_t numBytes{ 0 };
+    for ( size_t offset = 0; offset < stream.size(); offset += readSize )
+    {
+      size_t n{ std::min( readSize, stream.size() - offset ) };
+      std::memcpy( buffer, stream.data() + offset, n );
+      const char* p{ buffer };
+      while ( decoder.decodeNext( p, n, frame ) == ws::Decoder::Step::eFrame )
+      {
+        numBytes += frame.payload.size();
+      }
+    }
+    benchmark::DoNotOptimize( numBytes );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFrames );
+}
+BENCHMARK(BM_WebSocketDecodeNext)->Arg( 16 )->Arg( 256 );
+
+// One FrameReader, so one coroutine frame allocation, per numFrames frames.
+static void BM_WebSocketFrameReader( benchmark::State& state )
+{
+  const std::string stream{ frameStream( state.range(0) ) };
+  ws::Decoder decoder;
+
+  for ( auto _ : state )
+  {
+    MemorySource source{ stream };
+    size_t numBytes{ 0 };
+    consume( source, decoder, numBytes );
+    benchmark::DoNotOptimize( numBytes );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFrames );
+}
+BENCHMARK(BM_WebSocketFrameReader)->Arg( 16 )->Arg( 256 );
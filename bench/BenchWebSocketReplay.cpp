@@ -0,0 +1,236 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketlatency.h>
+
+#include "../gtest/AllocationCounter.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+// The byte stream replayed. Either a capture file named by the environment
+// variable LB_ENCODING_REPLAY_FILE, holding the raw bytes one side of a
+// WebSocket connection received after the handshake, or failing that a
+// synthesized mix of the traffic a server typically sees.
+class Capture
+{
+public:
+  static const Capture& get()
+  {
+    static const Capture capture;
+    return capture;
+  }
+
+  const char* data() const { return bytes; }
+  size_t size() const { return numBytes; }
+
+private:
+  Capture()
+  {
+    if ( const char* path = std::getenv( "LB_ENCODING_REPLAY_FILE" ) )
+    {
+      const int fd{ open( path, O_RDONLY ) };
+      struct stat st;
+      if ( fd >= 0 && fstat( fd, &st ) == 0 && st.st_size > 0 )
+      {
+        void* p{ mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0 ) };
+        if ( p != MAP_FAILED )
+        {
+          bytes = static_cast<const char*>( p );
+          numBytes = st.st_size;
+          mapped = true;
+        }
+      }
+      if ( fd >= 0 )
+      {
+        close( fd );
+      }
+    }
+
+    if ( !mapped )
+    {
+      synthesize();
+      bytes = synthesized.data();
+      numBytes = synthesized.size();
+    }
+  }
+
+  ~Capture()
+  {
+    if ( mapped )
+    {
+      munmap( const_cast<char*>( bytes ), numBytes );
+    }
+  }
+
+  // About 1 MiB of client frames, so masked: mostly small text messages,
+  // some medium binary ones, the odd large one and pings.
+  void synthesize()
+  {
+    std::mt19937 random{ 1234 };
+    while ( synthesized.size() < ( 1 << 20 ) )
+    {
+      const unsigned kind( random() % 100 );
+      ws::Header header;
+      header.fin = true;
+      header.isMasked = true;
+      const uint32_t mask( random() );
+      std::memcpy( header.mask, &mask, 4 );
+      if ( kind < 80 )
+      {
+        header.opCode = ws::Header::OpCode::eText;
+        header.payloadSize = 16 + random() % 240;
+      }
+      else if ( kind < 95 )
+      {
+        header.opCode = ws::Header::OpCode::eBinary;
+        header.payloadSize = 256 + random() % 4096;
+      }
+      else if ( kind < 97 )
+      {
+        header.opCode = ws::Header::OpCode::eBinary;
+        header.payloadSize = 64 * 1024 + random() % ( 64 * 1024 );
+      }
+      else
+      {
+        header.opCode = ws::Header::OpCode::ePing;
+        header.payloadSize = 4;
+      }
+
+      const size_t start{ synthesized.size() };
+      synthesized.resize( start + header.encodedSizeInBytes() + header.payloadSize, 'p' );
+      header.encode( synthesized.data() + start );
+    }
+  }
+
+  const char* bytes{ nullptr };
+  size_t numBytes{ 0 };
+  bool mapped{ false };
+  std::string synthesized;
+};
+
+enum class Chunking
+{
+  eOneByte,   //!< The worst case.
+  eMtu,       //!< One ethernet sized TCP segment per read.
+  eLarge,     //!< 64 KiB reads.
+  eMixed      //!< Anything from 1 byte to 16 KiB, small reads most likely.
+};
+
+const char* toString( Chunking chunking )
+{
+  switch ( chunking )
+  {
+  case Chunking::eOneByte:
+    return "1B";
+  case Chunking::eMtu:
+    return "MTU";
+  case Chunking::eLarge:
+    return "64KiB";
+  case Chunking::eMixed:
+    return "mixed";
+  }
+  return "?";
+}
+
+// The size of each read, covering the whole capture.
+std::vector<uint32_t> chunkSizes( Chunking chunking, size_t numBytes )
+{
+  std::mt19937 random{ 5678 };
+  std::geometric_distribution<uint32_t> mixed{ 1.0 / 2048 };
+
+  std::vector<uint32_t> sizes;
+  for ( size_t offset = 0; offset < numBytes; )
+  {
+    uint32_t size{ 1 };
+    switch ( chunking )
+    {
+    case Chunking::eOneByte:
+      break;
+    case Chunking::eMtu:
+      size = 1448;
+      break;
+    case Chunking::eLarge:
+      size = 64 * 1024;
+      break;
+    case Chunking::eMixed:
+      size = 1 + std::min<uint32_t>( mixed( random ), 16 * 1024 - 1 );
+      break;
+    }
+    size = uint32_t( std::min<size_t>( size, numBytes - offset ) );
+    sizes.push_back( size );
+    offset += size;
+  }
+  return sizes;
+}
+
+
+} // End of anonymous namespace
+
+
+// Replays the capture through Decoder::decode read by read.
+static void BM_WebSocketReplay( benchmark::State& state )
+{
+  const Chunking chunking{ Chunking( state.range(0) ) };
+  state.SetLabel( toString( chunking ) );
+
+  const Capture& capture{ Capture::get() };
+  const std::vector<uint32_t> sizes{ chunkSizes( chunking, capture.size() ) };
+  ws::LatencyHistogram perCall;
+  uint64_t numFrames{ 0 };
+
+  // Counts this thread's allocations while it exists, and nothing elsewhere.
+  AllocationCounter allocations;
+  for ( auto _ : state )
+  {
+    ws::Decoder decoder;
+    const char* p{ capture.data() };
+    for ( uint32_t size : sizes )
+    {
+      const auto start{ std::chrono::steady_clock::now() };
+      const auto result{ decoder.decode( p, size ) };
+      perCall.record( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - start ).count() );
+      numFrames += result.frames.size();
+      p += size;
+    }
+  }
+  const uint64_t numAllocationsDuring{ allocations.count() };
+
+  state.SetBytesProcessed( int64_t( state.iterations() ) * capture.size() );
+  state.counters[ "frames_per_second" ] = benchmark::Counter( double( numFrames ), benchmark::Counter::kIsRate );
+  state.counters[ "allocs_per_frame" ] = double( numAllocationsDuring ) / double( std::max<uint64_t>( numFrames, 1 ) );
+  state.counters[ "allocs_per_call" ] = double( numAllocationsDuring ) / double( perCall.count() );
+  state.counters[ "p50_ns" ] = double( perCall.valueAtPercentile( 50 ) );
+  state.counters[ "p99_ns" ] = double( perCall.valueAtPercentile( 99 ) );
+}
+BENCHMARK(BM_WebSocketReplay)->DenseRange( int( Chunking::eOneByte ), int( Chunking::eMixed ) )->Unit( benchmark::kMillisecond );
@@ -0,0 +1,197 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketring.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t numFrames{ 1000 };
+const size_t readSize{ 4096 };
+
+// numFrames small masked binary frames back to back, as a server receives.
+std::string frameStream( size_t payloadSize )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eBinary;
+  header.payloadSize = payloadSize;
+  header.isMasked = true;
+  header.mask[0] = 1;
+  header.mask[1] = 2;
+  header.mask[2] = 3;
+  header.mask[3] = 4;
+  std::string frame( header.encodedSizeInBytes(), '\0' );
+  header.encode( frame.data() );
+  frame += ws::encodeMaskedPayload( std::string( payloadSize, 'x' ), header.mask );
+
+  std::string stream;
+  for ( size_t i = 0; i < numFrames; ++i )
+  {
+    stream += frame;
+  }
+  return stream;
+}
+
+// Runs a consumer thread for the lifetime of a benchmark, counting frames.
+template< class Queue >
+class Consumer
+{
+public:
+  explicit Consumer( Queue& queue )
+    : thread{ [this, &queue]()
+              {
+                while ( !isStopping.load( std::memory_order_relaxed ) )
+                {
+                  const size_t n{ queue.drain() };
+                  if ( n == 0 )
+                  {
+                    std::this_thread::yield();
+                  }
+                  numConsumed.fetch_add( n, std::memory_order_relaxed );
+                }
+              } }
+  {
+  }
+
+  ~Consumer()
+  {
+    isStopping = true;
+    thread.join();
+  }
+
+  void waitFor( size_t total )
+  {
+    while ( numConsumed.load( std::memory_order_relaxed ) < total )
+    {
+      std::this_thread::yield();
+    }
+  }
+
+private:
+  std::atomic<size_t> numConsumed{ 0 };
+  std::atomic<bool> isStopping{ false };
+  std::thread thread;
+};
+
+struct Ring
+{
+  ws::FrameRing ring{ 256, 1 << 20 };
+  size_t numBytes{ 0 };
+
+  size_t drain()
+  {
+    size_t n{ 0 };
+    while ( const ws::FrameRing::Slot* slot = ring.front() )
+    {
+      numBytes += slot->header.payloadSize;
+      ring.pop();
+      ++n;
+    }
+    return n;
+  }
+};
+
+struct LockedDeque
+{
+  std::mutex mutex;
+  std::deque<ws::Frame> frames;
+  size_t numBytes{ 0 };
+
+  size_t drain()
+  {
+    std::deque<ws::Frame> taken;
+    {
+      std::lock_guard lock{ mutex };
+      taken.swap( frames );
+    }
+    for ( const auto& frame : taken )
+    {
+      numBytes += frame.payload.size();
+    }
+    return taken.size();
+  }
+};
+
+
+} // End of anonymous namespace
+
+
+// Frames decoded in place and copied once, unmasked, into the ring.
+static void BM_WebSocketHandOffRing( benchmark::State& state )
+{
+  const std::string stream{ frameStream( state.range(0) ) };
+  ws::Decoder decoder;
+  Ring queue;
+  Consumer consumer{ queue };
+  size_t total{ 0 };
+
+  for ( auto _ : state )
+  {
+    for ( size_t offset = 0; offset < stream.size(); offset += readSize )
+    {
+      decoder.decodeEach( stream.data() + offset
+                        , std::min( readSize, stream.size() - offset )
+                        , [&queue]( const ws::FrameView& view ) { queue.ring.push( view ); } );
+    }
+    total += numFrames;
+    consumer.waitFor( total );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFrames );
+}
+BENCHMARK(BM_WebSocketHandOffRing)->Arg( 16 )->Arg( 1024 )->UseRealTime();
+
+// The usual alternative: Decoder::decode's frames moved into a locked deque.
+static void BM_WebSocketHandOffLockedDeque( benchmark::State& state )
+{
+  const std::string stream{ frameStream( state.range(0) ) };
+  ws::Decoder decoder;
+  LockedDeque queue;
+  Consumer consumer{ queue };
+  size_t total{ 0 };
+
+  for ( auto _ : state )
+  {
+    for ( size_t offset = 0; offset < stream.size(); offset += readSize )
+    {
+      auto result{ decoder.decode( stream.data() + offset, std::min( readSize, stream.size() - offset ) ) };
+      std::lock_guard lock{ queue.mutex };
+      for ( auto& frame : result.frames )
+      {
+        queue.frames.push_back( std::move( frame ) );
+      }
+    }
+    total += numFrames;
+    consumer.waitFor( total );
+  }
+
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numFrames );
+}
+BENCHMARK(BM_WebSocketHandOffLockedDeque)->Arg( 16 )->Arg( 1024 )->UseRealTime();
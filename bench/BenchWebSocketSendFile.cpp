@@ -0,0 +1,187 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <lb/encoding/websocketsendfile.h>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t fileSize{ 16 << 20 };
+
+// A file of fileSize bytes that stays around for the lifetime of the process.
+// Being freshly written it will be in the page cache so we are measuring the
+// copy to the socket rather than the disk.
+int snapshotFile()
+{
+  static FILE* file{ nullptr };
+  if ( !file )
+  {
+    file = tmpfile();
+    std::vector<char> block( 1 << 16 );
+    for ( size_t i = 0; i < block.size(); ++i )
+    {
+      block[i] = char( i * 7 );
+    }
+    for ( size_t written = 0; written < fileSize; written += block.size() )
+    {
+      fwrite( block.data(), 1, block.size(), file );
+    }
+    fflush( file );
+  }
+  return fileno( file );
+}
+
+// A connected TCP pair over the loopback interface with a thread on the
+// receiving end that discards everything.
+class LoopbackConnection
+{
+public:
+  LoopbackConnection()
+  {
+    const int listener{ socket( AF_INET, SOCK_STREAM, 0 ) };
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    socklen_t addressSize{ sizeof(address) };
+    bind( listener, (sockaddr*)&address, addressSize );
+    listen( listener, 1 );
+    getsockname( listener, (sockaddr*)&address, &addressSize );
+
+    sender = socket( AF_INET, SOCK_STREAM, 0 );
+    connect( sender, (sockaddr*)&address, addressSize );
+    const int receiver{ accept( listener, nullptr, nullptr ) };
+    close( listener );
+
+    drainer = std::thread( [receiver]()
+    {
+      std::vector<char> buffer( 1 << 18 );
+      while ( read( receiver, buffer.data(), buffer.size() ) > 0 )
+      {
+      }
+      close( receiver );
+    } );
+  }
+
+  ~LoopbackConnection()
+  {
+    close( sender );
+    drainer.join();
+  }
+
+  int sender;
+
+private:
+  std::thread drainer;
+};
+
+bool writeAll( int fd, const char* p, size_t numBytes )
+{
+  while ( numBytes > 0 )
+  {
+    const ssize_t n{ write( fd, p, numBytes ) };
+    if ( n <= 0 )
+    {
+      return false;
+    }
+    p += n;
+    numBytes -= n;
+  }
+  return true;
+}
+
+
+} // End of anonymous namespace
+
+
+static void BM_WebSocketSendFile( benchmark::State& state )
+{
+  const size_t maxFramePayloadSize( state.range(0) );
+  const int fileFd{ snapshotFile() };
+  LoopbackConnection connection;
+
+  for ( auto _ : state )
+  {
+    ws::FileSender sender( fileFd, 0, fileSize, ws::Header::OpCode::eBinary, maxFramePayloadSize );
+    if ( sender.send( connection.sender ) != ws::FileSender::Status::eComplete )
+    {
+      state.SkipWithError( "sendfile failed" );
+      break;
+    }
+  }
+
+  state.SetBytesProcessed( int64_t( state.iterations() ) * fileSize );
+}
+BENCHMARK(BM_WebSocketSendFile)->Arg( 64 << 10 )->Arg( 1 << 20 )->UseRealTime();
+
+// The baseline: pread each frame's payload into a user space buffer straight
+// after its header and write the lot with a single call.
+static void BM_WebSocketReadWrite( benchmark::State& state )
+{
+  const size_t maxFramePayloadSize( state.range(0) );
+  const int fileFd{ snapshotFile() };
+  LoopbackConnection connection;
+
+  std::vector<char> buffer( ws::Header::maxSizeInBytes + maxFramePayloadSize );
+
+  for ( auto _ : state )
+  {
+    off_t offset{ 0 };
+    uint64_t numRemaining{ fileSize };
+    bool first{ true };
+    do
+    {
+      ws::Header header;
+      header.opCode = first ? ws::Header::OpCode::eBinary : ws::Header::OpCode::eContinuation;
+      header.payloadSize = std::min<uint64_t>( numRemaining, maxFramePayloadSize );
+      header.fin = ( header.payloadSize == numRemaining );
+      const size_t numHeaderBytes{ header.encodedSizeInBytes() };
+      char* payload{ buffer.data() + ws::Header::maxSizeInBytes };
+      header.encode( payload - numHeaderBytes );
+
+      if ( pread( fileFd, payload, header.payloadSize, offset ) != ssize_t( header.payloadSize )
+        || !writeAll( connection.sender, payload - numHeaderBytes, numHeaderBytes + header.payloadSize ) )
+      {
+        state.SkipWithError( "read/write failed" );
+        break;
+      }
+
+      offset += header.payloadSize;
+      numRemaining -= header.payloadSize;
+      first = false;
+    }
+    while ( numRemaining > 0 );
+  }
+
+  state.SetBytesProcessed( int64_t( state.iterations() ) * fileSize );
+}
+BENCHMARK(BM_WebSocketReadWrite)->Arg( 64 << 10 )->Arg( 1 << 20 )->UseRealTime();
@@ -0,0 +1,189 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <benchmark/benchmark.h>
+
+#include "PerfCounters.h"
+
+#include <lb/encoding/websockettable.h>
+
+#include <memory>
+
+#include <malloc.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+const size_t numConnections{ 100000 };
+
+// One in ten connections is left part way through a frame.
+const std::string frame{ "\x82\x85\x01\x02\x03\x04" "abcde", 11 };
+const size_t numPartialBytes{ 8 };
+
+size_t heapInUse()
+{
+  return mallinfo2().uordblks;
+}
+
+// The other way of doing things, one Decoder per connection, as a member of
+// some heap allocated connection object.
+struct Decoders
+{
+  Decoders()
+  {
+    const size_t before{ heapInUse() };
+    decoders.reserve( numConnections );
+    for ( size_t i = 0; i < numConnections; ++i )
+    {
+      decoders.push_back( std::make_unique<ws::Decoder>() );
+      if ( i % 10 == 0 )
+      {
+        decoders.back()->decode( frame.data(), numPartialBytes );
+      }
+    }
+    numBytes = heapInUse() - before;
+  }
+
+  std::vector<std::unique_ptr<ws::Decoder>> decoders;
+  size_t numBytes;
+};
+
+struct Table
+{
+  Table()
+  {
+    const size_t before{ heapInUse() };
+    for ( size_t i = 0; i < numConnections; ++i )
+    {
+      const ws::DecoderTable::Id id{ table.add() };
+      if ( i % 10 == 0 )
+      {
+        table.decode( id, frame.data(), numPartialBytes );
+      }
+    }
+    numBytes = heapInUse() - before;
+  }
+
+  ws::DecoderTable table;
+  size_t numBytes;
+};
+
+void report( benchmark::State& state, const PerfCounters& counters, size_t numBytes )
+{
+  counters.report( state, numConnections, "connection" );
+  state.counters[ "heap_bytes_per_connection" ] = double( numBytes ) / numConnections;
+  state.SetItemsProcessed( int64_t( state.iterations() ) * numConnections );
+}
+
+
+} // End of anonymous namespace
+
+
+// A sweep over every connection looking for those with a partial frame, as
+// a timeout pass might do.
+static void BM_WebSocketPendingSweepDecoders( benchmark::State& state )
+{
+  Decoders decoders;
+  PerfCounters counters;
+
+  counters.start();
+  for ( auto _ : state )
+  {
+    size_t numPending{ 0 };
+    for ( const auto& decoder : decoders.decoders )
+    {
+      numPending += decoder->hasPartialFrame();
+    }
+    benchmark::DoNotOptimize( numPending );
+  }
+  counters.stop();
+
+  report( state, counters, decoders.numBytes );
+}
+BENCHMARK(BM_WebSocketPendingSweepDecoders);
+
+static void BM_WebSocketPendingSweepTable( benchmark::State& state )
+{
+  Table table;
+  PerfCounters counters;
+
+  counters.start();
+  for ( auto _ : state )
+  {
+    size_t numPending{ 0 };
+    table.table.forEachPending( [&numPending]( ws::DecoderTable::Id ) { ++numPending; } );
+    benchmark::DoNotOptimize( numPending );
+  }
+  counters.stop();
+
+  report( state, counters, table.numBytes );
+}
+BENCHMARK(BM_WebSocketPendingSweepTable);
+
+// A small frame arriving on every connection in turn.
+static void BM_WebSocketDecodeAllDecoders( benchmark::State& state )
+{
+  Decoders decoders;
+  PerfCounters counters;
+
+  counters.start();
+  for ( auto _ : state )
+  {
+    size_t numBytes{ 0 };
+    for ( auto& decoder : decoders.decoders )
+    {
+      decoder->decodeEach( frame.data(), frame.size()
+                        , [&numBytes]( const ws::FrameView& view ) { numBytes += view.header.payloadSize; } );
+    }
+    benchmark::DoNotOptimize( numBytes );
+  }
+  counters.stop();
+
+  report( state, counters, decoders.numBytes );
+}
+BENCHMARK(BM_WebSocketDecodeAllDecoders);
+
+static void BM_WebSocketDecodeAllTable( benchmark::State& state )
+{
+  Table table;
+  PerfCounters counters;
+
+  counters.start();
+  for ( auto _ : state )
+  {
+    size_t numBytes{ 0 };
+    ws::FrameView view;
+    for ( ws::DecoderTable::Id id = 0; id < numConnections; ++id )
+    {
+      const char* p{ frame.data() };
+      size_t n{ frame.size() };
+      while ( table.table.decodeNextView( id, p, n, view ) == ws::Decoder::Step::eFrame )
+      {
+        numBytes += view.header.payloadSize;
+      }
+    }
+    benchmark::DoNotOptimize( numBytes );
+  }
+  counters.stop();
+
+  report( state, counters, table.numBytes );
+}
+BENCHMARK(BM_WebSocketDecodeAllTable);
@@ -0,0 +1,270 @@
+#ifndef LB_ENCODING_BENCH_PERFCOUNTERS_H
+#define LB_ENCODING_BENCH_PERFCOUNTERS_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Hardware event counts for benchmarks, read with perf_event_open(2).
+//
+// Only this process's user space events are counted so this works with the
+// default perf_event_paranoid setting of 2. Any event that cannot be opened,
+// as in many VMs and containers where there is no PMU at all, is left out
+// and simply not reported, so callers should check has() before deriving
+// anything from a count.
+//
+// The events are opened as one group, led by cycles when that is asked for,
+// so they are all counted over exactly the same instructions and ratios such
+// as IPC are consistent. If the group cannot be opened, e.g. one of the
+// events is missing, each event that can be is opened on its own instead.
+//
+// Counts are scaled up if the kernel had to multiplex the counters because
+// more events were requested than the PMU has counters for. A group that is
+// never scheduled, being bigger than the free counters, has no counts and is
+// not reported either.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+class PerfCounters
+{
+public:
+  struct Event
+  {
+    const char* name;
+    uint32_t type;
+    uint64_t config;
+  };
+
+  static uint64_t cacheEvent( uint64_t cache, uint64_t op, uint64_t result )
+  {
+    return cache | ( op << 8 ) | ( result << 16 );
+  }
+
+  static Event cycles()       { return { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES }; }
+  static Event instructions() { return { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS }; }
+  static Event branchMisses() { return { "branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES }; }
+  static Event cacheMisses()  { return { "cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES }; }
+  static Event l1dMisses()
+  {
+    return { "l1d_misses", PERF_TYPE_HW_CACHE, cacheEvent( PERF_COUNT_HW_CACHE_L1D
+                                                         , PERF_COUNT_HW_CACHE_OP_READ
+                                                         , PERF_COUNT_HW_CACHE_RESULT_MISS ) };
+  }
+  static Event llcMisses()
+  {
+    return { "llc_misses", PERF_TYPE_HW_CACHE, cacheEvent( PERF_COUNT_HW_CACHE_LL
+                                                         , PERF_COUNT_HW_CACHE_OP_READ
+                                                         , PERF_COUNT_HW_CACHE_RESULT_MISS ) };
+  }
+  static Event dtlbMisses()
+  {
+    return { "dtlb_misses", PERF_TYPE_HW_CACHE, cacheEvent( PERF_COUNT_HW_CACHE_DTLB
+                                                          , PERF_COUNT_HW_CACHE_OP_READ
+                                                          , PERF_COUNT_HW_CACHE_RESULT_MISS ) };
+  }
+
+  // Last level cache and data TLB misses.
+  static std::vector<Event> missEvents() { return { cacheMisses(), dtlbMisses() }; }
+
+  // What limits a codec: front end, branches or memory.
+  static std::vector<Event> codecEvents()
+  {
+    return { cycles(), instructions(), branchMisses(), l1dMisses(), llcMisses() };
+  }
+
+  explicit PerfCounters( std::vector<Event> events = missEvents() )
+  {
+    const auto cyclesEvent{ std::find_if( events.begin(), events.end(), []( const Event& event )
+    {
+      return event.type == PERF_TYPE_HARDWARE && event.config == PERF_COUNT_HW_CPU_CYCLES;
+    } ) };
+    std::rotate( events.begin(), cyclesEvent, cyclesEvent == events.end() ? cyclesEvent : cyclesEvent + 1 );
+
+    if ( !openGroup( events ) )
+    {
+      for ( const Event& event : events )
+      {
+        const int fd{ open( event, -1, PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING ) };
+        if ( fd >= 0 )
+        {
+          counters.push_back( { event.name, fd, {} } );
+        }
+      }
+    }
+  }
+
+  ~PerfCounters()
+  {
+    for ( const Counter& counter : counters )
+    {
+      close( counter.fd );
+    }
+  }
+
+  PerfCounters( const PerfCounters& ) = delete;
+  PerfCounters& operator=( const PerfCounters& ) = delete;
+
+  bool isAvailable() const { return !counters.empty(); }
+
+  bool has( const std::string& name ) const { return value( name ).has_value(); }
+
+  // The count between start() and stop(), if the event could be opened and
+  // was scheduled onto the PMU at all.
+  std::optional<double> value( const std::string& name ) const
+  {
+    for ( const Counter& counter : counters )
+    {
+      if ( counter.name == name )
+      {
+        return counter.total;
+      }
+    }
+    return {};
+  }
+
+  void start()
+  {
+    for ( Counter& counter : counters )
+    {
+      counter.total.reset();
+    }
+    if ( isGroup )
+    {
+      ioctl( counters.front().fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP );
+      ioctl( counters.front().fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP );
+      return;
+    }
+    for ( const Counter& counter : counters )
+    {
+      ioctl( counter.fd, PERF_EVENT_IOC_RESET, 0 );
+      ioctl( counter.fd, PERF_EVENT_IOC_ENABLE, 0 );
+    }
+  }
+
+  void stop()
+  {
+    if ( isGroup )
+    {
+      ioctl( counters.front().fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP );
+
+      // The number of events, the times enabled and running, then the values
+      // in the order the events were opened.
+      std::vector<uint64_t> values( 3 + counters.size(), 0 );
+      const ssize_t numBytes( values.size() * sizeof( uint64_t ) );
+      // Never running means the PMU had no room for the group, e.g. fewer
+      // free counters than events, so there are no counts at all.
+      if ( read( counters.front().fd, values.data(), numBytes ) == numBytes && values[2] > 0 )
+      {
+        const double scale{ double( values[1] ) / double( values[2] ) };
+        for ( size_t i = 0; i < counters.size(); ++i )
+        {
+          counters[i].total = double( values[ 3 + i ] ) * scale;
+        }
+      }
+      return;
+    }
+    for ( const Counter& counter : counters )
+    {
+      ioctl( counter.fd, PERF_EVENT_IOC_DISABLE, 0 );
+    }
+    for ( Counter& counter : counters )
+    {
+      // The value, then the times enabled and running.
+      uint64_t values[3] = { 0, 0, 0 };
+      if ( read( counter.fd, values, sizeof( values ) ) == sizeof( values ) && values[2] > 0 )
+      {
+        counter.total = double( values[0] ) * double( values[1] ) / double( values[2] );
+      }
+    }
+  }
+
+  // Adds each count divided by state.iterations() and by perIteration, the
+  // number of items each iteration processes, to the benchmark's counters,
+  // suffixed by perName e.g. cycles_per_byte.
+  void report( benchmark::State& state, double perIteration = 1.0, const std::string& perName = "" ) const
+  {
+    const std::string suffix{ perName.empty() ? "" : "_per_" + perName };
+    for ( const Counter& counter : counters )
+    {
+      if ( counter.total )
+      {
+        state.counters[ counter.name + suffix ] = *counter.total / ( double( state.iterations() ) * perIteration );
+      }
+    }
+  }
+
+private:
+  struct Counter
+  {
+    std::string name;
+    int fd;
+    std::optional<double> total;
+  };
+
+  static int open( const Event& event, int groupFd, uint64_t readFormat )
+  {
+    perf_event_attr attr;
+    std::memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = groupFd < 0; // Members follow their leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = readFormat;
+    return syscall( SYS_perf_event_open, &attr, 0, -1, groupFd, 0 );
+  }
+
+  // All or nothing, the first event leads.
+  bool openGroup( const std::vector<Event>& events )
+  {
+    const uint64_t readFormat{ PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING };
+    for ( const Event& event : events )
+    {
+      const int fd{ open( event, counters.empty() ? -1 : counters.front().fd, readFormat ) };
+      if ( fd < 0 )
+      {
+        for ( const Counter& counter : counters )
+        {
+          close( counter.fd );
+        }
+        counters.clear();
+        return false;
+      }
+      counters.push_back( { event.name, fd, {} } );
+    }
+    isGroup = !counters.empty();
+    return isGroup;
+  }
+
+  std::vector<Counter> counters;
+  bool isGroup{ false };
+};
+
+
+#endif // LB_ENCODING_BENCH_PERFCOUNTERS_H
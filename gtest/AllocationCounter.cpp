@@ -0,0 +1,124 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "AllocationCounter.h"
+
+#include <cerrno>
+#include <cstdlib>
+
+
+// glibc's own allocator, which the replacements below forward to.
+extern "C"
+{
+void* __libc_malloc( size_t );
+void* __libc_calloc( size_t, size_t );
+void* __libc_realloc( void*, size_t );
+void* __libc_memalign( size_t, size_t );
+void __libc_free( void* );
+}
+
+
+namespace
+{
+
+
+// Thread locals of the executable itself need no allocation to set up so
+// are safe to use from within malloc.
+thread_local size_t numAllocations{ 0 };
+thread_local bool isCounting{ false };
+
+void counted()
+{
+  if ( isCounting )
+  {
+    ++numAllocations;
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+extern "C"
+{
+
+void* malloc( size_t numBytes )
+{
+  counted();
+  return __libc_malloc( numBytes );
+}
+
+void* calloc( size_t numElements, size_t elementSize )
+{
+  counted();
+  return __libc_calloc( numElements, elementSize );
+}
+
+void* realloc( void* p, size_t numBytes )
+{
+  counted();
+  return __libc_realloc( p, numBytes );
+}
+
+void* aligned_alloc( size_t alignment, size_t numBytes )
+{
+  counted();
+  return __libc_memalign( alignment, numBytes );
+}
+
+void* memalign( size_t alignment, size_t numBytes )
+{
+  counted();
+  return __libc_memalign( alignment, numBytes );
+}
+
+int posix_memalign( void** p, size_t alignment, size_t numBytes )
+{
+  counted();
+  *p = __libc_memalign( alignment, numBytes );
+  return *p ? 0 : ENOMEM;
+}
+
+void free( void* p )
+{
+  __libc_free( p );
+}
+
+} // extern "C"
+
+
+AllocationCounter::AllocationCounter()
+  : start{ numAllocations }
+  , wasCounting{ isCounting }
+{
+  isCounting = true;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+  isCounting = wasCounting;
+}
+
+size_t AllocationCounter::count() const
+{
+  return numAllocations - start;
+}
+
+void AllocationCounter::reset()
+{
+  start = numAllocations;
+}
@@ -0,0 +1,56 @@
+#ifndef LB_ENCODING_GTEST_ALLOCATIONCOUNTER_H
+#define LB_ENCODING_GTEST_ALLOCATIONCOUNTER_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Counts heap allocations made by the calling thread, for tests that pin
+// down exactly how many allocations an API makes:
+//
+//   AllocationCounter counter;
+//   hex::encode( src, numSrcBytes, dst );
+//   EXPECT_EQ( counter.count(), 0U );
+//
+// malloc, calloc, realloc and the aligned allocation functions are replaced
+// in the test and benchmark binaries, see AllocationCounter.cpp. operator new
+// in all its forms goes through them so is counted too. While no counter
+// exists on a thread its allocations only cost a check of a thread local.
+
+#include <cstddef>
+
+
+class AllocationCounter
+{
+public:
+  AllocationCounter();
+  ~AllocationCounter();
+
+  AllocationCounter( const AllocationCounter& ) = delete;
+  AllocationCounter& operator=( const AllocationCounter& ) = delete;
+
+  /** \brief Allocations made by this thread since construction or reset(). */
+  size_t count() const;
+
+  void reset();
+
+private:
+  size_t start;
+  bool wasCounting;
+};
+
+
+#endif // LB_ENCODING_GTEST_ALLOCATIONCOUNTER_H
@@ -0,0 +1,257 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include "AllocationCounter.h"
+
+#include <lb/encoding/base64.h>
+#include <lb/encoding/base64stream.h>
+#include <lb/encoding/bits.h>
+#include <lb/encoding/hex.h>
+#include <lb/encoding/sha1.h>
+#include <lb/encoding/websocket.h>
+#include <lb/encoding/websocketbatch.h>
+#include <lb/encoding/websocketmask.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+// Covers the short string optimisation boundary of std::string, whose
+// characters only need the heap beyond 15 of them, and SHA1's 55/56 and 64
+// byte padding boundaries.
+const size_t sizes[] = { 0, 1, 2, 3, 7, 8, 11, 12, 15, 16, 55, 56, 63, 64, 65, 119, 120, 1000, 100000 };
+
+// The allocation std::string makes for a string of this many characters.
+size_t stringAllocations( size_t numChars )
+{
+  return numChars > 15 ? 1 : 0;
+}
+
+std::string frameBytes( size_t payloadSize, bool isMasked )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eBinary;
+  header.payloadSize = payloadSize;
+  header.isMasked = isMasked;
+  std::string bytes( header.encodedSizeInBytes(), '\0' );
+  header.encode( bytes.data() );
+  return bytes + std::string( payloadSize, 'p' );
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Allocations, Counter)
+{
+  AllocationCounter counter;
+  EXPECT_EQ( counter.count(), 0U );
+  auto p{ std::make_unique<int>( 1 ) };
+  std::vector<int> v( 10 );
+  EXPECT_EQ( counter.count(), 2U );
+  counter.reset();
+  EXPECT_EQ( counter.count(), 0U );
+}
+
+TEST(Allocations, PointerEncoders)
+{
+  const uint8_t mask[4] = { 1, 2, 3, 4 };
+
+  for ( size_t size : sizes )
+  {
+    const std::vector<char> src( size, 'x' );
+    std::vector<char> dst( 8 * size + 32 );
+    std::vector<char> decoded( size + 3 );
+    const char* srcs[1] = { src.data() };
+    const size_t numSrcChars[1] = { size };
+
+    AllocationCounter counter;
+
+    lb::encoding::base64::encode( src.data(), size, dst.data() );
+    EXPECT_EQ( counter.count(), 0U ) << "base64 " << size;
+
+    // The streaming encoder and decoder keep constant state whatever the
+    // chunking.
+    lb::encoding::base64::Encoder encoder;
+    size_t numEncoded{ 0 };
+    for ( size_t i = 0; i < size; i += 7 )
+    {
+      numEncoded += encoder.update( src.data() + i, std::min<size_t>( 7, size - i ), dst.data() + numEncoded );
+    }
+    numEncoded += encoder.finish( dst.data() + numEncoded );
+    EXPECT_EQ( counter.count(), 0U ) << "base64 stream " << size;
+
+    lb::encoding::base64::Decoder decoder;
+    size_t numDecoded{ 0 };
+    for ( size_t i = 0; i < numEncoded; i += 7 )
+    {
+      numDecoded += decoder.update( dst.data() + i, std::min<size_t>( 7, numEncoded - i ), decoded.data() + numDecoded ).numDstBytes;
+    }
+    EXPECT_EQ( decoder.finish().status, lb::encoding::base64::DecodeResult::Status::eSuccess );
+    EXPECT_EQ( numDecoded, size );
+    EXPECT_EQ( counter.count(), 0U ) << "base64 stream decode " << size;
+
+    lb::encoding::hex::encode( src.data(), size, dst.data() );
+    EXPECT_EQ( counter.count(), 0U ) << "hex " << size;
+
+    for ( size_t i = 0; i < size; ++i )
+    {
+      lb::encoding::bits::encode( src[i], dst.data() + 8 * i );
+    }
+    EXPECT_EQ( counter.count(), 0U ) << "bits " << size;
+
+    lb::encoding::sha1::encode( src.data(), size, dst.data() );
+    EXPECT_EQ( counter.count(), 0U ) << "sha1 " << size;
+
+    lb::encoding::sha1::encodeBatch( srcs, numSrcChars, 1, dst.data() );
+    EXPECT_EQ( counter.count(), 0U ) << "sha1 batch " << size;
+
+    ws::encodeMaskedPayload( src.data(), size, mask, dst.data() );
+    EXPECT_EQ( counter.count(), 0U ) << "mask " << size;
+  }
+}
+
+TEST(Allocations, StringEncoders)
+{
+  const uint8_t mask[4] = { 1, 2, 3, 4 };
+
+  for ( size_t size : sizes )
+  {
+    const std::string src( size, 'x' );
+    const std::string encoded{ lb::encoding::base64::encode( src ) };
+    std::string inPlace( src );
+
+    AllocationCounter counter;
+
+    {
+      const std::string dst{ lb::encoding::base64::encode( src ) };
+      EXPECT_EQ( counter.count(), stringAllocations( dst.size() ) ) << "base64 " << size;
+    }
+    counter.reset();
+    {
+      const auto dst{ lb::encoding::base64::decode( encoded ) };
+      EXPECT_EQ( counter.count(), stringAllocations( encoded.size() / 4 * 3 ) ) << "base64 decode " << size;
+    }
+    counter.reset();
+    {
+      const std::string dst{ lb::encoding::hex::encode( src ) };
+      EXPECT_EQ( counter.count(), stringAllocations( dst.size() ) ) << "hex " << size;
+    }
+    counter.reset();
+    {
+      const std::string dst{ lb::encoding::sha1::encode( src ) };
+      EXPECT_EQ( counter.count(), 1U ) << "sha1 " << size;
+    }
+    counter.reset();
+    {
+      const std::string dst{ ws::encodeMaskedPayload( src, mask ) };
+      EXPECT_EQ( counter.count(), stringAllocations( size ) ) << "mask " << size;
+    }
+    counter.reset();
+    ws::encodeMaskedPayload( inPlace, mask );
+    EXPECT_EQ( counter.count(), 0U ) << "mask in place " << size;
+  }
+}
+
+TEST(Allocations, WebSocketDecoder)
+{
+  for ( size_t size : sizes )
+  {
+    const std::string bytes{ frameBytes( size, true ) + frameBytes( size, false ) };
+
+    // The Result's vector of frames and, beyond the short string limit, each
+    // payload. The vector grows once for the second frame.
+    {
+      ws::Decoder decoder;
+      AllocationCounter counter;
+      const auto result{ decoder.decode( bytes.data(), bytes.size() ) };
+      EXPECT_EQ( result.frames.size(), 2U );
+      EXPECT_EQ( counter.count(), 2 + 2 * stringAllocations( size ) ) << "decode " << size;
+    }
+
+    // Reusing one Frame only allocates while its payload grows.
+    {
+      ws::Decoder decoder;
+      ws::Frame frame;
+      frame.payload.reserve( size );
+      AllocationCounter counter;
+      const char* p{ bytes.data() };
+      size_t numBytes{ bytes.size() };
+      while ( decoder.decodeNext( p, numBytes, frame ) == ws::Decoder::Step::eFrame )
+      {
+      }
+      EXPECT_EQ( counter.count(), 0U ) << "decodeNext " << size;
+    }
+
+    // Views never allocate, nor does caching a partial frame that fits in
+    // the cache reserved up front.
+    {
+      ws::Decoder decoder;
+      AllocationCounter counter;
+      size_t numFrames{ 0 };
+      const size_t split{ std::min<size_t>( bytes.size(), 1000 ) };
+      EXPECT_TRUE( decoder.decodeEach( bytes.data(), split, [&]( const ws::FrameView& ) { ++numFrames; } ) );
+      EXPECT_TRUE( decoder.decodeEach( bytes.data() + split, bytes.size() - split, [&]( const ws::FrameView& ) { ++numFrames; } ) );
+      EXPECT_EQ( numFrames, 2U );
+      if ( size < 1000 )
+      {
+        EXPECT_EQ( counter.count(), 0U ) << "decodeEach " << size;
+      }
+    }
+  }
+}
+
+TEST(Allocations, WebSocketEncoding)
+{
+  ws::FrameBatcher batcher;
+  ws::MaskGenerator generator;
+  const std::string payload( 100, 'x' );
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eText;
+  header.payloadSize = payload.size();
+
+  // Warm up the batcher's buffer and book keeping, and the thread's
+  // generator.
+  for ( size_t i = 0; i < 64; ++i )
+  {
+    batcher.append( header, payload );
+  }
+  batcher.clear();
+  ws::setRandomMask( header );
+
+  AllocationCounter counter;
+  for ( size_t i = 0; i < 64; ++i )
+  {
+    uint8_t mask[4];
+    generator.next( mask );
+    ws::setRandomMask( header );
+    batcher.append( header, payload );
+  }
+  EXPECT_EQ( counter.count(), 0U );
+}
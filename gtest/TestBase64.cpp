@@ -17,7 +17,12 @@
 
 #include <gtest/gtest.h>
 
+#include "TestHelpers.h"
+
 #include <lb/encoding/base64.h>
+#include <lb/encoding/base64inline.h>
+
+#include <random>
 
 
 TEST(Encoding, Base64)
@@ -64,3 +69,245 @@ TEST(Encoding, Base64)
 
 
 }
+
+TEST(Encoding, Base64Inline)
+{
+  // Same output as the library for every length of padding.
+  std::string src;
+  for ( size_t size = 0; size < 100; ++size )
+  {
+    const std::string expected{ lb::encoding::base64::encode( src ) };
+    std::string dst( expected.size(), '\0' );
+    lb::encoding::base64::inlined::encode( src.data(), src.size(), dst.data() );
+    EXPECT_EQ( dst, expected ) << size;
+    src.push_back( char( size * 37 + 11 ) );
+  }
+}
+
+TEST(Encoding, Base64Kernels)
+{
+  const std::string src{ randomBytes( 20000 ) };
+
+  // Every kernel the CPU supports gives the scalar code's output, whatever
+  // is left over for the tail.
+  forEachSupportedTier( [&]()
+  {
+    for ( size_t size = 0; size <= 1000; size += ( size < 200 ? 1 : 97 ) )
+    {
+      std::string expected( 4 * ( ( size + 2 ) / 3 ), '\0' );
+      lb::encoding::base64::inlined::encode( src.data(), size, expected.data() );
+      EXPECT_EQ( lb::encoding::base64::encode( src.substr( 0, size ) ), expected ) << size;
+    }
+
+    // Random lengths from random offsets, checking nothing is written past
+    // the end of the output either.
+    std::mt19937 random{ 42 };
+    for ( int i = 0; i < 500; ++i )
+    {
+      const size_t offset{ random() % 64 };
+      const size_t size{ random() % ( src.size() - offset ) };
+      const size_t numDstChars{ 4 * ( ( size + 2 ) / 3 ) };
+      std::string expected( numDstChars, '\0' );
+      lb::encoding::base64::inlined::encode( src.data() + offset, size, expected.data() );
+
+      std::string dst( numDstChars + 64, '#' );
+      lb::encoding::base64::encode( src.data() + offset, size, dst.data() );
+      EXPECT_EQ( dst.substr( 0, numDstChars ), expected ) << offset << " " << size;
+      EXPECT_EQ( dst.substr( numDstChars ), std::string( 64, '#' ) ) << offset << " " << size;
+    }
+  } );
+}
+
+TEST(Decoding, Base64)
+{
+  namespace base64 = lb::encoding::base64;
+  using Status = base64::DecodeResult::Status;
+
+  // RFC 4648 section 10.
+  EXPECT_EQ( base64::decode( "" ), "" );
+  EXPECT_EQ( base64::decode( "Zg==" ), "f" );
+  EXPECT_EQ( base64::decode( "Zm8=" ), "fo" );
+  EXPECT_EQ( base64::decode( "Zm9v" ), "foo" );
+  EXPECT_EQ( base64::decode( "Zm9vYg==" ), "foob" );
+  EXPECT_EQ( base64::decode( "Zm9vYmE=" ), "fooba" );
+  EXPECT_EQ( base64::decode( "Zm9vYmFy" ), "foobar" );
+  EXPECT_EQ( base64::decode( "AA==" ), std::string( "\0", 1 ) );
+  EXPECT_EQ( base64::decode( "L9ThxnotKPzthJ7hu3bnORuT6xI=" )
+           , "\x2f\xd4\xe1\xc6\x7a\x2d\x28\xfc\xed\x84\x9e\xe1\xbb\x76\xe7\x39\x1b\x93\xeb\x12" );
+
+  // Where and why invalid input is rejected.
+  struct Invalid
+  {
+    std::string src;
+    Status status;
+    size_t errorPosition;
+    size_t numDstBytes;
+  };
+  for ( const Invalid& invalid : { Invalid{ "Zm9", Status::eInvalidLength, 3, 0 }
+                                 , Invalid{ "Zm9vY", Status::eInvalidLength, 5, 3 }
+                                 , Invalid{ "Zg=", Status::eInvalidLength, 3, 0 }
+                                 , Invalid{ "Zm9v Zm9v", Status::eInvalidCharacter, 4, 3 }
+                                 , Invalid{ "Zm9vZm9\n", Status::eInvalidCharacter, 7, 3 }
+                                 , Invalid{ "Zm-v", Status::eInvalidCharacter, 2, 0 }
+                                 , Invalid{ "Zg=!", Status::eInvalidCharacter, 3, 0 }
+                                 , Invalid{ "Zg==Zg==", Status::eInvalidPadding, 2, 0 }
+                                 , Invalid{ "Zg=a", Status::eInvalidPadding, 3, 0 }
+                                 , Invalid{ "Z===", Status::eInvalidPadding, 1, 0 }
+                                 , Invalid{ "====", Status::eInvalidPadding, 0, 0 }
+                                 , Invalid{ "Zm9vZh==", Status::eInvalidPadding, 5, 3 }
+                                 , Invalid{ "Zm9=", Status::eInvalidPadding, 2, 0 } } )
+  {
+    char dst[16];
+    const base64::DecodeResult result{ base64::decode( invalid.src.data(), invalid.src.size(), dst ) };
+    EXPECT_EQ( base64::DecodeResult::toString( result.status ), base64::DecodeResult::toString( invalid.status ) ) << invalid.src;
+    EXPECT_EQ( result.errorPosition, invalid.errorPosition ) << invalid.src;
+    EXPECT_EQ( result.numDstBytes, invalid.numDstBytes ) << invalid.src;
+    EXPECT_FALSE( base64::decode( invalid.src ) ) << invalid.src;
+  }
+}
+
+TEST(Decoding, Base64Kernels)
+{
+  namespace base64 = lb::encoding::base64;
+
+  const std::string bytes{ randomBytes( 3000 ) };
+
+  forEachSupportedTier( [&]()
+  {
+    // Round trips of every length up to a few kernel iterations and then
+    // some longer ones, checking nothing is written past the end either.
+    for ( size_t size = 0; size <= bytes.size(); size += ( size < 300 ? 1 : 331 ) )
+    {
+      const std::string encoded{ base64::encode( bytes.substr( 0, size ) ) };
+      std::string dst( encoded.size() / 4 * 3 + 32, '#' );
+      const base64::DecodeResult result{ base64::decode( encoded.data(), encoded.size(), dst.data() ) };
+      ASSERT_EQ( result.status, base64::DecodeResult::Status::eSuccess ) << size;
+      EXPECT_EQ( result.numDstBytes, size );
+      EXPECT_EQ( dst.substr( 0, size ), bytes.substr( 0, size ) );
+      EXPECT_EQ( dst.substr( encoded.size() / 4 * 3 ), std::string( 32, '#' ) ) << size;
+    }
+
+    // Every byte value outside the alphabet, at a spread of positions, is
+    // found exactly by whichever kernel meets it.
+    const std::string encoded{ base64::encode( bytes.substr( 0, 600 ) ) };
+    std::mt19937 random{ 7 };
+    for ( int byte = 0; byte < 256; ++byte )
+    {
+      const char c( byte );
+      if ( ( '0' <= c && c <= '9' ) || ( 'A' <= c && c <= 'Z' ) || ( 'a' <= c && c <= 'z' )
+        || c == '+' || c == '/' )
+      {
+        continue;
+      }
+
+      const size_t position{ random() % ( encoded.size() - 4 ) };
+      std::string corrupt{ encoded };
+      corrupt[ position ] = c;
+      std::string dst( encoded.size() / 4 * 3, '\0' );
+      const base64::DecodeResult result{ base64::decode( corrupt.data(), corrupt.size(), dst.data() ) };
+      EXPECT_EQ( result.status, c == '=' ? base64::DecodeResult::Status::eInvalidPadding
+                                         : base64::DecodeResult::Status::eInvalidCharacter ) << byte;
+      EXPECT_EQ( result.errorPosition, position ) << byte;
+      EXPECT_EQ( result.numDstBytes, position / 4 * 3 ) << byte;
+      EXPECT_EQ( dst.substr( 0, result.numDstBytes ), bytes.substr( 0, result.numDstBytes ) ) << byte;
+    }
+  } );
+}
+
+TEST(Encoding, Base64Alphabets)
+{
+  namespace base64 = lb::encoding::base64;
+
+  // The bytes for both characters 62 and 63, with each amount of padding.
+  EXPECT_EQ( base64::encode( "\xfb\xff\xbf" ), "+/+/" );
+  EXPECT_EQ( base64::encode<base64::Url>( "\xfb\xff\xbf" ), "-_-_" );
+  EXPECT_EQ( base64::encode<base64::Url>( "\xfb\xff" ), "-_8=" );
+  EXPECT_EQ( base64::encode<base64::UrlUnpadded>( "\xfb\xff" ), "-_8" );
+  EXPECT_EQ( base64::encode<base64::UrlUnpadded>( "\xfb" ), "-w" );
+  EXPECT_EQ( base64::encode<base64::StandardUnpadded>( "\xfb" ), "+w" );
+  EXPECT_EQ( base64::encode<base64::UrlUnpadded>( "" ), "" );
+
+  char encoded[4];
+  base64::inlined::encode<base64::Alphabet<'.', ',', false>>( "\xfb\xff", 2, encoded );
+  EXPECT_EQ( std::string( encoded, 3 ), ".,8" );
+
+  // The plain overloads the library kept from before the templates.
+  void ( *plainEncode )( const char*, size_t, char* ){ base64::encode };
+  base64::DecodeResult ( *plainDecode )( const char*, size_t, char* ){ base64::decode };
+  plainEncode( "\xfb\xff", 2, encoded );
+  EXPECT_EQ( std::string( encoded, 4 ), "+/8=" );
+  EXPECT_EQ( plainDecode( "+/8=", 4, encoded ).numDstBytes, 2U );
+
+  const std::string src{ randomBytes( 3000 ) };
+
+  forEachSupportedTier( [&]()
+  {
+    for ( size_t size = 0; size <= src.size(); size += ( size < 200 ? 1 : 97 ) )
+    {
+      const std::string bytes{ src.substr( 0, size ) };
+
+      // Every other alphabet is the standard one with the characters
+      // replaced or the padding removed.
+      std::string url{ base64::encode( bytes ) };
+      for ( char& c : url )
+      {
+        c = c == '+' ? '-' : c == '/' ? '_' : c;
+      }
+      std::string urlUnpadded{ url };
+      while ( !urlUnpadded.empty() && urlUnpadded.back() == '=' )
+      {
+        urlUnpadded.pop_back();
+      }
+
+      ASSERT_EQ( base64::encode<base64::Url>( bytes ), url ) << size;
+      ASSERT_EQ( base64::encode<base64::UrlUnpadded>( bytes ), urlUnpadded ) << size;
+      EXPECT_EQ( urlUnpadded.size(), base64::encodedSize<base64::UrlUnpadded>( size ) );
+
+      EXPECT_EQ( base64::decode<base64::Url>( url ), bytes ) << size;
+      EXPECT_EQ( base64::decode<base64::UrlUnpadded>( urlUnpadded ), bytes ) << size;
+
+      // Each only accepts its own.
+      if ( url.find_first_of( "-_" ) != std::string::npos )
+      {
+        EXPECT_FALSE( base64::decode( url ) ) << size;
+      }
+      if ( url != urlUnpadded )
+      {
+        EXPECT_FALSE( base64::decode<base64::Url>( urlUnpadded ) ) << size;
+        EXPECT_FALSE( base64::decode<base64::UrlUnpadded>( url ) ) << size;
+      }
+    }
+
+    // Every byte value outside the url alphabet, at a spread of positions, is
+    // found exactly by whichever kernel meets it. That includes '+' and '/'.
+    const std::string encoded{ base64::encode<base64::UrlUnpadded>( src.substr( 0, 600 ) ) };
+    std::mt19937 random{ 11 };
+    for ( int byte = 0; byte < 256; ++byte )
+    {
+      const char c( byte );
+      if ( ( '0' <= c && c <= '9' ) || ( 'A' <= c && c <= 'Z' ) || ( 'a' <= c && c <= 'z' )
+        || c == '-' || c == '_' )
+      {
+        continue;
+      }
+
+      const size_t position{ random() % encoded.size() };
+      std::string corrupt{ encoded };
+      corrupt[ position ] = c;
+      std::string dst( encoded.size(), '\0' );
+      const base64::DecodeResult result{ base64::decode<base64::UrlUnpadded>( corrupt.data(), corrupt.size(), dst.data() ) };
+      EXPECT_EQ( result.status, c == '=' ? base64::DecodeResult::Status::eInvalidPadding
+                                         : base64::DecodeResult::Status::eInvalidCharacter ) << byte;
+      EXPECT_EQ( result.errorPosition, position ) << byte;
+      EXPECT_EQ( result.numDstBytes, position / 4 * 3 ) << byte;
+    }
+  } );
+
+  // Without padding a lone final character is the only bad length.
+  using Status = base64::DecodeResult::Status;
+  char dst[16];
+  EXPECT_EQ( base64::decode<base64::UrlUnpadded>( "Zm9vZ", 5, dst ).status, Status::eInvalidLength );
+  EXPECT_EQ( base64::decode<base64::UrlUnpadded>( "Zg", 2, dst ).numDstBytes, 1U );
+  EXPECT_EQ( base64::decode<base64::UrlUnpadded>( "Zh", 2, dst ).status, Status::eInvalidPadding );
+  EXPECT_EQ( base64::decode<base64::UrlUnpadded>( "Zg==", 4, dst ).errorPosition, 2U );
+}
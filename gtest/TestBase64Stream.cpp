@@ -0,0 +1,221 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include "TestHelpers.h"
+
+#include <lb/encoding/base64stream.h>
+
+#include <random>
+#include <vector>
+
+
+namespace base64 = lb::encoding::base64;
+using Status = base64::DecodeResult::Status;
+
+
+namespace
+{
+
+
+// Splits \a size into chunks, some of them empty, some of them one or two
+// bytes and some long enough for the kernels.
+std::vector<size_t> randomChunks( size_t size, std::mt19937& random )
+{
+  std::vector<size_t> chunks;
+  while ( size > 0 )
+  {
+    const size_t chunk{ std::min<size_t>( size, random() % 4 == 0 ? random() % 3
+                                                                  : random() % 200 ) };
+    chunks.push_back( chunk );
+    size -= chunk;
+  }
+  return chunks;
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Base64Stream, Encoder)
+{
+  const std::string bytes{ randomBytes( 2000 ) };
+
+  base64::Encoder encoder;
+  std::mt19937 random{ 42 };
+  for ( size_t size = 0; size <= bytes.size(); size += ( size < 100 ? 1 : 173 ) )
+  {
+    const std::string src{ bytes.substr( 0, size ) };
+    for ( int repeat = 0; repeat < 10; ++repeat )
+    {
+      std::string encoded;
+      size_t position{ 0 };
+      for ( size_t chunk : randomChunks( size, random ) )
+      {
+        // Exactly updateSize() is written, checking no more than that.
+        const size_t numDstChars{ encoder.updateSize( chunk ) };
+        std::string dst( numDstChars + 16, '#' );
+        EXPECT_EQ( encoder.update( src.data() + position, chunk, dst.data() ), numDstChars );
+        EXPECT_EQ( dst.substr( numDstChars ), std::string( 16, '#' ) );
+        encoded += dst.substr( 0, numDstChars );
+        position += chunk;
+      }
+      encoded += encoder.finish();
+
+      // The encoder is reusable after finish().
+      ASSERT_EQ( encoded, base64::encode( src ) ) << size;
+    }
+  }
+
+  EXPECT_EQ( encoder.update( "M" ), "" );
+  EXPECT_EQ( encoder.update( "an" ), "TWFu" );
+  EXPECT_EQ( encoder.update( "M" ), "" );
+  EXPECT_EQ( encoder.finish(), "TQ==" );
+  EXPECT_EQ( encoder.finish(), "" );
+}
+
+TEST(Base64Stream, Decoder)
+{
+  const std::string bytes{ randomBytes( 2000 ) };
+
+  base64::Decoder decoder;
+  std::mt19937 random{ 7 };
+  for ( size_t size = 0; size <= bytes.size(); size += ( size < 100 ? 1 : 173 ) )
+  {
+    const std::string src{ base64::encode( bytes.substr( 0, size ) ) };
+    for ( int repeat = 0; repeat < 10; ++repeat )
+    {
+      std::string decoded;
+      size_t position{ 0 };
+      for ( size_t chunk : randomChunks( src.size(), random ) )
+      {
+        const size_t numDstBytes{ decoder.updateSize( chunk ) };
+        std::string dst( numDstBytes + 16, '#' );
+        const base64::DecodeResult result{ decoder.update( src.data() + position, chunk, dst.data() ) };
+        ASSERT_EQ( result.status, Status::eSuccess ) << size;
+        EXPECT_LE( result.numDstBytes, numDstBytes );
+        EXPECT_EQ( dst.substr( numDstBytes ), std::string( 16, '#' ) );
+        decoded += dst.substr( 0, result.numDstBytes );
+        position += chunk;
+      }
+      EXPECT_EQ( decoder.finish().status, Status::eSuccess );
+
+      ASSERT_EQ( decoded, bytes.substr( 0, size ) ) << size;
+    }
+  }
+
+  EXPECT_EQ( decoder.update( "Zm9" ), "" );
+  EXPECT_EQ( decoder.update( "vYg" ), "foo" );
+  EXPECT_EQ( decoder.update( "=" ), "" );
+  EXPECT_EQ( decoder.update( "=" ), "b" );
+  EXPECT_EQ( decoder.finish().status, Status::eSuccess );
+}
+
+TEST(Base64Stream, DecoderErrors)
+{
+  // Errors are found, and placed in the stream, wherever the chunks split.
+  for ( const std::string src : { "Zm9vZm9v Zm9v"
+                                , "Zm9vZm9vZm-v"
+                                , "Zm9vZm9vZh=="
+                                , "Zm9vZg==Zm9v"
+                                , "Zm9vZm8=Z"
+                                , "Zm9vZm9vZm9"
+                                , "Zm9vZ=" } )
+  {
+    char dst[16];
+    const base64::DecodeResult expected{ base64::decode( src.data(), src.size(), dst ) };
+    ASSERT_NE( expected.status, Status::eSuccess ) << src;
+
+    for ( size_t split = 0; split <= src.size(); ++split )
+    {
+      base64::Decoder decoder;
+      base64::DecodeResult result{ decoder.update( src.data(), split, dst ) };
+      size_t numDstBytes{ result.numDstBytes };
+      if ( result.status == Status::eSuccess )
+      {
+        result = decoder.update( src.data() + split, src.size() - split, dst + numDstBytes );
+        numDstBytes += result.numDstBytes;
+      }
+
+      // An error from update() sticks until finish().
+      if ( result.status != Status::eSuccess )
+      {
+        EXPECT_EQ( decoder.update( "Zm9v" ), std::nullopt );
+      }
+      const base64::DecodeResult finished{ decoder.finish() };
+      EXPECT_EQ( finished.status, expected.status );
+      EXPECT_EQ( finished.errorPosition, expected.errorPosition );
+      if ( result.status == Status::eSuccess )
+      {
+        result = finished;
+      }
+
+      EXPECT_EQ( base64::DecodeResult::toString( result.status )
+               , base64::DecodeResult::toString( expected.status ) ) << src << " " << split;
+      EXPECT_EQ( result.errorPosition, expected.errorPosition ) << src << " " << split;
+      // Except that a padded quartet is decoded before whatever follows shows
+      // it was not the last.
+      if ( expected.status != Status::eInvalidPadding )
+      {
+        EXPECT_EQ( numDstBytes, expected.numDstBytes ) << src << " " << split;
+      }
+
+      // Then the decoder is ready for a new stream.
+      EXPECT_EQ( decoder.update( "Zm9v" ), "foo" );
+    }
+  }
+}
+
+TEST(Base64Stream, Alphabets)
+{
+  const std::string bytes{ randomBytes( 1000 ) };
+
+  std::mt19937 random{ 3 };
+  for ( size_t size = 0; size <= bytes.size(); size += ( size < 100 ? 1 : 97 ) )
+  {
+    const std::string expected{ base64::encode<base64::UrlUnpadded>( bytes.substr( 0, size ) ) };
+
+    base64::Encoder<base64::UrlUnpadded> encoder;
+    std::string encoded;
+    size_t position{ 0 };
+    for ( size_t chunk : randomChunks( size, random ) )
+    {
+      encoded += encoder.update( bytes.substr( position, chunk ) );
+      position += chunk;
+    }
+    encoded += encoder.finish();
+    ASSERT_EQ( encoded, expected ) << size;
+
+    // The final partial quartet is decoded by finish().
+    base64::Decoder<base64::UrlUnpadded> decoder;
+    std::string decoded;
+    position = 0;
+    for ( size_t chunk : randomChunks( encoded.size(), random ) )
+    {
+      const auto chunkBytes{ decoder.update( encoded.substr( position, chunk ) ) };
+      ASSERT_TRUE( chunkBytes ) << size;
+      decoded += *chunkBytes;
+      position += chunk;
+    }
+    char dst[2];
+    const base64::DecodeResult result{ decoder.finish( dst ) };
+    ASSERT_EQ( result.status, Status::eSuccess ) << size;
+    decoded.append( dst, result.numDstBytes );
+    EXPECT_EQ( decoded, bytes.substr( 0, size ) );
+  }
+}
@@ -20,6 +20,7 @@
 #include <sstream>
 
 #include <lb/encoding/bits.h>
+#include <lb/encoding/bitsinline.h>
 
 
 TEST(Encoding, Bits)
@@ -58,3 +59,25 @@ TEST(Encoding, Bits)
   EXPECT_EQ( oss.str(), "11111111" ); // 255 in decimal
   oss.str( {} );
 }
+
+TEST(Encoding, BitsInline)
+{
+  // Same output as the library for every byte value.
+  std::string src;
+  std::string expected;
+  for ( int byte = 0; byte < 256; ++byte )
+  {
+    char library[8];
+    char actual[8];
+    lb::encoding::bits::encode( char( byte ), library );
+    lb::encoding::bits::inlined::encode( char( byte ), actual );
+    EXPECT_EQ( std::string( actual, 8 ), std::string( library, 8 ) ) << byte;
+    src.push_back( char( byte ) );
+    expected.append( library, 8 );
+  }
+  EXPECT_EQ( expected.substr( 8 * 0xA5, 8 ), "10100101" );
+
+  std::string dst( 8 * src.size(), '\0' );
+  lb::encoding::bits::inlined::encode( src.data(), src.size(), dst.data() );
+  EXPECT_EQ( dst, expected );
+}
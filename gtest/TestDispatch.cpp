@@ -0,0 +1,135 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include "TestHelpers.h"
+
+#include <lb/encoding/dispatch.h>
+#include <lb/encoding/sha1.h>
+#include <lb/encoding/websocket.h>
+
+#include <vector>
+
+
+namespace dispatch = lb::encoding::dispatch;
+namespace sha1 = lb::encoding::sha1;
+namespace ws = lb::encoding::websocket;
+
+
+TEST(Dispatch, Tiers)
+{
+  for ( dispatch::Tier tier : allTiers )
+  {
+    EXPECT_EQ( dispatch::toTier( dispatch::toString( tier ) ), tier );
+  }
+  EXPECT_FALSE( dispatch::toTier( "mmx" ) );
+
+  const dispatch::Tier initialTier{ dispatch::activeTier() };
+  EXPECT_LE( initialTier, dispatch::detectedTier() );
+
+  // Never above what the CPU supports.
+  dispatch::forceTier( dispatch::Tier::eAvx512Vbmi );
+  EXPECT_EQ( dispatch::activeTier(), dispatch::detectedTier() );
+
+  dispatch::forceTier( dispatch::Tier::eBaseline );
+  EXPECT_EQ( dispatch::activeTier(), dispatch::Tier::eBaseline );
+  for ( const dispatch::Kernel& kernel : dispatch::selectedKernels() )
+  {
+    EXPECT_EQ( kernel.tier, dispatch::Tier::eBaseline ) << kernel.function;
+    EXPECT_EQ( kernel.name, "baseline" ) << kernel.function;
+  }
+  EXPECT_NE( dispatch::describe().find( "tier baseline" ), std::string::npos );
+
+  dispatch::forceTier( initialTier );
+  EXPECT_EQ( dispatch::activeTier(), initialTier );
+}
+
+TEST(Dispatch, SelectedKernels)
+{
+  // Every dispatched function is listed from the start, not just once used.
+  const auto kernels{ dispatch::selectedKernels() };
+  std::vector<std::string> functions;
+  for ( const dispatch::Kernel& kernel : kernels )
+  {
+    functions.push_back( kernel.function );
+    EXPECT_LE( kernel.tier, dispatch::activeTier() ) << kernel.function;
+  }
+  EXPECT_EQ( functions, ( std::vector<std::string>{ "base64::decode"
+                                                  , "base64::encode"
+                                                  , "base64url::decode"
+                                                  , "base64url::encode"
+                                                  , "sha1::encodeBatch"
+                                                  , "websocket::encodeMaskedPayload" } ) );
+
+  const std::string description{ dispatch::describe() };
+  EXPECT_NE( description.find( "sha1::encodeBatch=" + kernels[4].name ), std::string::npos );
+}
+
+// Every tier the CPU supports gives the same results, whichever kernel that
+// means.
+TEST(Dispatch, KernelsAgree)
+{
+  std::vector<std::string> messages;
+  for ( size_t size = 0; size < 300; ++size )
+  {
+    std::string message;
+    for ( size_t i = 0; i < size; ++i )
+    {
+      message.push_back( char( i * 7 + size ) );
+    }
+    messages.push_back( message );
+  }
+
+  std::vector<const char*> srcs;
+  std::vector<size_t> sizes;
+  std::string expectedDigests;
+  for ( const std::string& message : messages )
+  {
+    srcs.push_back( message.data() );
+    sizes.push_back( message.size() );
+    expectedDigests += sha1::encode( message );
+  }
+
+  const uint8_t mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+
+  forEachSupportedTier( [&]()
+  {
+    std::string digests( 20 * messages.size(), '\0' );
+    sha1::encodeBatch( srcs.data(), sizes.data(), messages.size(), digests.data() );
+    EXPECT_EQ( digests, expectedDigests );
+
+    for ( const std::string& message : messages )
+    {
+      std::string expected{ message };
+      for ( size_t i = 0; i < expected.size(); ++i )
+      {
+        expected[i] ^= mask[ i % 4 ];
+      }
+
+      // Offset by one so the kernels see unaligned input.
+      std::string src{ "." + message };
+      std::string dst( src.size(), '\0' );
+      ws::encodeMaskedPayload( src.data() + 1, message.size(), mask, dst.data() + 1 );
+      EXPECT_EQ( dst.substr( 1 ), expected ) << message.size() << " bytes";
+
+      std::string inPlace{ message };
+      ws::encodeMaskedPayload( inPlace, mask );
+      EXPECT_EQ( inPlace, expected ) << message.size() << " bytes";
+    }
+  } );
+}
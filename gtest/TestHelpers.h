@@ -0,0 +1,84 @@
+#ifndef LB_ENCODING_GTEST_TESTHELPERS_H
+#define LB_ENCODING_GTEST_TESTHELPERS_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Helpers shared by the tests. Everything lives in an anonymous namespace so
+// each test file gets its own copy.
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/dispatch.h>
+
+#include <cstdint>
+#include <string>
+
+
+namespace
+{
+
+
+const lb::encoding::dispatch::Tier allTiers[] = { lb::encoding::dispatch::Tier::eBaseline
+                                                , lb::encoding::dispatch::Tier::eSse41
+                                                , lb::encoding::dispatch::Tier::eAvx2
+                                                , lb::encoding::dispatch::Tier::eAvx512
+                                                , lb::encoding::dispatch::Tier::eAvx512Vbmi };
+
+// The same bytes every time, from a xorshift generator.
+inline std::string randomBytes( size_t size )
+{
+  std::string bytes;
+  uint32_t x{ 2463534242U };
+  for ( size_t i = 0; i < size; ++i )
+  {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bytes.push_back( char( x ) );
+  }
+  return bytes;
+}
+
+// Calls \a fn with each tier the CPU supports forced in turn, lowest first,
+// then restores the tier active beforehand, which LB_ENCODING_FORCE_TIER may
+// have lowered. Failures are traced with the kernels used.
+template< class Function >
+void forEachSupportedTier( Function fn )
+{
+  namespace dispatch = lb::encoding::dispatch;
+
+  const dispatch::Tier initialTier{ dispatch::activeTier() };
+  for ( dispatch::Tier tier : allTiers )
+  {
+    if ( tier > dispatch::detectedTier() )
+    {
+      break;
+    }
+    dispatch::forceTier( tier );
+    SCOPED_TRACE( dispatch::describe() );
+    fn();
+  }
+
+  dispatch::forceTier( initialTier );
+}
+
+
+} // End of anonymous namespace
+
+
+#endif // LB_ENCODING_GTEST_TESTHELPERS_H
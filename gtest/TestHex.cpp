@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <lb/encoding/hex.h>
+#include <lb/encoding/hexinline.h>
 
 
 TEST(Encoding, Hex)
@@ -43,3 +44,22 @@ TEST(Encoding, Hex)
   EXPECT_EQ( dst, "54686520717569636B2062726F776E20666F78206A756D7073206F76657220746865206C617A7920646F672E" );
 
 }
+
+TEST(Encoding, HexInline)
+{
+  // Same output as the library for every byte value.
+  std::string src;
+  for ( int byte = 0; byte < 256; ++byte )
+  {
+    char expected[2];
+    char actual[2];
+    lb::encoding::hex::encode( char( byte ), expected );
+    lb::encoding::hex::inlined::encode( char( byte ), actual );
+    EXPECT_EQ( std::string( actual, 2 ), std::string( expected, 2 ) ) << byte;
+    src.push_back( char( byte ) );
+  }
+
+  std::string dst( 2 * src.size(), '\0' );
+  lb::encoding::hex::inlined::encode( src.data(), src.size(), dst.data() );
+  EXPECT_EQ( dst, lb::encoding::hex::encode( src ) );
+}
@@ -20,6 +20,10 @@
 #include <lb/encoding/hex.h>
 #include <lb/encoding/sha1.h>
 
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
 
 TEST(Encoding, Sha1)
 {
@@ -53,3 +57,57 @@ TEST(Encoding, Sha1)
   EXPECT_EQ( lb::encoding::hex::encode( lb::encoding::sha1::encode( "The quick brown fox jumps over the lazy cog" ) )
            , "DE9F2C7FD25E1B3AFAD3E85A0BD17D9B100DB4B3" );
 }
+
+TEST(Encoding, Sha1Batch)
+{
+  // Messages of all sorts of lengths, in particular either side of the 56 byte
+  // point where the padding spills into a second chunk.
+  std::vector<std::string> messages;
+  for ( size_t size = 0; size < 200; ++size )
+  {
+    std::string message;
+    for ( size_t i = 0; i < size; ++i )
+    {
+      message.push_back( char( i * 31 + size ) );
+    }
+    messages.push_back( message );
+  }
+  messages.push_back( std::string( 1024, 'x' ) );
+  messages.push_back( "The quick brown fox jumps over the lazy dog" );
+
+  // Batch sizes that leave lanes unused as well as those that fill them.
+  for ( size_t numMessages : { size_t( 1 ), size_t( 3 ), size_t( 16 ), size_t( 37 ), messages.size() } )
+  {
+    std::vector<const char*> srcs;
+    std::vector<size_t> sizes;
+    for ( size_t i = 0; i < numMessages; ++i )
+    {
+      srcs.push_back( messages[i].data() );
+      sizes.push_back( messages[i].size() );
+    }
+
+    std::vector<char> digests( 20 * numMessages );
+    lb::encoding::sha1::encodeBatch( srcs.data(), sizes.data(), numMessages, digests.data() );
+
+    for ( size_t i = 0; i < numMessages; ++i )
+    {
+      EXPECT_EQ( std::string( &digests[ 20 * i ], 20 ), lb::encoding::sha1::encode( messages[i] ) )
+        << "message " << i << " of " << numMessages;
+    }
+  }
+
+  // Nothing to do is fine too.
+  lb::encoding::sha1::encodeBatch( nullptr, nullptr, 0, nullptr );
+
+  // The span version, over more than one of its groups.
+  std::vector<std::string_view> views( messages.begin(), messages.end() );
+  std::vector<char> digests( 20 * views.size() );
+  lb::encoding::sha1::encodeBatch( views, digests );
+  for ( size_t i = 0; i < views.size(); ++i )
+  {
+    EXPECT_EQ( std::string( &digests[ 20 * i ], 20 ), lb::encoding::sha1::encode( messages[i] ) ) << i;
+  }
+  EXPECT_THROW( lb::encoding::sha1::encodeBatch( views, std::span<char>( digests ).first( 20 * views.size() - 1 ) )
+              , std::length_error );
+  lb::encoding::sha1::encodeBatch( {}, {} );
+}
@@ -722,6 +722,55 @@ TEST(Decoding, WebSocketFrame)
   }
 }
 
+TEST(Decoding, WebSocketStats)
+{
+  if ( !ws::Decoder::statsEnabled() )
+  {
+    ws::Decoder decoder;
+    decoder.decode( "\x81\x01X", 3 );
+    EXPECT_EQ( decoder.stats().numBytesIn, 0U );
+    return;
+  }
+
+  ws::Decoder decoder;
+
+  // - a complete text frame and the first header byte of a binary frame
+  decoder.decode( "\x81\x01X\x82", 4 );
+  // - the remaining header byte and one of three payload bytes
+  decoder.decode( "\x03" "a", 2 );
+  // - the remaining payload bytes and a complete ping
+  decoder.decode( "bc\x89\x00", 4 );
+
+  const auto& stats{ decoder.stats() };
+  EXPECT_EQ( stats.numBytesIn, 10U );
+  EXPECT_EQ( stats.numFramesWith( ws::Header::OpCode::eText ), 1U );
+  EXPECT_EQ( stats.numFramesWith( ws::Header::OpCode::eBinary ), 1U );
+  EXPECT_EQ( stats.numFramesWith( ws::Header::OpCode::ePing ), 1U );
+  EXPECT_EQ( stats.numFramesWith( ws::Header::OpCode::ePong ), 0U );
+  EXPECT_EQ( stats.numPartialHeaders, 1U );
+  EXPECT_EQ( stats.numPartialPayloads, 1U );
+  // The first header byte, the second header byte and first payload byte in
+  // case they are header, that payload byte again once the header is decoded,
+  // then the remaining two payload bytes. The ping is decoded in place.
+  EXPECT_EQ( stats.numBytesCopied, 1U + 2U + 1U + 2U );
+  EXPECT_EQ( stats.peakBufferedBytes, 3U );
+
+  // - an invalid op code
+  ws::Decoder badDecoder;
+  EXPECT_TRUE( badDecoder.decode( "\x83\x00", 2 ).parseError );
+  EXPECT_EQ( badDecoder.stats().numParseErrorsWith( ws::Header::DecodeResult::eInvalidOpCode ), 1U );
+  EXPECT_EQ( badDecoder.stats().numPartialHeaders, 0U );
+
+  // Aggregation
+  ws::Decoder::Stats total;
+  total += stats;
+  total += badDecoder.stats();
+  EXPECT_EQ( total.numBytesIn, 12U );
+  EXPECT_EQ( total.numFramesWith( ws::Header::OpCode::eText ), 1U );
+  EXPECT_EQ( total.numParseErrorsWith( ws::Header::DecodeResult::eInvalidOpCode ), 1U );
+  EXPECT_EQ( total.peakBufferedBytes, 3U );
+}
+
 template <class T>
 void decodingWebSocketPayloadT( T& payload )
 {
@@ -0,0 +1,161 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketbatch.h>
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+ws::Header batchHeader( uint64_t payloadSize, bool isMasked )
+{
+  ws::Header header;
+  header.opCode = ws::Header::OpCode::eText;
+  header.isMasked = isMasked;
+  header.payloadSize = payloadSize;
+  if ( isMasked )
+  {
+    header.mask[0] = 0x12;
+    header.mask[1] = 0x34;
+    header.mask[2] = 0x56;
+    header.mask[3] = 0x78;
+  }
+  return header;
+}
+
+TEST(Encoding, WebSocketBatch)
+{
+  const std::string payloads[] = { "Hello", "", std::string( 300, 'x' ), "World" };
+
+  // The batch holds exactly the frames encoded one by one, back to back.
+  ws::FrameBatcher batcher( 1000 );
+  std::string expected;
+  for ( size_t i = 0; i < 4; ++i )
+  {
+    const ws::Header header{ batchHeader( payloads[i].size(), i % 2 == 1 ) };
+    EXPECT_FALSE( batcher.append( header, payloads[i] ) );
+
+    std::string encodedHeader( header.encodedSizeInBytes(), '\0' );
+    header.encode( encodedHeader.data() );
+    expected += encodedHeader;
+    expected += header.isMasked ? ws::encodeMaskedPayload( payloads[i], header.mask )
+                                : payloads[i];
+  }
+  EXPECT_EQ( batcher.numFrames(), 4U );
+  ASSERT_EQ( batcher.size(), expected.size() );
+  EXPECT_EQ( std::string( batcher.data(), batcher.size() ), expected );
+
+  // Partial writes report the frames they completed.
+  const size_t frame0{ 2 + 5 };
+  const size_t frame1{ 6 };
+  const size_t frame2{ 4 + 300 };
+  EXPECT_EQ( batcher.consume( frame0 - 1 ), 0U );
+  EXPECT_EQ( batcher.consume( 1 ), 1U );
+  EXPECT_EQ( batcher.consume( frame1 + frame2 ), 2U );
+  EXPECT_EQ( batcher.numFrames(), 1U );
+  EXPECT_EQ( std::string( batcher.data(), batcher.size() ), expected.substr( frame0 + frame1 + frame2 ) );
+  EXPECT_EQ( batcher.consume( batcher.size() ), 1U );
+  EXPECT_TRUE( batcher.empty() );
+  EXPECT_EQ( batcher.numFrames(), 0U );
+
+  // The threshold is reported by append.
+  EXPECT_FALSE( batcher.append( batchHeader( 500, false ), std::string( 500, 'a' ) ) );
+  EXPECT_TRUE( batcher.append( batchHeader( 500, false ), std::string( 500, 'b' ) ) );
+  EXPECT_TRUE( batcher.isFlushDue() );
+  batcher.clear();
+  EXPECT_TRUE( batcher.empty() );
+
+  // A std::string payload must be the size its header says, in either
+  // direction, so nothing is read past its end.
+  EXPECT_THROW( batcher.append( batchHeader( 10, false ), std::string( 5, 'c' ) ), std::invalid_argument );
+  EXPECT_THROW( batcher.append( batchHeader( 3, true ), std::string( 5, 'c' ) ), std::invalid_argument );
+  EXPECT_TRUE( batcher.empty() );
+  EXPECT_EQ( batcher.numFrames(), 0U );
+}
+
+TEST(Encoding, WebSocketBatchFlush)
+{
+  int sockets[2];
+  ASSERT_EQ( socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ), 0 );
+  const int sendBufferSize{ 4096 };
+  setsockopt( sockets[0], SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize) );
+  fcntl( sockets[0], F_SETFL, fcntl( sockets[0], F_GETFL ) | O_NONBLOCK );
+
+  // Far more than the socket can take in one go.
+  const size_t numFrames{ 2000 };
+  ws::FrameBatcher batcher;
+  for ( size_t i = 0; i < numFrames; ++i )
+  {
+    batcher.append( batchHeader( 100, i % 3 == 0 ), std::string( 100, char( 'a' + i % 26 ) ) );
+  }
+
+  ws::Decoder decoder;
+  std::vector<ws::Frame> frames;
+  size_t numFramesWritten{ 0 };
+  char buffer[8192];
+  while ( true )
+  {
+    size_t n{ 0 };
+    const auto status{ batcher.flush( sockets[0], &n ) };
+    numFramesWritten += n;
+    EXPECT_EQ( batcher.numFrames(), numFrames - numFramesWritten );
+    if ( status == ws::FrameBatcher::Status::eComplete )
+    {
+      break;
+    }
+    ASSERT_EQ( status, ws::FrameBatcher::Status::eWouldBlock );
+
+    const ssize_t numRead{ read( sockets[1], buffer, sizeof(buffer) ) };
+    ASSERT_GT( numRead, 0 );
+    auto result{ decoder.decode( buffer, numRead ) };
+    ASSERT_FALSE( result.parseError );
+    for ( auto& frame : result.frames )
+    {
+      frames.push_back( std::move( frame ) );
+    }
+  }
+  EXPECT_EQ( numFramesWritten, numFrames );
+  EXPECT_TRUE( batcher.empty() );
+  close( sockets[0] );
+
+  ssize_t numRead;
+  while ( ( numRead = read( sockets[1], buffer, sizeof(buffer) ) ) > 0 )
+  {
+    auto result{ decoder.decode( buffer, numRead ) };
+    ASSERT_FALSE( result.parseError );
+    for ( auto& frame : result.frames )
+    {
+      frames.push_back( std::move( frame ) );
+    }
+  }
+  close( sockets[1] );
+
+  ASSERT_EQ( frames.size(), numFrames );
+  for ( size_t i = 0; i < numFrames; ++i )
+  {
+    EXPECT_EQ( frames[i].header.isMasked, i % 3 == 0 );
+    EXPECT_EQ( frames[i].payload, std::string( 100, char( 'a' + i % 26 ) ) );
+  }
+}
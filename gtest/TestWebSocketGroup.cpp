@@ -0,0 +1,114 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketgroup.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+std::string encodeFrame( const std::string& payload )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eText;
+  header.payloadSize = payload.size();
+  std::string bytes( header.encodedSizeInBytes(), '\0' );
+  header.encode( bytes.data() );
+  return bytes + payload;
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Decoding, WebSocketDecoderGroup)
+{
+  EXPECT_GE( ws::DecoderGroup().numThreads(), 1U );
+
+  // Connection i sends i frames, the last of them split across two batches.
+  const size_t numConnections{ 100 };
+  std::vector<std::string> streams( numConnections );
+  for ( size_t i = 0; i < numConnections; ++i )
+  {
+    for ( size_t j = 0; j < i; ++j )
+    {
+      streams[i] += encodeFrame( std::to_string( i ) + ":" + std::to_string( j ) );
+    }
+  }
+
+  for ( size_t numThreads : { 1, 2, 3, 8 } )
+  {
+    ws::DecoderGroup group( numThreads );
+    EXPECT_EQ( group.numThreads(), numThreads );
+
+    std::vector<ws::Decoder> decoders( numConnections );
+    std::vector<std::vector<std::string>> payloads( numConnections );
+    std::vector<ws::DecoderGroup::Job> jobs;
+    std::vector<ws::Decoder::Result> results;
+
+    EXPECT_TRUE( group.decode( jobs ).empty() );
+
+    for ( size_t batch = 0; batch < 2; ++batch )
+    {
+      jobs.clear();
+      for ( size_t i = 0; i < numConnections; ++i )
+      {
+        const size_t split{ streams[i].size() - std::min<size_t>( streams[i].size(), 2 ) };
+        jobs.push_back( batch == 0 ? ws::DecoderGroup::Job{ &decoders[i], streams[i].data(), split }
+                                   : ws::DecoderGroup::Job{ &decoders[i], streams[i].data() + split, streams[i].size() - split } );
+      }
+      group.decode( jobs, results );
+      ASSERT_EQ( results.size(), numConnections );
+      for ( size_t i = 0; i < numConnections; ++i )
+      {
+        EXPECT_FALSE( results[i].parseError );
+        for ( const auto& frame : results[i].frames )
+        {
+          payloads[i].push_back( frame.payload );
+        }
+      }
+    }
+
+    for ( size_t i = 0; i < numConnections; ++i )
+    {
+      ASSERT_EQ( payloads[i].size(), i ) << numThreads << " threads, connection " << i;
+      for ( size_t j = 0; j < i; ++j )
+      {
+        EXPECT_EQ( payloads[i][j], std::to_string( i ) + ":" + std::to_string( j ) );
+      }
+    }
+  }
+
+  // A parse error stays with its connection.
+  ws::DecoderGroup group( 2 );
+  ws::Decoder good;
+  ws::Decoder bad;
+  const std::string frame{ encodeFrame( "ok" ) };
+  const auto results{ group.decode( { { &good, frame.data(), frame.size() }
+                                    , { &bad, "\x83\x00", 2 } } ) };
+  ASSERT_EQ( results.size(), 2U );
+  EXPECT_FALSE( results[0].parseError );
+  EXPECT_EQ( results[0].frames.size(), 1U );
+  EXPECT_TRUE( results[1].parseError );
+}
@@ -0,0 +1,167 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websockethandshake.h>
+#include <lb/encoding/base64.h>
+#include <lb/encoding/sha1.h>
+
+
+namespace hs = lb::encoding::websocket::handshake;
+
+
+// Printers for correct gtest output.
+namespace lb { namespace encoding { namespace websocket { namespace handshake {
+  void PrintTo( const ParseResult& pr, std::ostream* os )
+  {
+    *os << "ParseResult " << toString( pr );
+  }
+} } } }
+
+
+// The example from RFC 6455 Section 1.3 plus some optional headers.
+const std::string rfcRequest{ "GET /chat HTTP/1.1\r\n"
+                              "Host: server.example.com\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Origin: http://example.com\r\n"
+                              "Sec-WebSocket-Protocol: chat, superchat\r\n"
+                              "Sec-WebSocket-Version: 13\r\n"
+                              "\r\n" };
+
+hs::ParseResult parseString( const std::string& s )
+{
+  hs::Request request;
+  return hs::parse( s.data(), s.size(), request );
+}
+
+// Replaces the first occurrence of from in rfcRequest
+std::string modifiedRequest( const std::string& from, const std::string& to )
+{
+  std::string modified{ rfcRequest };
+  modified.replace( modified.find( from ), from.size(), to );
+  return modified;
+}
+
+TEST(Encoding, WebSocketAcceptKey)
+{
+  char accept[ hs::acceptKeySize ];
+  hs::computeAcceptKey( "dGhlIHNhbXBsZSBub25jZQ==", accept );
+  EXPECT_EQ( std::string( accept, hs::acceptKeySize ), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=" );
+
+  hs::computeAcceptKey( "x3JJHMbDL1EzLkh9GBhXDw==", accept );
+  EXPECT_EQ( std::string( accept, hs::acceptKeySize ), "HSmrc0sMlYUkAGmm5OPpG2HaGWk=" );
+
+  // The specialised two chunk hash must agree with the general purpose one.
+  std::string key( "AAAAAAAAAAAAAAAAAAAAAA==" );
+  for ( int i = 0; i < 64; ++i )
+  {
+    key[ i % 22 ] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[ ( i * 37 ) % 64 ];
+    hs::computeAcceptKey( key.data(), accept );
+    const std::string expected{ lb::encoding::base64::encode(
+      lb::encoding::sha1::encode( key + std::string( hs::guid, sizeof(hs::guid) ) ) ) };
+    EXPECT_EQ( std::string( accept, hs::acceptKeySize ), expected ) << key;
+  }
+}
+
+TEST(Decoding, WebSocketHandshake)
+{
+  // A complete request with a frame byte tacked on the end.
+  {
+    const std::string bytes{ rfcRequest + "\x81" };
+    hs::Request request;
+    ASSERT_EQ( hs::parse( bytes.data(), bytes.size(), request ), hs::ParseResult::eSuccess );
+    EXPECT_EQ( request.method, "GET" );
+    EXPECT_EQ( request.target, "/chat" );
+    EXPECT_EQ( request.host, "server.example.com" );
+    EXPECT_EQ( request.upgrade, "websocket" );
+    EXPECT_EQ( request.connection, "Upgrade" );
+    EXPECT_EQ( request.key, "dGhlIHNhbXBsZSBub25jZQ==" );
+    EXPECT_EQ( request.version, "13" );
+    EXPECT_EQ( request.origin, "http://example.com" );
+    EXPECT_EQ( request.protocols, "chat, superchat" );
+    EXPECT_TRUE( request.extensions.empty() );
+    EXPECT_EQ( request.numBytes, rfcRequest.size() );
+  }
+
+  // Every prefix of the request is incomplete.
+  for ( size_t i = 0; i < rfcRequest.size(); ++i )
+  {
+    hs::Request request;
+    EXPECT_EQ( hs::parse( rfcRequest.data(), i, request ), hs::ParseResult::eIncomplete ) << i;
+  }
+
+  // Header names are case insensitive, as are the Upgrade and Connection
+  // tokens, and Connection may be a list.
+  EXPECT_EQ( parseString( modifiedRequest( "Connection: Upgrade", "cOnNeCtIoN:keep-alive,  upgrade " ) )
+           , hs::ParseResult::eSuccess );
+  EXPECT_EQ( parseString( modifiedRequest( "Upgrade: websocket", "UPGRADE: WebSocket" ) )
+           , hs::ParseResult::eSuccess );
+
+  EXPECT_EQ( parseString( modifiedRequest( "GET", "POST" ) ), hs::ParseResult::eNotGet );
+  EXPECT_EQ( parseString( modifiedRequest( "HTTP/1.1", "HTTP/1.0" ) ), hs::ParseResult::eMalformed );
+  EXPECT_EQ( parseString( modifiedRequest( "GET /chat", "GET" ) ), hs::ParseResult::eMalformed );
+  EXPECT_EQ( parseString( modifiedRequest( "Host: server.example.com\r\n", "" ) )
+           , hs::ParseResult::eMissingHost );
+  EXPECT_EQ( parseString( modifiedRequest( "Upgrade: websocket", "Upgrade: h2c" ) )
+           , hs::ParseResult::eNotUpgrade );
+  EXPECT_EQ( parseString( modifiedRequest( "Connection: Upgrade", "Connection: keep-alive" ) )
+           , hs::ParseResult::eNotConnectionUpgrade );
+  EXPECT_EQ( parseString( modifiedRequest( "dGhlIHNhbXBsZSBub25jZQ==", "dGhlIHNhbXBsZSBub25jZQ" ) )
+           , hs::ParseResult::eInvalidKey );
+  EXPECT_EQ( parseString( modifiedRequest( "dGhlIHNhbXBsZSBub25jZQ==", "dGhlIHNhbXBsZSBub25j*Q==" ) )
+           , hs::ParseResult::eInvalidKey );
+  EXPECT_EQ( parseString( modifiedRequest( "Version: 13", "Version: 8" ) )
+           , hs::ParseResult::eUnsupportedVersion );
+  EXPECT_EQ( parseString( modifiedRequest( "Host:", "Host :" ) ), hs::ParseResult::eMalformed );
+  EXPECT_EQ( parseString( modifiedRequest( "\r\nOrigin", "\r\n Origin" ) ), hs::ParseResult::eMalformed );
+  EXPECT_EQ( parseString( modifiedRequest( "\r\nOrigin", "\rOrigin" ) ), hs::ParseResult::eMalformed );
+}
+
+TEST(Encoding, WebSocketHandshake)
+{
+  hs::Request request;
+  ASSERT_EQ( hs::parse( rfcRequest.data(), rfcRequest.size(), request ), hs::ParseResult::eSuccess );
+
+  char response[256];
+  size_t size{ hs::encodeResponse( request, response ) };
+  EXPECT_EQ( size, hs::encodedResponseSize() );
+  EXPECT_EQ( std::string( response, size )
+           , "HTTP/1.1 101 Switching Protocols\r\n"
+             "Upgrade: websocket\r\n"
+             "Connection: Upgrade\r\n"
+             "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+             "\r\n" );
+
+  size = hs::encodeResponse( request, response, "chat" );
+  EXPECT_EQ( size, hs::encodedResponseSize( "chat" ) );
+  EXPECT_EQ( std::string( response, size )
+           , "HTTP/1.1 101 Switching Protocols\r\n"
+             "Upgrade: websocket\r\n"
+             "Connection: Upgrade\r\n"
+             "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+             "Sec-WebSocket-Protocol: chat\r\n"
+             "\r\n" );
+
+  EXPECT_TRUE( hs::errorResponse( hs::ParseResult::eSuccess ).empty() );
+  EXPECT_TRUE( hs::errorResponse( hs::ParseResult::eIncomplete ).empty() );
+  EXPECT_EQ( hs::errorResponse( hs::ParseResult::eInvalidKey ).substr( 0, 24 ), "HTTP/1.1 400 Bad Request" );
+  EXPECT_NE( hs::errorResponse( hs::ParseResult::eUnsupportedVersion ).find( "Sec-WebSocket-Version: 13\r\n" )
+           , std::string_view::npos );
+}
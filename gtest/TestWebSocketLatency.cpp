@@ -0,0 +1,111 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketlatency.h>
+
+#include <thread>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+TEST(Encoding, WebSocketLatencyHistogram)
+{
+  using Histogram = ws::LatencyHistogram;
+
+  // Every value lies in its bucket, within 1/16 of the bucket's top.
+  const uint64_t values[] = { 0, 1, 31, 32, 33, 1000, 123456789
+                            , 1ULL << 40, ( 1ULL << 40 ) + 12345, UINT64_MAX };
+  for ( uint64_t value : values )
+  {
+    const size_t index{ Histogram::bucketIndex( value ) };
+    ASSERT_LT( index, Histogram::numBuckets );
+    EXPECT_GE( Histogram::highestValueIn( index ), value );
+    if ( index > 0 )
+    {
+      EXPECT_LT( Histogram::highestValueIn( index - 1 ), value );
+    }
+    EXPECT_LE( Histogram::highestValueIn( index ) - value, value / 16 );
+  }
+  // Buckets are contiguous.
+  for ( size_t index = 1; index < Histogram::numBuckets; ++index )
+  {
+    EXPECT_EQ( Histogram::bucketIndex( Histogram::highestValueIn( index - 1 ) + 1 ), index );
+  }
+
+  Histogram histogram;
+  EXPECT_EQ( histogram.valueAtPercentile( 99 ), 0U );
+  for ( uint64_t value = 1; value <= 1000; ++value )
+  {
+    histogram.record( value * 1000 );
+  }
+  EXPECT_EQ( histogram.count(), 1000U );
+  EXPECT_EQ( histogram.minValue(), 1000U );
+  EXPECT_EQ( histogram.maxValue(), 1000000U );
+  EXPECT_DOUBLE_EQ( histogram.mean(), 500500.0 );
+  EXPECT_NEAR( double( histogram.valueAtPercentile( 50 ) ), 500000.0, 500000.0 / 16 );
+  EXPECT_NEAR( double( histogram.valueAtPercentile( 99 ) ), 990000.0, 990000.0 / 16 );
+  EXPECT_EQ( histogram.valueAtPercentile( 100 ), 1000000U );
+
+  Histogram other;
+  other.record( 5 );
+  other.record( 2000000 );
+  other += histogram;
+  EXPECT_EQ( other.count(), 1002U );
+  EXPECT_EQ( other.minValue(), 5U );
+  EXPECT_EQ( other.maxValue(), 2000000U );
+  EXPECT_EQ( other.valueAtPercentile( 0 ), 5U );
+
+  other.reset();
+  EXPECT_EQ( other.count(), 0U );
+  EXPECT_EQ( other.minValue(), 0U );
+}
+
+TEST(Decoding, WebSocketFirstByteTime)
+{
+  // Off by default.
+  {
+    ws::Decoder decoder;
+    const auto result{ decoder.decode( "\x81\x01X", 3 ) };
+    ASSERT_EQ( result.frames.size(), 1U );
+    EXPECT_EQ( result.frames[0].firstByteTime, std::chrono::steady_clock::time_point{} );
+  }
+
+  // A frame spread over two calls keeps the time of the first.
+  ws::Decoder decoder;
+  decoder.setRecordFirstByteTimes( true );
+
+  const auto before{ std::chrono::steady_clock::now() };
+  EXPECT_TRUE( decoder.decode( "\x81\x03" "a", 3 ).frames.empty() );
+  std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+  const auto middle{ std::chrono::steady_clock::now() };
+  const auto result{ decoder.decode( "bc\x81\x01X", 5 ) };
+  const auto after{ std::chrono::steady_clock::now() };
+
+  ASSERT_EQ( result.frames.size(), 2U );
+  EXPECT_GE( result.frames[0].firstByteTime, before );
+  EXPECT_LT( result.frames[0].firstByteTime, middle );
+  EXPECT_GE( result.frames[1].firstByteTime, middle );
+
+  ws::LatencyHistogram histogram;
+  histogram.record( result.frames[0], after );
+  histogram.record( result.frames[1], after );
+  EXPECT_GE( histogram.maxValue(), 2000000U );
+  EXPECT_LT( histogram.minValue(), 2000000U );
+}
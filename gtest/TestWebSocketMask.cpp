@@ -0,0 +1,95 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketmask.h>
+
+#include <set>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+uint32_t maskValue( const uint8_t mask[4] )
+{
+  return ( uint32_t( mask[0] ) << 24 ) | ( uint32_t( mask[1] ) << 16 )
+       | ( uint32_t( mask[2] ) <<  8 ) |   uint32_t( mask[3] );
+}
+
+TEST(Encoding, WebSocketMask)
+{
+  // With an all zero key the masks are the ChaCha20 keystream of RFC 8439
+  // appendix A.1, less the first 32 bytes which become the next key.
+  {
+    const uint8_t zeroKey[ws::MaskGenerator::keySize] = {};
+    ws::MaskGenerator generator( zeroKey );
+    const uint32_t expected[] = { 0xda41597c, 0x5157488d, 0x7724e03f, 0xb8d84a37
+                                , 0x6a43b8f4, 0x1518a11c, 0xc387b669, 0xb2ee6586
+                                , 0x9f07e7be, 0x5551387a, 0x98ba977c, 0x732d080d };
+    for ( uint32_t value : expected )
+    {
+      uint8_t mask[4];
+      generator.next( mask );
+      EXPECT_EQ( maskValue( mask ), value );
+    }
+  }
+
+  // Masks keep coming, all different, across many refills.
+  {
+    std::set<uint32_t> masks;
+    ws::Header header;
+    for ( int i = 0; i < 10000; ++i )
+    {
+      ws::setRandomMask( header );
+      EXPECT_TRUE( header.isMasked );
+      masks.insert( maskValue( header.mask ) );
+    }
+    // Allow for the odd birthday collision.
+    EXPECT_GT( masks.size(), 9990U );
+  }
+
+  // Parent and child must not go on to produce the same masks after a fork.
+  {
+    uint8_t mask[4];
+    ws::generateMask( mask );
+
+    int fds[2];
+    ASSERT_EQ( pipe( fds ), 0 );
+    const pid_t pid{ fork() };
+    ASSERT_GE( pid, 0 );
+    if ( pid == 0 )
+    {
+      ws::generateMask( mask );
+      const bool ok{ write( fds[1], mask, 4 ) == 4 };
+      _exit( ok ? 0 : 1 );
+    }
+    close( fds[1] );
+
+    uint8_t childMask[4];
+    EXPECT_EQ( read( fds[0], childMask, 4 ), 4 );
+    close( fds[0] );
+    int status;
+    waitpid( pid, &status, 0 );
+
+    ws::generateMask( mask );
+    EXPECT_NE( maskValue( mask ), maskValue( childMask ) );
+  }
+}
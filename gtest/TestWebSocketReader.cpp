@@ -0,0 +1,243 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketreader.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+// Starts running straight away and cleans up after itself.
+struct Task
+{
+  struct promise_type
+  {
+    Task get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+// Hands out a fixed string a few bytes at a time without ever suspending.
+struct MemorySource
+{
+  struct Read
+  {
+    size_t numBytes;
+
+    bool await_ready() noexcept { return true; }
+    void await_suspend( std::coroutine_handle<> ) noexcept {}
+    size_t await_resume() noexcept { return numBytes; }
+  };
+
+  Read read( char* dst, size_t maxBytes )
+  {
+    const size_t numBytes{ std::min( { maxBytes, chunkSize, data.size() - offset } ) };
+    std::memcpy( dst, data.data() + offset, numBytes );
+    offset += numBytes;
+    return { numBytes };
+  }
+
+  std::string data;
+  size_t chunkSize;
+  size_t offset{ 0 };
+};
+
+// Suspends on every read until the test, playing the event loop, supplies
+// some bytes.
+struct AsyncSource
+{
+  struct Read
+  {
+    AsyncSource& source;
+
+    bool await_ready() noexcept { return false; }
+    void await_suspend( std::coroutine_handle<> reader ) noexcept { source.reader = reader; }
+    size_t await_resume() noexcept { return source.numPending; }
+  };
+
+  Read read( char* dst, size_t )
+  {
+    this->dst = dst;
+    return { *this };
+  }
+
+  void supply( const std::string& bytes )
+  {
+    std::memcpy( dst, bytes.data(), bytes.size() );
+    numPending = bytes.size();
+    std::exchange( reader, nullptr ).resume();
+  }
+
+  std::coroutine_handle<> reader;
+  char* dst{ nullptr };
+  size_t numPending{ 0 };
+};
+
+struct Collected
+{
+  std::vector<std::string> payloads;
+  std::vector<ws::Header::OpCode> opCodes;
+  bool finished{ false };
+  bool parseError{ false };
+};
+
+template< class Source >
+Task collect( Source& source, ws::Decoder& decoder, Collected& collected )
+{
+  auto reader{ ws::readFrames( source, decoder ) };
+  while ( const ws::Frame* frame = co_await reader.next() )
+  {
+    collected.payloads.push_back( frame->payload );
+    collected.opCodes.push_back( frame->header.opCode );
+  }
+  collected.parseError = reader.parseError();
+  collected.finished = true;
+}
+
+std::string encodeFrame( ws::Header::OpCode opCode, const std::string& payload, bool isMasked = false )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = opCode;
+  header.payloadSize = payload.size();
+  header.isMasked = isMasked;
+  header.mask[0] = 1;
+  header.mask[1] = 2;
+  header.mask[2] = 3;
+  header.mask[3] = 4;
+  std::string bytes( header.encodedSizeInBytes(), '\0' );
+  header.encode( bytes.data() );
+  return bytes + ( isMasked ? ws::encodeMaskedPayload( payload, header.mask ) : payload );
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Decoding, WebSocketDecodeNext)
+{
+  const std::string bytes{ encodeFrame( ws::Header::OpCode::eText, "Hello" )
+                         + encodeFrame( ws::Header::OpCode::eBinary, std::string( 300, 'x' ), true )
+                         + encodeFrame( ws::Header::OpCode::ePing, "" ) };
+
+  // Every split of the stream into two reads gives the same frames.
+  for ( size_t split = 0; split <= bytes.size(); ++split )
+  {
+    ws::Decoder decoder;
+    ws::Frame frame;
+    std::vector<std::string> payloads;
+
+    for ( auto [ start, end ] : { std::pair{ size_t( 0 ), split }, std::pair{ split, bytes.size() } } )
+    {
+      const char* p{ bytes.data() + start };
+      size_t numBytes{ end - start };
+      ws::Decoder::Step step;
+      while ( ( step = decoder.decodeNext( p, numBytes, frame ) ) == ws::Decoder::Step::eFrame )
+      {
+        payloads.push_back( frame.payload );
+      }
+      EXPECT_EQ( step, ws::Decoder::Step::eNeedMore );
+      EXPECT_EQ( numBytes, 0U );
+      EXPECT_EQ( p, bytes.data() + end );
+    }
+
+    ASSERT_EQ( payloads.size(), 3U ) << "split at " << split;
+    EXPECT_EQ( payloads[0], "Hello" );
+    EXPECT_EQ( payloads[1], std::string( 300, 'x' ) );
+    EXPECT_EQ( payloads[2], "" );
+  }
+
+  // Invalid op code.
+  ws::Decoder decoder;
+  ws::Frame frame;
+  const char* p{ "\x83\x00" };
+  size_t numBytes{ 2 };
+  EXPECT_EQ( decoder.decodeNext( p, numBytes, frame ), ws::Decoder::Step::eParseError );
+}
+
+TEST(Decoding, WebSocketFrameReader)
+{
+  const std::string bytes{ encodeFrame( ws::Header::OpCode::eText, "Hello" )
+                         + encodeFrame( ws::Header::OpCode::eBinary, std::string( 40000, 'x' ), true )
+                         + encodeFrame( ws::Header::OpCode::ePing, "" )
+                         + encodeFrame( ws::Header::OpCode::eText, "World" ) };
+
+  // Synchronous source, a variety of read sizes.
+  for ( size_t chunkSize : { 1, 7, 1000, 100000 } )
+  {
+    MemorySource source{ bytes, chunkSize };
+    ws::Decoder decoder;
+    Collected collected;
+    collect( source, decoder, collected );
+
+    EXPECT_TRUE( collected.finished );
+    EXPECT_FALSE( collected.parseError );
+    ASSERT_EQ( collected.payloads.size(), 4U );
+    EXPECT_EQ( collected.payloads[0], "Hello" );
+    EXPECT_EQ( collected.payloads[1], std::string( 40000, 'x' ) );
+    EXPECT_EQ( collected.payloads[2], "" );
+    EXPECT_EQ( collected.payloads[3], "World" );
+    EXPECT_EQ( collected.opCodes[2], ws::Header::OpCode::ePing );
+  }
+
+  // Asynchronous source.
+  {
+    AsyncSource source;
+    ws::Decoder decoder;
+    Collected collected;
+    collect( source, decoder, collected );
+    EXPECT_TRUE( collected.payloads.empty() );
+
+    const std::string first{ encodeFrame( ws::Header::OpCode::eText, "abc" ) };
+    const std::string second{ encodeFrame( ws::Header::OpCode::eText, "defg" ) };
+    source.supply( first + second.substr( 0, 3 ) );
+    ASSERT_EQ( collected.payloads.size(), 1U );
+    EXPECT_EQ( collected.payloads[0], "abc" );
+
+    source.supply( second.substr( 3 ) );
+    ASSERT_EQ( collected.payloads.size(), 2U );
+    EXPECT_EQ( collected.payloads[1], "defg" );
+    EXPECT_FALSE( collected.finished );
+
+    source.supply( "" );
+    EXPECT_TRUE( collected.finished );
+    EXPECT_FALSE( collected.parseError );
+  }
+
+  // Parse error.
+  {
+    MemorySource source{ encodeFrame( ws::Header::OpCode::eText, "ok" ) + std::string( "\x83\x00", 2 ), 100 };
+    ws::Decoder decoder;
+    Collected collected;
+    collect( source, decoder, collected );
+    EXPECT_TRUE( collected.finished );
+    EXPECT_TRUE( collected.parseError );
+    EXPECT_EQ( collected.payloads.size(), 1U );
+  }
+}
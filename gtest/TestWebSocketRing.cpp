@@ -0,0 +1,153 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketring.h>
+
+#include <stdexcept>
+#include <thread>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+std::string encodeFrame( const std::string& payload, bool isMasked )
+{
+  ws::Header header;
+  header.fin = true;
+  header.opCode = ws::Header::OpCode::eBinary;
+  header.payloadSize = payload.size();
+  header.isMasked = isMasked;
+  header.mask[0] = 0x12;
+  header.mask[1] = 0x34;
+  header.mask[2] = 0x56;
+  header.mask[3] = 0x78;
+  std::string bytes( header.encodedSizeInBytes(), '\0' );
+  header.encode( bytes.data() );
+  return bytes + ( isMasked ? ws::encodeMaskedPayload( payload, header.mask ) : payload );
+}
+
+// Frame i has a payload of a size and content that can be checked at the
+// other end.
+std::string payloadFor( size_t i )
+{
+  return std::string( ( i * 37 ) % 300, char( 'a' + i % 26 ) );
+}
+
+ws::FrameView viewOf( const std::string& payload )
+{
+  ws::FrameView view;
+  view.header.opCode = ws::Header::OpCode::eBinary;
+  view.header.payloadSize = payload.size();
+  view.payload = payload.data();
+  return view;
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Decoding, WebSocketFrameRing)
+{
+  EXPECT_THROW( ws::FrameRing( 3, 100 ), std::invalid_argument );
+  EXPECT_THROW( ws::FrameRing( 4, 0 ), std::invalid_argument );
+
+  // Full of slots.
+  {
+    ws::FrameRing ring( 2, 100 );
+    EXPECT_EQ( ring.front(), nullptr );
+    EXPECT_TRUE( ring.tryPush( viewOf( "a" ) ) );
+    EXPECT_TRUE( ring.tryPush( viewOf( "b" ) ) );
+    EXPECT_FALSE( ring.tryPush( viewOf( "c" ) ) );
+    ASSERT_NE( ring.front(), nullptr );
+    EXPECT_EQ( std::string( ring.front()->payload, 1 ), "a" );
+    ring.pop();
+    EXPECT_TRUE( ring.tryPush( viewOf( "c" ) ) );
+    EXPECT_EQ( std::string( ring.front()->payload, 1 ), "b" );
+    ring.pop();
+    EXPECT_EQ( std::string( ring.front()->payload, 1 ), "c" );
+    ring.pop();
+    EXPECT_EQ( ring.front(), nullptr );
+  }
+
+  // Full of payload, including one that has to skip the end of the arena.
+  {
+    ws::FrameRing ring( 8, 10 );
+    EXPECT_EQ( ring.maxPayloadSize(), 5U );
+    EXPECT_THROW( ring.push( viewOf( "123456" ) ), std::length_error );
+
+    EXPECT_TRUE( ring.tryPush( viewOf( "1234" ) ) );
+    EXPECT_TRUE( ring.tryPush( viewOf( "5678" ) ) );
+    EXPECT_FALSE( ring.tryPush( viewOf( "abcd" ) ) );
+    ring.pop();
+    EXPECT_TRUE( ring.tryPush( viewOf( "abcd" ) ) );
+    ring.pop();
+    const ws::FrameRing::Slot* slot{ ring.front() };
+    ASSERT_NE( slot, nullptr );
+    EXPECT_EQ( std::string( slot->payload, slot->header.payloadSize ), "abcd" );
+    ring.pop();
+    // Empty but the write position is mid arena, half of it still fits.
+    EXPECT_TRUE( ring.tryPush( viewOf( "vwxyz" ) ) );
+    EXPECT_EQ( std::string( ring.front()->payload, 5 ), "vwxyz" );
+  }
+
+  // Decoded straight into the ring on one thread, consumed on another.
+  const size_t numFrames{ 20000 };
+  std::string bytes;
+  for ( size_t i = 0; i < numFrames; ++i )
+  {
+    bytes += encodeFrame( payloadFor( i ), i % 2 == 1 );
+  }
+
+  ws::FrameRing ring( 16, 1024 );
+  std::thread consumer( [&ring]()
+  {
+    for ( size_t i = 0; i < numFrames; )
+    {
+      if ( const ws::FrameRing::Slot* slot = ring.front() )
+      {
+        const std::string payload( slot->payload, slot->header.payloadSize );
+        ASSERT_EQ( payload, payloadFor( i ) ) << "frame " << i;
+        EXPECT_EQ( slot->header.isMasked, i % 2 == 1 );
+        ring.pop();
+        ++i;
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  } );
+
+  // Odd sized reads so that frames also complete from the decoder's cache.
+  ws::Decoder decoder;
+  const size_t readSize{ 333 };
+  for ( size_t offset = 0; offset < bytes.size(); offset += readSize )
+  {
+    EXPECT_TRUE( decoder.decodeEach( bytes.data() + offset
+                                   , std::min( readSize, bytes.size() - offset )
+                                   , [&ring]( const ws::FrameView& view ) { ring.push( view ); } ) );
+  }
+
+  consumer.join();
+  EXPECT_EQ( ring.front(), nullptr );
+}
@@ -0,0 +1,130 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websocketsendfile.h>
+
+#include <cstdio>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+// Sends numBytes from offset of a file containing fileContents over a socket
+// pair and decodes whatever arrives at the other end.
+ws::Decoder::Result sendAndDecode( const std::string& fileContents
+                                 , off_t offset
+                                 , uint64_t numBytes
+                                 , size_t maxFramePayloadSize )
+{
+  FILE* file{ tmpfile() };
+  EXPECT_NE( file, nullptr );
+  EXPECT_EQ( fwrite( fileContents.data(), 1, fileContents.size(), file ), fileContents.size() );
+  fflush( file );
+
+  int sockets[2];
+  EXPECT_EQ( socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ), 0 );
+
+  ws::FileSender sender( fileno( file )
+                       , offset
+                       , numBytes
+                       , ws::Header::OpCode::eBinary
+                       , maxFramePayloadSize );
+  EXPECT_EQ( sender.send( sockets[0] ), ws::FileSender::Status::eComplete );
+  EXPECT_EQ( sender.numBytesRemaining(), 0U );
+  close( sockets[0] );
+
+  ws::Decoder decoder;
+  ws::Decoder::Result result;
+  char buffer[1000];
+  ssize_t n;
+  while ( ( n = read( sockets[1], buffer, sizeof(buffer) ) ) > 0 )
+  {
+    auto partial{ decoder.decode( buffer, n ) };
+    EXPECT_FALSE( partial.parseError );
+    for ( auto& frame : partial.frames )
+    {
+      result.frames.push_back( std::move( frame ) );
+    }
+    result.numExtra = partial.numExtra;
+  }
+  close( sockets[1] );
+  fclose( file );
+
+  return result;
+}
+
+TEST(Encoding, WebSocketSendFile)
+{
+  std::string contents;
+  for ( int i = 0; i < 10000; ++i )
+  {
+    contents.push_back( 'a' + i % 26 );
+  }
+
+  // Split across three frames, the last one short.
+  {
+    const auto result{ sendAndDecode( contents, 0, contents.size(), 4096 ) };
+    ASSERT_EQ( result.frames.size(), 3U );
+    EXPECT_EQ( result.numExtra, 0U );
+
+    EXPECT_FALSE( result.frames[0].header.fin );
+    EXPECT_EQ( result.frames[0].header.opCode, ws::Header::OpCode::eBinary );
+    EXPECT_FALSE( result.frames[0].header.isMasked );
+    EXPECT_EQ( result.frames[0].payload, contents.substr( 0, 4096 ) );
+
+    EXPECT_FALSE( result.frames[1].header.fin );
+    EXPECT_EQ( result.frames[1].header.opCode, ws::Header::OpCode::eContinuation );
+    EXPECT_EQ( result.frames[1].payload, contents.substr( 4096, 4096 ) );
+
+    EXPECT_TRUE( result.frames[2].header.fin );
+    EXPECT_EQ( result.frames[2].header.opCode, ws::Header::OpCode::eContinuation );
+    EXPECT_EQ( result.frames[2].payload, contents.substr( 8192 ) );
+  }
+
+  // Whole file in a single frame using the 8-byte extended payload size.
+  {
+    const auto result{ sendAndDecode( contents + contents + contents + contents + contents + contents + contents
+                                    , 0, 70000, ws::FileSender::defaultMaxFramePayloadSize ) };
+    ASSERT_EQ( result.frames.size(), 1U );
+    EXPECT_TRUE( result.frames[0].header.fin );
+    EXPECT_EQ( result.frames[0].header.payloadSize, 70000U );
+  }
+
+  // Part of the file from an offset, exact multiple of the frame size.
+  {
+    const auto result{ sendAndDecode( contents, 100, 200, 100 ) };
+    ASSERT_EQ( result.frames.size(), 2U );
+    EXPECT_FALSE( result.frames[0].header.fin );
+    EXPECT_EQ( result.frames[0].payload, contents.substr( 100, 100 ) );
+    EXPECT_TRUE( result.frames[1].header.fin );
+    EXPECT_EQ( result.frames[1].payload, contents.substr( 200, 100 ) );
+  }
+
+  // Nothing to send still produces a (single, empty) frame.
+  {
+    const auto result{ sendAndDecode( contents, 0, 0, 4096 ) };
+    ASSERT_EQ( result.frames.size(), 1U );
+    EXPECT_TRUE( result.frames[0].header.fin );
+    EXPECT_EQ( result.frames[0].header.opCode, ws::Header::OpCode::eBinary );
+    EXPECT_TRUE( result.frames[0].payload.empty() );
+  }
+}
@@ -0,0 +1,229 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <gtest/gtest.h>
+
+#include <lb/encoding/websockettable.h>
+
+#include <cstring>
+#include <map>
+
+
+namespace ws = lb::encoding::websocket;
+
+
+namespace
+{
+
+
+std::string encodeFrame( ws::Header::OpCode opCode, const std::string& payload, bool isMasked )
+{
+  ws::Header header;
+  header.fin = opCode != ws::Header::OpCode::eContinuation;
+  header.rsv2 = true;
+  header.opCode = opCode;
+  header.payloadSize = payload.size();
+  header.isMasked = isMasked;
+  header.mask[0] = 9;
+  header.mask[1] = 8;
+  header.mask[2] = 7;
+  header.mask[3] = 6;
+  std::string bytes( header.encodedSizeInBytes(), '\0' );
+  header.encode( bytes.data() );
+  return bytes + ( isMasked ? ws::encodeMaskedPayload( payload, header.mask ) : payload );
+}
+
+void expectSameFrames( const ws::Decoder::Result& expected, const ws::Decoder::Result& actual )
+{
+  EXPECT_EQ( expected.parseError, actual.parseError );
+  ASSERT_EQ( expected.frames.size(), actual.frames.size() );
+  for ( size_t i = 0; i < expected.frames.size(); ++i )
+  {
+    const ws::Header& e{ expected.frames[i].header };
+    const ws::Header& a{ actual.frames[i].header };
+    EXPECT_EQ( e.fin, a.fin );
+    EXPECT_EQ( e.rsv1, a.rsv1 );
+    EXPECT_EQ( e.rsv2, a.rsv2 );
+    EXPECT_EQ( e.rsv3, a.rsv3 );
+    EXPECT_EQ( e.opCode, a.opCode );
+    EXPECT_EQ( e.isMasked, a.isMasked );
+    EXPECT_EQ( e.payloadSize, a.payloadSize );
+    if ( e.isMasked )
+    {
+      EXPECT_EQ( std::memcmp( e.mask, a.mask, 4 ), 0 );
+    }
+    EXPECT_EQ( expected.frames[i].payload, actual.frames[i].payload );
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+TEST(Decoding, WebSocketDecoderTable)
+{
+  const std::string bytes{ encodeFrame( ws::Header::OpCode::eText, "Hello", false )
+                         + encodeFrame( ws::Header::OpCode::eBinary, std::string( 300, 'x' ), true )
+                         + encodeFrame( ws::Header::OpCode::eContinuation, std::string( 70000, 'y' ), true )
+                         + encodeFrame( ws::Header::OpCode::ePing, "", false ) };
+
+  // Three connections fed the same stream split in different places, all
+  // in step with a Decoder each.
+  ws::DecoderTable table;
+  std::vector<ws::DecoderTable::Id> ids;
+  std::vector<ws::Decoder> decoders( 3 );
+  for ( size_t i = 0; i < 3; ++i )
+  {
+    ids.push_back( table.add() );
+  }
+  EXPECT_EQ( table.size(), 3U );
+
+  for ( size_t split = 1; split < bytes.size(); split += 97 )
+  {
+    const size_t splits[] = { split, bytes.size() - split, std::min( split * 7, bytes.size() ) };
+    std::vector<ws::DecoderTable::Job> jobs;
+    std::vector<ws::Decoder::Result> results;
+    for ( size_t i = 0; i < 3; ++i )
+    {
+      jobs.push_back( { ids[i], bytes.data(), splits[i] } );
+      expectSameFrames( decoders[i].decode( bytes.data(), splits[i] ), table.decode( ids[i], bytes.data(), splits[i] ) );
+      EXPECT_EQ( decoders[i].hasPartialFrame(), table.hasPartialFrame( ids[i] ) );
+    }
+    for ( size_t i = 0; i < 3; ++i )
+    {
+      jobs[i] = { ids[i], bytes.data() + splits[i], bytes.size() - splits[i] };
+    }
+    table.decode( jobs, results );
+    ASSERT_EQ( results.size(), 3U );
+    for ( size_t i = 0; i < 3; ++i )
+    {
+      expectSameFrames( decoders[i].decode( jobs[i].src, jobs[i].numSrcBytes ), results[i] );
+      EXPECT_FALSE( table.hasPartialFrame( ids[i] ) );
+    }
+  }
+
+  // Parse error.
+  EXPECT_TRUE( table.decode( ids[0], "\x83\x00", 2 ).parseError );
+}
+
+TEST(Decoding, WebSocketDecoderTableIdNotInUse)
+{
+  const std::string frame{ encodeFrame( ws::Header::OpCode::eText, "Hello", false ) };
+
+  ws::DecoderTable table;
+  const ws::DecoderTable::Id removed{ table.add() };
+  const ws::DecoderTable::Id kept{ table.add() };
+  table.remove( removed );
+
+  // Neither a removed id nor one never added is decoded for.
+#ifdef NDEBUG
+  EXPECT_TRUE( table.decode( removed, frame.data(), frame.size() ).parseError );
+  EXPECT_TRUE( table.decode( table.idLimit(), frame.data(), frame.size() ).parseError );
+  EXPECT_FALSE( table.hasPartialFrame( removed ) );
+#else
+  EXPECT_DEATH( table.decode( removed, frame.data(), frame.size() ), "not in use" );
+  EXPECT_DEATH( table.decode( table.idLimit(), frame.data(), frame.size() ), "not in use" );
+#endif
+  EXPECT_EQ( table.size(), 1U );
+
+  // Reusing the id brings it back properly.
+  EXPECT_EQ( table.add(), removed );
+  EXPECT_EQ( table.decode( removed, frame.data(), frame.size() ).frames.size(), 1U );
+  EXPECT_EQ( table.decode( kept, frame.data(), frame.size() ).frames.size(), 1U );
+}
+
+TEST(Decoding, WebSocketDecoderTableCompact)
+{
+  const std::string frame{ encodeFrame( ws::Header::OpCode::eBinary, std::string( 1000, 'z' ), true ) };
+
+  ws::DecoderTable table;
+  std::map<ws::DecoderTable::Id, size_t> connections; // id -> connection number
+  for ( size_t i = 0; i < 100; ++i )
+  {
+    connections[ table.add() ] = i;
+  }
+
+  // Every tenth connection part way through a payload, every tenth plus one
+  // part way through a header.
+  for ( const auto& [ id, i ] : connections )
+  {
+    if ( i % 10 == 0 )
+    {
+      EXPECT_TRUE( table.decode( id, frame.data(), 500 ).frames.empty() );
+    }
+    else if ( i % 10 == 1 )
+    {
+      EXPECT_TRUE( table.decode( id, frame.data(), 3 ).frames.empty() );
+    }
+  }
+  size_t numPending{ 0 };
+  table.forEachPending( [&]( ws::DecoderTable::Id id )
+  {
+    EXPECT_LE( connections[ id ] % 10, 1U );
+    ++numPending;
+  } );
+  EXPECT_EQ( numPending, 20U );
+  EXPECT_EQ( table.numCachedBytes( 0 ), 500U - ( frame.size() - 1000 ) );
+  EXPECT_EQ( table.numCachedBytes( 1 ), 3U );
+
+  // Remove most of the connections, a freed id is reused.
+  for ( auto it = connections.begin(); it != connections.end(); )
+  {
+    if ( it->second % 10 > 1 && it->second != 55 )
+    {
+      table.remove( it->first );
+      it = connections.erase( it );
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  EXPECT_EQ( table.size(), 21U );
+  const ws::DecoderTable::Id reused{ table.add() };
+  EXPECT_LT( reused, 100U );
+  table.remove( reused );
+
+  const size_t memoryBefore{ table.memoryUsage() };
+  std::map<ws::DecoderTable::Id, size_t> moved;
+  table.compact( [&]( ws::DecoderTable::Id from, ws::DecoderTable::Id to )
+  {
+    moved[ to ] = connections.at( from );
+    connections.erase( from );
+  } );
+  connections.merge( moved );
+  EXPECT_LT( table.memoryUsage(), memoryBefore );
+  EXPECT_EQ( table.idLimit(), 21U );
+  ASSERT_EQ( connections.size(), 21U );
+  EXPECT_EQ( connections.rbegin()->first, 20U );
+
+  // Partial frames survive the move.
+  for ( const auto& [ id, i ] : connections )
+  {
+    const size_t numDone{ i % 10 == 0 ? 500U : i % 10 == 1 ? 3U : 0U };
+    const auto result{ table.decode( id, frame.data() + numDone, frame.size() - numDone ) };
+    ASSERT_EQ( result.frames.size(), 1U ) << "connection " << i;
+    EXPECT_EQ( result.frames[0].payload, std::string( 1000, 'z' ) );
+  }
+
+  // Reset drops a partial frame.
+  table.decode( 0, frame.data(), 10 );
+  EXPECT_TRUE( table.hasPartialFrame( 0 ) );
+  table.reset( std::vector<ws::DecoderTable::Id>{ 0 } );
+  EXPECT_FALSE( table.hasPartialFrame( 0 ) );
+  EXPECT_EQ( table.decode( 0, frame.data(), frame.size() ).frames.size(), 1U );
+}
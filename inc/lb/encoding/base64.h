@@ -18,6 +18,9 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <lb/encoding/base64alphabet.h>
+
+#include <optional>
 #include <string>
 
 
@@ -33,6 +36,15 @@ namespace base64
 {
 
 
+// The functions below are templates on the Alphabet to use, defined in
+// liblbEncoding.so for Standard, StandardUnpadded, Url and UrlUnpadded only.
+// See base64::inlined for an encoder that takes any alphabet.
+//
+// Each also has a plain overload for the Standard alphabet, which is what a
+// call without template arguments picks. These keep the symbols the library
+// exported before the templates, so existing binaries still link.
+
+
 /**
     \brief Encodes \a numSrcChars bytes of data from \a src to base64.
     \param src The bytes to encode (may contain nulls).
@@ -54,8 +66,17 @@ namespace base64
     3 will there be no padding bytes. The encoded data is always a multiple of
     4 bytes.
 
+    That is for the default, Standard, alphabet. Others are chosen with the
+    template parameter, e.g. encode<UrlUnpadded>( src, n, dst ), and unpadded
+    ones write just encodedSize<Alphabet>( numSrcChars ) bytes. All use the
+    same SIMD kernels.
+
     \sa std::string encode( const std::string& )
  */
+template< class Alphabet = Standard >
+void encode( const char* src, size_t numSrcChars, char* dst );
+
+//! encode<Standard>( src, numSrcChars, dst )
 void encode( const char* src, size_t numSrcChars, char* dst );
 
 /**
@@ -74,13 +95,93 @@ void encode( const char* src, size_t numSrcChars, char* dst );
     3 will there be no padding bytes. The encoded data is always a multiple of
     4 bytes.
 
-    This is a std::string wrapper for the C_string version. Beware this does
-    have a C-string copy overhead when creating the return value.
+    This is a std::string wrapper for the C-string version, encoding directly
+    into the returned string.
 
     \sa void encode( const char*, size_t, char* )
  */
+template< class Alphabet = Standard >
 std::string encode( const std::string& src );
 
+//! encode<Standard>( src )
+std::string encode( const std::string& src );
+
+
+/** \brief The outcome of decode( const char*, size_t, char* ). */
+struct DecodeResult
+{
+  enum class Status
+  {
+    eSuccess,
+    eInvalidCharacter, //!< Neither in the base64 alphabet nor '='
+    eInvalidPadding,   //!< A misplaced '=', or non-zero bits before the padding
+    eInvalidLength     //!< Not a multiple of 4 characters
+  };
+
+  // For logging and debugging
+  static std::string toString( Status );
+
+  Status status;
+
+  //! The number of bytes written to dst, the whole decoding on success and
+  //! everything before the quartet holding the error otherwise.
+  size_t numDstBytes;
+
+  //! The position in src of the first invalid character, or for
+  //! eInvalidLength the size of src. Zero on success.
+  size_t errorPosition;
+};
+
+/**
+    \brief Decodes \a numSrcChars characters of base64 from \a src.
+    \param src The base64 characters.
+    \param numSrcChars The number of characters to decode.
+    \param dst The destination for the decoded bytes. Assumes that
+               3 * (numSrcChars / 4) contiguous bytes are available for access.
+               That is up to two more than the decoding when there is padding.
+    \return Whether \a src was valid and, if not, where it went wrong.
+
+    Strict about what it accepts. The input must be a multiple of 4 characters
+    long, all from the standard alphabet with no whitespace, and padded with
+    one or two '=' as the encoder would pad it. The bits the padding makes
+    redundant must be zero, so every input has exactly one decoding and
+    every decoding exactly one input.
+
+    Uses SSE4.1 or AVX2, validating and translating 32 characters at a time,
+    where the CPU supports them (see dispatch.h).
+
+    Other alphabets are chosen with the template parameter as for encode().
+    Input for an unpadded alphabet must have no '=' at all and may end with a
+    partial quartet of 2 or 3 characters, so \a dst needs
+    3 * numSrcChars / 4 bytes.
+
+    \sa std::optional<std::string> decode( const std::string& )
+ */
+template< class Alphabet = Standard >
+DecodeResult decode( const char* src, size_t numSrcChars, char* dst );
+
+//! decode<Standard>( src, numSrcChars, dst )
+DecodeResult decode( const char* src, size_t numSrcChars, char* dst );
+
+/**
+    \brief Decodes the base64 characters in \a src.
+    \param src The base64 characters in the form of a std::string.
+    \return The decoded bytes (may contain nulls) or an empty optional if
+            \a src is not valid base64.
+
+    This is a std::string wrapper for the C-string version, see that for what
+    counts as valid. Use that version to find out what is wrong with invalid
+    input.
+
+    \sa DecodeResult decode( const char*, size_t, char* )
+ */
+template< class Alphabet = Standard >
+std::optional<std::string> decode( const std::string& src );
+
+//! decode<Standard>( src )
+std::optional<std::string> decode( const std::string& src );
+
+
 
 } // End of namespace base64
 
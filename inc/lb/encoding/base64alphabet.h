@@ -0,0 +1,100 @@
+#ifndef LB_ENCODING_BASE64ALPHABET_H
+#define LB_ENCODING_BASE64ALPHABET_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+/**
+    \brief An alphabet and padding policy for the base64 encoders and decoders.
+    \tparam c62 The character for the value 62.
+    \tparam c63 The character for the value 63.
+    \tparam padded Whether encodings are padded with '=' to a multiple of 4
+                   characters, and decodings must be.
+
+    The first 62 characters are always 'A' to 'Z', 'a' to 'z' and '0' to '9',
+    as in every common variant of base64, which is what lets the SIMD kernels
+    serve them all. The policy is a template parameter, not a run time
+    argument, so each variant compiles to code as fast as the standard one.
+
+    The library functions and classes are instantiated for the aliases below,
+    the header-only base64::inlined encoders for any alphabet.
+ */
+template< char c62, char c63, bool padded >
+struct Alphabet
+{
+  static_assert( c62 != c63 && c62 != '=' && c63 != '=' );
+
+  static constexpr char char62{ c62 };
+  static constexpr char char63{ c63 };
+  static constexpr bool isPadded{ padded };
+
+  //! The 64 characters in order of value, null terminated.
+  static constexpr char lookup[ 65 ]
+  {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
+    'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
+    'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm',
+    'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', c62, c63, '\0'
+  };
+};
+
+//! RFC 4648 section 4, the default everywhere.
+using Standard = Alphabet<'+', '/', true>;
+using StandardUnpadded = Alphabet<'+', '/', false>;
+
+//! RFC 4648 section 5, safe in URLs and file names.
+using Url = Alphabet<'-', '_', true>;
+
+//! As used by JSON Web Tokens (RFC 7515) among others.
+using UrlUnpadded = Alphabet<'-', '_', false>;
+
+
+/** \brief The number of characters encoding \a numSrcChars bytes gives. */
+template< class Alphabet >
+constexpr size_t encodedSize( size_t numSrcChars )
+{
+  return Alphabet::isPadded ? 4 * ( ( numSrcChars + 2 ) / 3 )
+                            : ( 4 * numSrcChars + 2 ) / 3;
+}
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_BASE64ALPHABET_H
@@ -0,0 +1,164 @@
+#ifndef LB_ENCODING_BASE64INLINE_H
+#define LB_ENCODING_BASE64INLINE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Header-only versions of the base64.h encoders, see namespace
+// base64::inlined.
+
+#include <lb/encoding/base64alphabet.h>
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+/**
+    \brief Header-only versions of the base64.h encoders, for short inputs in
+           hot loops.
+
+    Same output as base64::encode in liblbEncoding.so, see "Header-only
+    primitives" in README.md.
+
+    Like the library they take the alphabet as a template parameter, but
+    work with any Alphabet rather than just those the library instantiates.
+ */
+namespace inlined
+{
+
+
+/** \brief The standard alphabet's 64 characters, see Alphabet::lookup for
+           the others. */
+inline constexpr const char* lookup{ Standard::lookup };
+
+/**
+    \brief Converts 3 bytes of data to 4 bytes of base64 encoded data.
+    \param src The source bytes as an unsigned type to ensure bit shifting
+               yields zeros. Assumes 3 contiguous bytes can be accessed.
+    \param dst The destination buffer. Assumes that 4 contiguous bytes can be
+               written to.
+
+    Endian-agnostic.
+ */
+template< class Alphabet = Standard >
+inline void encodeTriplet( const unsigned char* src, char* dst )
+{
+  const uint32_t bits{ uint32_t( src[0] ) << 16 | uint32_t( src[1] ) << 8 | src[2] };
+  dst[0] = Alphabet::lookup[   bits >> 18          ];
+  dst[1] = Alphabet::lookup[ ( bits >> 12 ) & 0x3F ];
+  dst[2] = Alphabet::lookup[ ( bits >>  6 ) & 0x3F ];
+  dst[3] = Alphabet::lookup[   bits         & 0x3F ];
+}
+
+/**
+    \brief Converts 2 bytes of data to 3 bytes of base64 encoded data, plus a
+           padding byte i.e. '=' if the alphabet is padded.
+    \param src The source bytes as an unsigned type to ensure bit shifting
+               yields zeros. Assumes 2 contiguous bytes can be accessed.
+    \param dst The destination buffer. Assumes that 4 contiguous bytes, or 3
+               if unpadded, can be written to.
+
+    Endian-agnostic.
+ */
+template< class Alphabet = Standard >
+inline void encodeDoublet( const unsigned char* src, char* dst )
+{
+  const uint32_t bits{ uint32_t( src[0] ) << 16 | uint32_t( src[1] ) << 8 };
+  dst[0] = Alphabet::lookup[   bits >> 18          ];
+  dst[1] = Alphabet::lookup[ ( bits >> 12 ) & 0x3F ];
+  dst[2] = Alphabet::lookup[ ( bits >>  6 ) & 0x3F ];
+  if constexpr ( Alphabet::isPadded )
+  {
+    dst[3] = '=';
+  }
+}
+
+/**
+    \brief Converts 1 byte of data to 2 bytes of base64 encoded data, plus 2
+           padding bytes i.e. "==" if the alphabet is padded.
+    \param src The source byte as an unsigned type to ensure bit shifting
+               yields zeros.
+    \param dst The destination buffer. Assumes that 4 contiguous bytes, or 2
+               if unpadded, can be written to.
+
+    Endian-agnostic.
+ */
+template< class Alphabet = Standard >
+inline void encodeSinglet( const unsigned char* src, char* dst )
+{
+  const uint32_t bits{ uint32_t( src[0] ) << 16 };
+  dst[0] = Alphabet::lookup[   bits >> 18          ];
+  dst[1] = Alphabet::lookup[ ( bits >> 12 ) & 0x3F ];
+  if constexpr ( Alphabet::isPadded )
+  {
+    dst[2] = '=';
+    dst[3] = '=';
+  }
+}
+
+//! \sa base64::encode( const char*, size_t, char* )
+template< class Alphabet = Standard >
+inline void encode( const char* src, size_t numSrcChars, char* dst )
+{
+  const size_t extra{ numSrcChars % 3 };
+  const size_t numTriplets{ ( numSrcChars - extra ) / 3 };
+
+  const unsigned char* usrc{ (const unsigned char*)src };
+
+  for ( size_t i = 0; i < numTriplets; ++i, usrc += 3, dst += 4 )
+  {
+    encodeTriplet<Alphabet>( usrc, dst );
+  }
+
+  switch( extra )
+  {
+  case 1:
+    encodeSinglet<Alphabet>( usrc, dst );
+    break;
+  case 2:
+    encodeDoublet<Alphabet>( usrc, dst );
+    break;
+  default:
+    break;
+  }
+}
+
+
+} // End of namespace inlined
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+#endif // LB_ENCODING_BASE64INLINE_H
@@ -0,0 +1,197 @@
+#ifndef LB_ENCODING_BASE64STREAM_H
+#define LB_ENCODING_BASE64STREAM_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/base64.h>
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+/**
+    \brief Encodes a stream of bytes to base64 a chunk at a time.
+
+    The output is exactly that of encode() on the whole stream at once,
+    however it is split into chunks:
+
+      Encoder encoder;
+      while ( ... )
+      {
+        dst += encoder.update( chunk );
+      }
+      dst += encoder.finish();
+
+    Up to two bytes are carried from one update() to the next, so memory use
+    is constant whatever the size of the stream. The whole triplets in the
+    middle of each chunk go through encode() and its SIMD kernels.
+
+    After finish() the encoder is ready for a new stream. The Alphabet is as
+    for encode().
+ */
+template< class Alphabet = Standard >
+class Encoder
+{
+public:
+  /**
+      \brief Encodes the next \a numSrcChars bytes of the stream.
+      \param dst The destination for the encoding. Assumes that
+                 updateSize( numSrcChars ) contiguous bytes are available
+                 for access.
+      \return The number of characters written to \a dst.
+   */
+  size_t update( const char* src, size_t numSrcChars, char* dst );
+
+  /** \brief std::string wrapper for the C-string update(). */
+  std::string update( const std::string& src );
+
+  /**
+      \brief Encodes whatever is left of the stream, with any padding.
+      \param dst The destination. Assumes 4 bytes are available for access.
+      \return The number of characters written to \a dst, 0 or 4, or if
+              unpadded 0, 2 or 3.
+   */
+  size_t finish( char* dst );
+
+  /** \brief std::string wrapper for the C-string finish(). */
+  std::string finish();
+
+  /** \brief The number of characters update() writes for \a numSrcChars
+             more bytes. */
+  size_t updateSize( size_t numSrcChars ) const
+  {
+    return 4 * ( ( numPending + numSrcChars ) / 3 );
+  }
+
+private:
+  unsigned char pending[3];
+  size_t numPending{ 0 };
+};
+
+
+/**
+    \brief Decodes a stream of base64 characters a chunk at a time.
+
+    Accepts exactly the streams decode() accepts, however they are split into
+    chunks, and gives the same bytes:
+
+      Decoder decoder;
+      while ( ... )
+      {
+        if ( auto bytes{ decoder.update( chunk ) } ) dst += *bytes; else ...
+      }
+      if ( decoder.finish().status != DecodeResult::Status::eSuccess ) ...
+
+    Every whole quartet is decoded as soon as it arrives, through decode() and
+    its SIMD kernels, and up to three characters are carried over to the next
+    update(). So memory use is constant whatever the size of the stream.
+    Padding ends the stream, anything after it is an error. Without padding,
+    as for the unpadded alphabets, the final partial quartet can only be
+    decoded by finish().
+
+    Error positions count from the start of the stream. Once an error has
+    been reported the rest of the stream is ignored and update() and finish()
+    report it again, until finish() readies the decoder for a new stream.
+    The Alphabet is as for decode().
+ */
+template< class Alphabet = Standard >
+class Decoder
+{
+public:
+  /**
+      \brief Decodes the next \a numSrcChars characters of the stream.
+      \param dst The destination for the decoded bytes. Assumes that
+                 updateSize( numSrcChars ) contiguous bytes are available for
+                 access.
+      \return As for decode(), with numDstBytes the number of bytes written to
+              \a dst by this call.
+   */
+  DecodeResult update( const char* src, size_t numSrcChars, char* dst );
+
+  /**
+      \brief std::string wrapper for the C-string update().
+      \return The decoded bytes or an empty optional on an error.
+   */
+  std::optional<std::string> update( const std::string& src );
+
+  /**
+      \brief Decodes whatever is left of the stream.
+      \param dst The destination. Assumes 2 bytes are available for access.
+      \return As for decode(), with numDstBytes the number of bytes written
+              to \a dst, only ever non-zero for an unpadded alphabet. With
+              padding the stream must have ended on a whole quartet.
+   */
+  DecodeResult finish( char* dst );
+
+  /** \brief finish( char* ) for a padded alphabet, where there can be nothing
+             left to decode. */
+  DecodeResult finish() requires Alphabet::isPadded
+  {
+    char dst[2];
+    return finish( dst );
+  }
+
+  /** \brief The greatest number of bytes update() writes for \a numSrcChars
+             more characters. */
+  size_t updateSize( size_t numSrcChars ) const
+  {
+    return 3 * ( ( numPending + numSrcChars ) / 4 );
+  }
+
+private:
+  DecodeResult fail( DecodeResult::Status status, size_t errorPosition, size_t numDstBytes );
+  DecodeResult failAfterPadding( size_t numDstBytes );
+
+  //! Decodes whole quartets, keeping track of the position and padding.
+  DecodeResult decodeQuartets( const char* src, size_t numSrcChars, char* dst );
+
+  char pending[4];
+  size_t numPending{ 0 };
+
+  //! Characters decoded so far, not counting those pending.
+  size_t position{ 0 };
+
+  //! The number of '=' decoded, after which the stream must end.
+  size_t numPadding{ 0 };
+  DecodeResult error{ DecodeResult::Status::eSuccess, 0, 0 };
+};
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_BASE64STREAM_H
@@ -0,0 +1,101 @@
+#ifndef LB_ENCODING_BITSINLINE_H
+#define LB_ENCODING_BITSINLINE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Header-only versions of the bits.h encoders, see namespace bits::inlined.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace bits
+{
+
+
+/**
+    \brief Header-only versions of the bits.h encoders, for per byte calls in
+           hot loops.
+
+    Same output as bits::encode in liblbEncoding.so, see "Header-only
+    primitives" in README.md.
+ */
+namespace inlined
+{
+
+
+/** \brief Encode a byte value into 8 characters of ones and zeros, most
+           significant bit first.
+
+    Builds all eight characters in one 64-bit word and stores them at once.
+
+    \sa bits::encode( char, char* )
+ */
+inline void encode( char src, char* dst )
+{
+  // Spread bit i of the byte to the bottom of byte i of the word.
+  uint64_t word{ (unsigned char)src };
+  word = ( word | word << 28 ) & 0x0000000F0000000FULL;
+  word = ( word | word << 14 ) & 0x0003000300030003ULL;
+  word = ( word | word <<  7 ) & 0x0101010101010101ULL;
+
+  // Most significant bit first in memory.
+  if constexpr ( std::endian::native == std::endian::little )
+  {
+    word = __builtin_bswap64( word );
+  }
+
+  word += 0x3030303030303030ULL; // '0' in each byte
+  std::memcpy( dst, &word, 8 );
+}
+
+/** \brief Encodes \a numSrcBytes bytes from \a src, 8 characters each.
+    \param dst Assumes that 8 * \a numSrcBytes contiguous bytes are available
+               for access.
+ */
+inline void encode( const char* src, size_t numSrcBytes, char* dst )
+{
+  for ( size_t i = 0; i < numSrcBytes; ++i )
+  {
+    encode( src[i], dst + 8 * i );
+  }
+}
+
+
+} // End of namespace inlined
+
+
+} // End of namespace bits
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+#endif // LB_ENCODING_BITSINLINE_H
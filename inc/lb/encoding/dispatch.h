@@ -0,0 +1,124 @@
+#ifndef LB_ENCODING_DISPATCH_H
+#define LB_ENCODING_DISPATCH_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace dispatch
+{
+
+
+/**
+    \brief The instruction set levels kernels are built for, in increasing
+           order of capability.
+
+    Each level implies all those before it. Every function with SIMD kernels
+    uses the best kernel at or below the active tier, see activeTier().
+ */
+enum class Tier
+{
+  eBaseline,   //!< Whatever the compiler targets by default, SSE2 on x86-64
+  eSse41,      //!< SSE4.1
+  eAvx2,       //!< AVX2
+  eAvx512,     //!< AVX-512 F and BW
+  eAvx512Vbmi  //!< AVX-512 F, BW and VBMI
+};
+
+// For logging and debugging. Also the names accepted by toTier().
+std::string toString( Tier );
+
+/**
+    \brief Converts a name as given by toString( Tier ), e.g. "avx2", to a
+           Tier.
+    \return The Tier or an empty optional if there is no match.
+ */
+std::optional<Tier> toTier( std::string_view );
+
+
+/** \brief The best tier the CPU, and operating system, support. */
+Tier detectedTier();
+
+/**
+    \brief The tier kernels are currently chosen for.
+
+    Normally the same as detectedTier(). Setting the environment variable
+    LB_ENCODING_FORCE_TIER to the name of a tier before the library is loaded
+    lowers it to that tier, which is useful for testing and for comparing
+    kernels. A tier above detectedTier() is never used whatever is asked for.
+ */
+Tier activeTier();
+
+/**
+    \brief Lowers the active tier to \a tier, or to detectedTier() if that is
+           lower, and re-selects every kernel accordingly.
+
+    Meant for tests. It must not be called while other threads may be using
+    the library. To get back to the default afterwards save activeTier()
+    beforehand and call with that, it is only detectedTier() when
+    LB_ENCODING_FORCE_TIER has not lowered it.
+ */
+void forceTier( Tier tier );
+
+
+/** \brief Describes the kernel selected for one dispatched function. */
+struct Kernel
+{
+  std::string function; //!< The dispatched function, e.g. "sha1::encodeBatch"
+  std::string name;     //!< The kernel currently in use, e.g. "avx2"
+  Tier tier;            //!< The tier the kernel requires
+};
+
+/**
+    \brief The kernels currently selected for each dispatched function, in
+           alphabetical order of function name.
+
+    Intended for logging at startup, see also describe().
+ */
+std::vector<Kernel> selectedKernels();
+
+/**
+    \brief A one line summary of the tiers and selectedKernels(), e.g.
+
+      tier avx2 (detected avx512vbmi): sha1::encodeBatch=avx2 ...
+ */
+std::string describe();
+
+
+} // End of namespace dispatch
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_DISPATCH_H
@@ -69,8 +69,8 @@ void encode( const char* src, size_t numSrcBytes, char* dst );
 
     A bare bones alternative to using a C++ stream with the std::hex manipulator.
 
-    This is a std::string wrapper for the C_string version. Beware this does
-    have a C-string copy overhead when creating the return value.
+    This is a std::string wrapper for the C-string version, encoding directly
+    into the returned string.
  */
 std::string encode( const std::string& src );
 
@@ -0,0 +1,88 @@
+#ifndef LB_ENCODING_HEXINLINE_H
+#define LB_ENCODING_HEXINLINE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Header-only versions of the hex.h encoders, see namespace hex::inlined.
+
+#include <cstddef>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace hex
+{
+
+
+/**
+    \brief Header-only versions of the hex.h encoders, for per byte calls in
+           hot loops.
+
+    Same output as their namesakes in liblbEncoding.so, see "Header-only
+    primitives" in README.md.
+ */
+namespace inlined
+{
+
+
+/** \brief The uppercase hexadecimal digit for \a nibble, 0 to 15.
+
+    Arithmetic rather than a table lookup so that loops of it vectorise.
+ */
+inline char digit( unsigned nibble )
+{
+  // Past '9' skip the seven characters before 'A'.
+  return char( '0' + nibble + ( ( ( 9 - int( nibble ) ) >> 31 ) & 7 ) );
+}
+
+//! \sa hex::encode( char, char* )
+inline void encode( char src, char* dst )
+{
+  const unsigned char byte( src );
+  dst[0] = digit( byte >> 4 );
+  dst[1] = digit( byte & 0x0F );
+}
+
+//! \sa hex::encode( const char*, size_t, char* )
+inline void encode( const char* src, size_t numSrcBytes, char* dst )
+{
+  for ( size_t i = 0; i < numSrcBytes; ++i )
+  {
+    encode( src[i], dst + 2 * i );
+  }
+}
+
+
+} // End of namespace inlined
+
+
+} // End of namespace hex
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+#endif // LB_ENCODING_HEXINLINE_H
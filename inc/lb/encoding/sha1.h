@@ -19,7 +19,9 @@
 */
 
 #include <cstddef>
+#include <span>
 #include <string>
+#include <string_view>
 
 
 namespace lb
@@ -74,14 +76,55 @@ void encode( const char* src, size_t numSrcChars, char* dst );
 
     Obviously this is a one-way encoding.
 
-    This is a std::string wrapper for the C_string version. Beware this does
-    have a C-string copy overhead when creating the return value.
+    This is a std::string wrapper for the C-string version, encoding directly
+    into the returned string.
 
     \sa void encode( const char*, size_t, char* )
  */
 std::string encode( const std::string& );
 
 
+/**
+    \brief Computes the SHA1 digests of \a numMessages independent messages.
+    \param srcs The start of each message (may contain nulls).
+    \param numSrcChars The size in bytes of each message.
+    \param numMessages The number of entries in \a srcs and \a numSrcChars.
+    \param dst The destination for the digests. Assumes that 20 * \a numMessages
+               contiguous bytes are available for access. The digest of message
+               i starts at dst + 20 * i.
+
+    Produces exactly the same digests as calling the C-string encode for each
+    message in turn but, rather than hashing them one after another, hashes
+    several at once, one per SIMD lane. That is four lanes with SSE2, eight
+    with AVX2 and sixteen with AVX-512, the widest the CPU supports being
+    chosen at runtime (see dispatch.h).
+
+    Works best when the messages are of similar length since each group of
+    lanes takes as long as its longest message. A typical use is the
+    Sec-WebSocket-Accept keys of many clients connecting at once.
+
+    \sa void encode( const char*, size_t, char* )
+ */
+void encodeBatch( const char* const* srcs
+                , const size_t* numSrcChars
+                , size_t numMessages
+                , char* dst );
+
+/**
+    \brief Computes the SHA1 digests of the messages in \a srcs.
+    \param srcs The messages (may contain nulls).
+    \param dst The destination for the digests, the digest of message i
+               starting at dst.data() + 20 * i.
+    \throw std::length_error if \a dst is smaller than 20 * srcs.size().
+
+    A span wrapper for the pointer version, see that for details. Hands the
+    messages over in fixed size groups so does not allocate.
+
+    \sa void encodeBatch( const char* const*, const size_t*, size_t, char* )
+ */
+void encodeBatch( std::span<const std::string_view> srcs, std::span<char> dst );
+
+
 } // End of namespace sha1
 
 
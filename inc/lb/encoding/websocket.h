@@ -19,6 +19,7 @@
 */
 
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -93,6 +94,10 @@ struct Header
   opCode{ OpCode::eContinuation };
   static std::string toString( OpCode );
 
+  //! The number of values the four bit op code field can hold.
+  static constexpr size_t numOpCodeValues{ 16 };
+  static_assert( size_t( OpCode::ePong ) < numOpCodeValues );
+
   bool isMasked{ false };
   uint64_t payloadSize{ 0 };
   uint8_t mask[4] { 0, 0, 0, 0 };
@@ -119,6 +124,10 @@ struct Header
   };
   static std::string toString( DecodeResult );
 
+  //! The number of DecodeResult values, keep in step with the last of them.
+  static constexpr size_t numDecodeResults{ 5 };
+  static_assert( size_t( DecodeResult::ePayloadSizeEighthByteMSBNotZero ) + 1 == numDecodeResults );
+
   /** \brief Decodes the bytes in \a src into this \a Header.
       \param src May contain more bytes than required, the extra bytes are ignored.
       \param numSrcBytes The number of available bytes in \a src.
@@ -153,6 +162,32 @@ struct Frame
 {
   Header header;
   std::string payload;
+
+  /** \brief When the call to Decoder::decode that delivered the first byte of
+             this frame was made. Only set if the \a Decoder was asked to with
+             Decoder::setRecordFirstByteTimes, otherwise the clock's epoch.
+   */
+  std::chrono::steady_clock::time_point firstByteTime;
+};
+
+
+/** \brief A decoded frame whose payload is left where the \a Decoder found it.
+
+    See Decoder::decodeNextView.
+ */
+struct FrameView
+{
+  Header header;
+
+  /** \brief The header.payloadSize payload bytes, still masked if
+             header.isMasked. Points into the buffer passed to the
+             \a Decoder or into the \a Decoder's own cache so is only valid
+             until the next call to the \a Decoder or until the buffer changes.
+   */
+  const char* payload{ nullptr };
+
+  /** \brief As Frame::firstByteTime. */
+  std::chrono::steady_clock::time_point firstByteTime;
 };
 
 
@@ -225,6 +260,121 @@ public:
    */
   Result decode( const char* src, size_t numSrcBytes );
 
+  enum class Step
+  {
+    eFrame,      //!< A frame was decoded.
+    eNeedMore,   //!< All bytes consumed (and cached) without finishing a frame.
+    eParseError  //!< Invalid header, the \a Decoder cannot continue.
+  };
+  static std::string toString( Step );
+
+  /** \brief Decodes at most one frame from the front of \a src.
+      \param src Advanced past the bytes consumed.
+      \param numSrcBytes Reduced by the number of bytes consumed.
+      \param frame Receives the frame on eFrame. Reusing the same \a Frame
+             lets its payload's storage be reused too.
+      \return eFrame if a frame was decoded, in which case there may be bytes
+              left in \a src for another call. Otherwise see Step.
+
+      The pull based alternative to decode(), sharing its state, for callers
+      that want frames one at a time without a \a Result vector. Call it until
+      it returns eNeedMore then refill the buffer.
+   */
+  Step decodeNext( const char*& src, size_t& numSrcBytes, Frame& frame );
+
+  /** \brief As decodeNext() but without copying the payload.
+      \param view Receives the frame on eFrame, see FrameView for how long
+             its payload stays valid.
+
+      Lets the caller copy the payload straight to its final home, a
+      FrameRing slot say, unmasking it on the way.
+   */
+  Step decodeNextView( const char*& src, size_t& numSrcBytes, FrameView& view );
+
+  /** \brief Calls \a onFrame with a FrameView for each frame in \a src.
+      \return False if there was a parse error, true once all of \a src has
+              been consumed.
+
+      The callback alternative to decode(), with no allocation per frame.
+   */
+  template< class Callback >
+  bool decodeEach( const char* src, size_t numSrcBytes, Callback&& onFrame )
+  {
+    FrameView view;
+    while ( true )
+    {
+      switch ( decodeNextView( src, numSrcBytes, view ) )
+      {
+      case Step::eFrame:
+        onFrame( view );
+        break;
+      case Step::eNeedMore:
+        return true;
+      case Step::eParseError:
+        return false;
+      }
+    }
+  }
+
+  /** \brief Sets whether Frame::firstByteTime is filled in. Off by default.
+
+      The steady clock is read once per call to decode() so frames that arrive
+      in the same call share a time. Comparing it with the time the frame is
+      returned gives how long a frame spread over many reads took to arrive,
+      see LatencyHistogram in websocketlatency.h.
+   */
+  void setRecordFirstByteTimes( bool );
+
+  /** \brief Whether part of a frame is cached awaiting more bytes. */
+  bool hasPartialFrame() const;
+
+  /** \brief Counters describing the work a \a Decoder has done.
+
+      Only maintained if the library was built with LB_ENCODING_WEBSOCKET_STATS
+      defined (the default, see WEBSOCKET_STATS in the Makefile), otherwise
+      they stay at zero. Use statsEnabled() to tell which.
+
+      Every way of decoding, decode(), decodeNext(), decodeNextView() and
+      decodeEach(), updates them alike, so "decode calls" below means calls
+      to any of these.
+
+      Stats from many decoders can be summed with operator+= for export.
+   */
+  struct Stats
+  {
+    //! Bytes passed in to decode calls.
+    uint64_t numBytesIn{ 0 };
+
+    //! Complete frames returned, indexed by the numeric value of the OpCode.
+    uint64_t numFrames[ Header::numOpCodeValues ] {};
+
+    //! Decode calls that ran out of input part way through a \a Header.
+    uint64_t numPartialHeaders{ 0 };
+
+    //! Decode calls that ran out of input part way through a payload.
+    uint64_t numPartialPayloads{ 0 };
+
+    //! Bytes copied into the cache for frames spanning decode calls.
+    uint64_t numBytesCopied{ 0 };
+
+    //! The most bytes held in the cache at once. The maximum when summed.
+    uint64_t peakBufferedBytes{ 0 };
+
+    //! Parse errors, indexed by the numeric value of the Header::DecodeResult.
+    uint64_t numParseErrors[ Header::numDecodeResults ] {};
+
+    uint64_t numFramesWith( Header::OpCode opCode ) const { return numFrames[ size_t( opCode ) ]; }
+    uint64_t numParseErrorsWith( Header::DecodeResult r ) const { return numParseErrors[ size_t( r ) ]; }
+
+    Stats& operator+=( const Stats& );
+  };
+
+  /** \brief The counters for this \a Decoder so far. */
+  const Stats& stats() const;
+
+  /** \brief Whether the library was built to maintain \a Stats. */
+  static bool statsEnabled();
+
 private:
   struct Private;
   std::unique_ptr<Private> d;
@@ -244,6 +394,9 @@ private:
                of contiguous bytes are available for access. If desired, \a dst
                may be be the same as \a src i.e. in-place conversion supported.
 
+    Uses the widest vectors the CPU supports, chosen at runtime (see
+    dispatch.h).
+
     Note that decoding is the same operation, you can either call this function
     for decoding or the wrapper decodeMaskedPayload. If you use \a Decoder then
     this is all done for you anyway.
@@ -266,8 +419,7 @@ void decodeMaskedPayload( const char* src
     \param src The bytes to encode in the form of a std::string (may contain nulls).
     \param mask The four byte mask from the \a Header.
 
-    This is a std::string variant of the C_string version. In order to do the
-    masking in-place it uses different code so is not a wrapper as such.
+    This is a std::string variant of the C_string version, masking in-place.
 
     Note that decoding is the same operation, you can either call this function
     for decoding or the wrapper decodeMaskedPayload. If you use \a Decoder then
@@ -288,9 +440,9 @@ void decodeMaskedPayload( std::string& src
     \param mask The four byte mask from the \a Header.
     \return The masked string. Size will be identical to \a src.
 
-    This is a std::string wrapper for the C_string version. Beware this does
-    have a C-string copy overhead when creating the return value. Use the
-    in-place std::string overload if you do not want a copy.
+    This is a std::string wrapper for the C-string version, masking directly
+    into the returned string. Use the in-place std::string overload if you do
+    not want a copy.
 
     Note that decoding is the same operation, you can either call this function
     for decoding or the wrapper decodeMaskedPayload. If you use \a Decoder then
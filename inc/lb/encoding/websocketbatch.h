@@ -0,0 +1,152 @@
+#ifndef LB_ENCODING_WEBSOCKETBATCH_H
+#define LB_ENCODING_WEBSOCKETBATCH_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocket.h>
+
+#include <memory>
+#include <vector>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Coalesces many outbound frames into one contiguous buffer so that
+           they can be written with a single system call.
+
+    Each append() encodes the \a Header and copies the payload (masking it on
+    the way if the \a Header says so) straight after the previous frame. When
+    the batch reaches its flush threshold, or at some natural flush point such
+    as the end of an event loop iteration, write it out with flush() or with
+    your own I/O via data(), size() and consume().
+
+    Writes may be partial. The batcher keeps track of where each frame ends so
+    after a partial write it can say how many frames made it out in full,
+    which is useful if frames have completion callbacks or similar. Unwritten
+    bytes stay in the buffer for the next flush.
+
+    The buffer is reused. Once everything has been written it is reset without
+    being freed, so a steady state of appending and flushing does not allocate.
+ */
+class FrameBatcher
+{
+public:
+  static const size_t defaultFlushThreshold{ 64 * 1024 };
+
+  /**
+      \brief Construct a FrameBatcher.
+      \param flushThreshold The number of pending bytes at which append()
+             starts returning true to suggest a flush.
+   */
+  FrameBatcher( size_t flushThreshold = defaultFlushThreshold );
+
+  // Default move construction and move assignment. Copy forbidden.
+  FrameBatcher( FrameBatcher&& ) = default;
+  FrameBatcher& operator=( FrameBatcher&& ) = default;
+  FrameBatcher( const FrameBatcher& ) = delete;
+  FrameBatcher& operator=( const FrameBatcher& ) = delete;
+
+  /** \brief Appends a frame to the batch.
+      \param header The frame header. If \a isMasked is set the payload is
+             masked with \a mask as it is copied.
+      \param payload The unmasked payload bytes, header.payloadSize of them.
+      \return True if the batch has reached the flush threshold.
+   */
+  bool append( const Header& header, const char* payload );
+
+  /** \brief As above with the payload in a std::string.
+      \throw std::invalid_argument if \a payload is not header.payloadSize
+             bytes, leaving the batch unchanged.
+   */
+  bool append( const Header& header, const std::string& payload );
+
+  /** \brief The start of the bytes not yet written. */
+  const char* data() const { return storage.get() + begin; }
+
+  /** \brief The number of bytes not yet written. */
+  size_t size() const { return end - begin; }
+
+  bool empty() const { return begin == end; }
+
+  /** \brief The number of frames not yet completely written. */
+  size_t numFrames() const { return frameEnds.size() - firstFrame; }
+
+  /** \brief Whether the batch has reached the flush threshold. */
+  bool isFlushDue() const { return size() >= flushThreshold; }
+
+  /** \brief Marks the first \a numBytes of data() as written.
+      \param numBytes The number of bytes written, at most size().
+      \return The number of frames this completed.
+   */
+  size_t consume( size_t numBytes );
+
+  enum class Status
+  {
+    eComplete,   //!< Everything has been written, the batch is empty.
+    eWouldBlock, //!< Non-blocking socket is full, flush() again later.
+    eError       //!< Check errno for the reason.
+  };
+  static std::string toString( Status );
+
+  /** \brief Writes as many pending bytes to \a socketFd as possible.
+      \param socketFd The socket to write to.
+      \param numFramesWritten If not null, set to the number of frames this
+             call completed.
+      \return eComplete once the batch is empty, otherwise see Status.
+   */
+  Status flush( int socketFd, size_t* numFramesWritten = nullptr );
+
+  /** \brief Discards everything pending. Capacity is retained. */
+  void clear();
+
+private:
+  char* reserve( size_t numBytes );
+
+  size_t flushThreshold;
+
+  std::unique_ptr<char[]> storage;
+  size_t capacity{ 0 };
+  size_t begin{ 0 };
+  size_t end{ 0 };
+
+  //! Offset into storage one past the final byte of each pending frame.
+  std::vector<size_t> frameEnds;
+  size_t firstFrame{ 0 };
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETBATCH_H
@@ -0,0 +1,113 @@
+#ifndef LB_ENCODING_WEBSOCKETGROUP_H
+#define LB_ENCODING_WEBSOCKETGROUP_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <lb/encoding/websocket.h>
+
+#include <memory>
+#include <vector>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Decodes the pending input of many connections in parallel.
+
+    Typically used after each call to epoll_wait or similar, when there is a
+    freshly read buffer for each of many connections, each connection with its
+    own \a Decoder. Decoders are independent so each buffer can be decoded on
+    any thread:
+
+      jobs.clear();
+      for ( ... readable connections ... )
+      {
+        jobs.push_back( { &connection.decoder, connection.buffer, numRead } );
+      }
+      group.decode( jobs, results );
+      // results[i] is from jobs[i]
+
+    The jobs are shared out between the pool's threads and the calling thread
+    in contiguous runs. A thread that runs out of work steals the back half of
+    another thread's remaining run, so one connection with a lot of input does
+    not hold up the rest of the batch.
+
+    A \a Decoder may only appear once in a batch, and the buffers must stay
+    untouched until decode() returns. Only one thread may call decode() at a
+    time.
+ */
+class DecoderGroup
+{
+public:
+  struct Job
+  {
+    Decoder* decoder;
+    const char* src;
+    size_t numSrcBytes;
+  };
+
+  /**
+      \brief Construct a DecoderGroup.
+      \param numThreads The number of threads decoding, including the caller
+             of decode(). Zero means one per hardware thread.
+   */
+  DecoderGroup( size_t numThreads = 0 );
+  ~DecoderGroup();
+
+  // Owns threads so neither copyable nor movable.
+  DecoderGroup( const DecoderGroup& ) = delete;
+  DecoderGroup& operator=( const DecoderGroup& ) = delete;
+
+  size_t numThreads() const;
+
+  /** \brief Decodes each job with Decoder::decode.
+      \param jobs The decoders and their input.
+      \param results Resized to match \a jobs, results[i] being for jobs[i].
+
+      Returns once every job has been decoded. If a decode throws, the rest of
+      the batch is still decoded and the first exception is then rethrown.
+   */
+  void decode( const std::vector<Job>& jobs, std::vector<Decoder::Result>& results );
+  std::vector<Decoder::Result> decode( const std::vector<Job>& jobs );
+
+private:
+  struct Private;
+  std::unique_ptr<Private> d;
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETGROUP_H
@@ -0,0 +1,179 @@
+#ifndef LB_ENCODING_WEBSOCKETHANDSHAKE_H
+#define LB_ENCODING_WEBSOCKETHANDSHAKE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief The server side of the WebSocket opening handshake.
+
+    See RFC 6455 Section 4.2 for detail. The client sends an HTTP/1.1 GET
+    request asking to upgrade the connection, along the lines of
+
+      GET /chat HTTP/1.1
+      Host: server.example.com
+      Upgrade: websocket
+      Connection: Upgrade
+      Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==
+      Sec-WebSocket-Version: 13
+
+    and the server accepts it by replying with
+
+      HTTP/1.1 101 Switching Protocols
+      Upgrade: websocket
+      Connection: Upgrade
+      Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=
+
+    Nothing here allocates. The parsed request refers directly to the bytes
+    that were passed in and the response is written to a caller buffer.
+ */
+namespace handshake
+{
+
+
+//! The size of the Sec-WebSocket-Key value sent by the client.
+const size_t keySize{ 24 };
+
+//! The size of the Sec-WebSocket-Accept value sent by the server.
+const size_t acceptKeySize{ 28 };
+
+//! The fixed GUID appended to the key before hashing. Not null terminated.
+extern const char guid[ 36 ];
+
+
+/** \brief The parts of an opening handshake request we care about.
+
+    The string_views point into the buffer passed to parse() so are only valid
+    for as long as that is. Absent optional headers are left empty.
+ */
+struct Request
+{
+  std::string_view method;
+  std::string_view target;
+  std::string_view host;
+  std::string_view upgrade;
+  std::string_view connection;
+  std::string_view key;
+  std::string_view version;
+  std::string_view origin;
+  std::string_view protocols;
+  std::string_view extensions;
+
+  //! The size of the request including the terminating empty line.
+  size_t numBytes{ 0 };
+};
+
+
+enum class ParseResult
+{
+  eSuccess,
+  eIncomplete,          //!< No empty line yet, wait for more bytes.
+  eMalformed,           //!< Not a valid HTTP/1.1 request.
+  eNotGet,
+  eMissingHost,
+  eNotUpgrade,          //!< Upgrade header absent or not "websocket".
+  eNotConnectionUpgrade,//!< Connection header absent or lacks "Upgrade".
+  eInvalidKey,
+  eUnsupportedVersion   //!< Sec-WebSocket-Version absent or not 13.
+};
+std::string toString( ParseResult );
+
+
+/** \brief Parses the bytes in \a src as an opening handshake request.
+    \param src The bytes received from the client so far.
+    \param numSrcBytes The number of available bytes in \a src.
+    \param request Populated with views into \a src. Only valid if the return
+           is ParseResult::eSuccess.
+    \return An enum value describing the outcome of the parsing.
+
+    Parsing stops at the first empty line. Any bytes after that are left alone
+    and their position can be found from Request::numBytes. A client is not
+    supposed to send anything before it has received the response, but if it
+    does they will be the start of the first frame.
+
+    If eIncomplete is returned simply call again with more bytes. There is no
+    limit on request size here so it is up to the caller to give up on a client
+    that never sends an empty line.
+ */
+ParseResult parse( const char* src, size_t numSrcBytes, Request& request );
+
+
+/** \brief Computes the Sec-WebSocket-Accept value for the client's key.
+    \param key The Sec-WebSocket-Key value from the client.
+    \param dst The destination for the base64 encoded accept key. Assumes that
+               acceptKeySize contiguous bytes are available for access. Not
+               null terminated.
+ */
+void computeAcceptKey( const char key[ keySize ], char dst[ acceptKeySize ] );
+
+
+/**
+    \brief The size in bytes of the response encodeResponse() would write for
+           \a protocol.
+ */
+size_t encodedResponseSize( std::string_view protocol = {} );
+
+/** \brief Encodes the 101 Switching Protocols response accepting \a request.
+    \param request A request for which parse() returned ParseResult::eSuccess.
+    \param dst The destination for the encoding. Assumes that
+               encodedResponseSize( protocol ) contiguous bytes are available
+               for access.
+    \param protocol The subprotocol chosen from Request::protocols, if any.
+    \return The number of bytes written to \a dst.
+ */
+size_t encodeResponse( const Request& request
+                     , char* dst
+                     , std::string_view protocol = {} );
+
+/** \brief A complete HTTP response rejecting a request that failed to parse.
+
+    Points at static storage. Empty for eSuccess and eIncomplete since there
+    is nothing to reject (yet). A failed version check includes the version we
+    do support as required by RFC 6455 Section 4.4.
+ */
+std::string_view errorResponse( ParseResult );
+
+
+} // End of namespace handshake
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETHANDSHAKE_H
@@ -0,0 +1,119 @@
+#ifndef LB_ENCODING_WEBSOCKETLATENCY_H
+#define LB_ENCODING_WEBSOCKETLATENCY_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocket.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Histogram of latencies in nanoseconds with bounded relative error.
+
+    Buckets are laid out as in HdrHistogram. Values below 32 have a bucket
+    each. Above that every power of two is split into 16 equal buckets so any
+    recorded value is known to within 1 part in 16 whatever its magnitude.
+    Recording is a count leading zeros, a shift and an increment with no
+    allocation or branching on the value, cheap enough to do for every frame.
+
+    Histograms from many threads or connections can be summed with operator+=.
+ */
+class LatencyHistogram
+{
+public:
+  static constexpr int subBucketBits{ 5 };
+  static constexpr size_t numBuckets{ ( 64 - subBucketBits + 2 ) << ( subBucketBits - 1 ) };
+
+  /** \brief Records one latency of \a nanoseconds. */
+  void record( uint64_t nanoseconds )
+  {
+    ++counts[ bucketIndex( nanoseconds ) ];
+    ++numValues;
+    sum += nanoseconds;
+    min = nanoseconds < min ? nanoseconds : min;
+    max = nanoseconds > max ? nanoseconds : max;
+  }
+
+  /** \brief Records the time from \a frame's first byte to \a completed.
+
+      The \a Decoder that produced \a frame must have been asked to record
+      first byte times, see Decoder::setRecordFirstByteTimes.
+   */
+  void record( const Frame& frame, std::chrono::steady_clock::time_point completed )
+  {
+    const auto elapsed{ completed - frame.firstByteTime };
+    record( elapsed.count() > 0 ? std::chrono::duration_cast<std::chrono::nanoseconds>( elapsed ).count() : 0 );
+  }
+
+  uint64_t count() const { return numValues; }
+  uint64_t minValue() const { return numValues > 0 ? min : 0; }
+  uint64_t maxValue() const { return max; }
+  double mean() const { return numValues > 0 ? double( sum ) / numValues : 0.0; }
+
+  /** \brief The value at or below which \a percent of the recorded values lie.
+
+      As with HdrHistogram the result is the highest value that shares a
+      bucket with the value found, clamped to the largest value recorded.
+   */
+  uint64_t valueAtPercentile( double percent ) const;
+
+  LatencyHistogram& operator+=( const LatencyHistogram& );
+
+  void reset();
+
+  //! The bucket that \a value is counted in.
+  static size_t bucketIndex( uint64_t value )
+  {
+    // Bucket k > 0 holds values with k + subBucketBits - 1 significant bits.
+    const int numBits{ 64 - __builtin_clzll( value | 1 ) };
+    const int shift{ numBits > subBucketBits ? numBits - subBucketBits : 0 };
+    return ( size_t( shift ) << ( subBucketBits - 1 ) ) + ( value >> shift );
+  }
+
+  //! The highest value that is counted in bucket \a index.
+  static uint64_t highestValueIn( size_t index );
+
+private:
+  uint64_t counts[ numBuckets ] {};
+  uint64_t numValues{ 0 };
+  uint64_t sum{ 0 };
+  uint64_t min{ UINT64_MAX };
+  uint64_t max{ 0 };
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETLATENCY_H
@@ -0,0 +1,130 @@
+#ifndef LB_ENCODING_WEBSOCKETMASK_H
+#define LB_ENCODING_WEBSOCKETMASK_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocket.h>
+
+#include <cstring>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Source of unpredictable masking keys for client frames.
+
+    RFC 6455 section 5.3 requires a fresh mask for every frame a client sends,
+    drawn from a strong source of entropy. Asking the kernel for four bytes per
+    frame costs a system call each time so instead the generator is keyed from
+    getrandom(2) and expanded with ChaCha20 a kilobyte at a time. Each refill
+    replaces the key with the first 32 bytes of its own output so earlier masks
+    cannot be recovered from the generator's state.
+
+    A default constructed generator takes a new key from the kernel every few
+    megabytes of output and in the child after a fork(), so that parent and
+    child never hand out the same masks. One constructed from an explicit key
+    does neither and produces a repeatable sequence, which is only of use for
+    testing.
+
+    Not thread safe. Most code should simply call generateMask() which uses a
+    generator private to the calling thread.
+ */
+class MaskGenerator
+{
+public:
+  static const size_t keySize{ 32 };
+
+  MaskGenerator();
+  MaskGenerator( const uint8_t key[keySize] );
+  ~MaskGenerator();
+
+  // Copying would duplicate the sequence of masks.
+  MaskGenerator( const MaskGenerator& ) = delete;
+  MaskGenerator& operator=( const MaskGenerator& ) = delete;
+
+  /** \brief Writes the next four byte mask to \a mask. */
+  void next( uint8_t mask[4] )
+  {
+    if ( numAvailable < 4 || forkGeneration != numForks )
+    {
+      refill();
+    }
+    uint8_t* p{ buffer + bufferSize - numAvailable };
+    mask[0] = p[0];
+    mask[1] = p[1];
+    mask[2] = p[2];
+    mask[3] = p[3];
+    std::memset( p, 0, 4 ); // Handed out masks do not linger in memory
+    numAvailable -= 4;
+  }
+
+private:
+  static const size_t bufferSize{ 1024 };
+
+  //! Incremented in the child process after every fork().
+  static unsigned numForks;
+  //! Its initialiser registers the pthread_atfork() handler that counts them.
+  static const bool isForkHandlerRegistered;
+
+  void refill();
+
+  uint32_t key[8];
+  uint8_t buffer[bufferSize];
+  size_t numAvailable{ 0 };
+  uint64_t numBytesSinceSeed{ 0 };
+  unsigned forkGeneration;
+  bool isSystemSeeded;
+};
+
+
+/** \brief Writes a fresh mask to \a mask using the calling thread's
+           MaskGenerator.
+
+    The pointer to each thread's generator uses the initial-exec TLS model so
+    that this is only a few instructions. That takes a little of the static
+    TLS block, which is fine when liblbEncoding.so is linked in or loaded at
+    startup. A dlopen() later in a process's life can fail with "cannot
+    allocate memory in static TLS block" if others have used it all, in which
+    case preload the library or raise glibc.rtld.optional_static_tls.
+ */
+void generateMask( uint8_t mask[4] );
+
+/** \brief Sets \a isMasked and a fresh mask in \a header, ready for
+           Header::encode() and encodeMaskedPayload(). */
+void setRandomMask( Header& header );
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETMASK_H
@@ -0,0 +1,226 @@
+#ifndef LB_ENCODING_WEBSOCKETREADER_H
+#define LB_ENCODING_WEBSOCKETREADER_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Requires C++20 coroutines.
+
+#include <lb/encoding/websocket.h>
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief An asynchronous generator of frames, see readFrames().
+
+    Await next() from a coroutine to get each frame in turn:
+
+      auto reader{ readFrames( source, decoder ) };
+      while ( const Frame* frame = co_await reader.next() )
+      {
+        ...
+      }
+      if ( reader.parseError() ) ...
+
+    The \a Frame pointed to is owned by the reader and only valid until the
+    next call to next(). Its payload storage is reused from frame to frame.
+ */
+class FrameReader
+{
+public:
+  struct promise_type;
+  using Handle = std::coroutine_handle<promise_type>;
+
+  // Suspends the reader and resumes whoever awaited next().
+  struct ResumeConsumer
+  {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend( Handle reader ) noexcept
+    {
+      return reader.promise().consumer;
+    }
+    void await_resume() noexcept {}
+  };
+
+  // Records a parse error without suspending.
+  struct ReportParseError
+  {
+    bool await_ready() noexcept { return false; }
+    bool await_suspend( Handle reader ) noexcept
+    {
+      reader.promise().parseError = true;
+      return false;
+    }
+    void await_resume() noexcept {}
+  };
+
+  struct promise_type
+  {
+    const Frame* current{ nullptr };
+    std::coroutine_handle<> consumer;
+    std::exception_ptr exception;
+    bool parseError{ false };
+
+    FrameReader get_return_object() { return FrameReader{ Handle::from_promise( *this ) }; }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    ResumeConsumer final_suspend() noexcept { return {}; }
+    ResumeConsumer yield_value( const Frame& frame ) noexcept
+    {
+      current = &frame;
+      return {};
+    }
+    void return_void() noexcept { current = nullptr; }
+    void unhandled_exception() noexcept
+    {
+      exception = std::current_exception();
+      current = nullptr;
+    }
+  };
+
+  // The awaitable returned by next().
+  struct NextFrame
+  {
+    Handle reader;
+
+    bool await_ready() noexcept { return !reader || reader.done(); }
+    std::coroutine_handle<> await_suspend( std::coroutine_handle<> consumer ) noexcept
+    {
+      reader.promise().consumer = consumer;
+      return reader;
+    }
+    const Frame* await_resume()
+    {
+      if ( !reader || reader.done() )
+      {
+        if ( reader && reader.promise().exception )
+        {
+          std::rethrow_exception( std::exchange( reader.promise().exception, nullptr ) );
+        }
+        return nullptr;
+      }
+      return reader.promise().current;
+    }
+  };
+
+  FrameReader( FrameReader&& other ) noexcept
+    : handle{ std::exchange( other.handle, nullptr ) }
+  {
+  }
+  FrameReader& operator=( FrameReader&& other ) noexcept
+  {
+    std::swap( handle, other.handle );
+    return *this;
+  }
+  FrameReader( const FrameReader& ) = delete;
+  FrameReader& operator=( const FrameReader& ) = delete;
+
+  ~FrameReader()
+  {
+    if ( handle )
+    {
+      handle.destroy();
+    }
+  }
+
+  /** \brief Resumes reading until the next frame.
+      \return An awaitable giving a pointer to the frame, or null at the end
+              of the source or on a parse error.
+   */
+  NextFrame next() { return { handle }; }
+
+  /** \brief Whether reading stopped because of invalid data. */
+  bool parseError() const { return handle && handle.promise().parseError; }
+
+private:
+  explicit FrameReader( Handle handle ) : handle{ handle } {}
+
+  Handle handle;
+};
+
+
+/** \brief Reads frames from \a source as they arrive.
+    \param source Provides read( char* dst, size_t maxBytes ) returning an
+           awaitable that gives the number of bytes read as a size_t, zero
+           at the end of the stream.
+    \param decoder The connection's decoder, used by this reader alone until
+           it ends.
+    \return A FrameReader to await frames from.
+
+    Everything the reader needs, including its read buffer of \a BufferSize
+    bytes, lives in the coroutine frame. That makes one allocation per
+    connection, when this is called, and none per frame.
+
+    The source and decoder must outlive the reader.
+ */
+template< class Source, size_t BufferSize = 16 * 1024 >
+FrameReader readFrames( Source& source, Decoder& decoder )
+{
+  char buffer[ BufferSize ];
+  Frame frame;
+
+  while ( true )
+  {
+    const size_t numRead{ co_await source.read( buffer, BufferSize ) };
+    if ( numRead == 0 )
+    {
+      co_return;
+    }
+
+    const char* p{ buffer };
+    size_t numBytes{ numRead };
+    while ( numBytes > 0 )
+    {
+      switch ( decoder.decodeNext( p, numBytes, frame ) )
+      {
+      case Decoder::Step::eFrame:
+        co_yield frame;
+        break;
+      case Decoder::Step::eNeedMore:
+        break;
+      case Decoder::Step::eParseError:
+        co_await FrameReader::ReportParseError{};
+        co_return;
+      }
+    }
+  }
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETREADER_H
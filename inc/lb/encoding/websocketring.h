@@ -0,0 +1,185 @@
+#ifndef LB_ENCODING_WEBSOCKETRING_H
+#define LB_ENCODING_WEBSOCKETRING_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocket.h>
+
+#include <atomic>
+#include <memory>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Hands decoded frames from one producer thread, typically the one
+           doing the I/O, to one consumer thread without locks.
+
+    There is a fixed number of frame slots and a fixed size arena that the
+    payloads are copied into, both allocated up front. Nothing is allocated
+    per frame and the only copy of a payload is the one from the read buffer
+    into the arena, unmasking it on the way:
+
+      // Producer
+      FrameView view;
+      while ( decoder.decodeNextView( p, numBytes, view ) == Decoder::Step::eFrame )
+      {
+        ring.push( view );
+      }
+
+      // Consumer
+      while ( const FrameRing::Slot* slot = ring.front() )
+      {
+        ...
+        ring.pop();
+      }
+
+    The producer and consumer indices live on separate cache lines, each
+    alongside that side's last sight of the other's index, so the two threads
+    only touch each other's cache line when the ring looks full or empty.
+
+    Payloads are taken from the arena in FIFO order. One that would run off
+    the end of the arena starts again at the beginning instead, which is why
+    only payloads of up to half the arena are guaranteed to fit.
+ */
+class FrameRing
+{
+public:
+  /** \brief A frame in the ring. Owned by the consumer from front() until
+             pop().
+   */
+  struct alignas( 64 ) Slot
+  {
+    //! As decoded. The payload below is unmasked even if header.isMasked.
+    Header header;
+    char* payload{ nullptr };
+    std::chrono::steady_clock::time_point firstByteTime;
+
+  private:
+    friend class FrameRing;
+
+    // Arena position one past this slot's payload.
+    uint64_t arenaEnd{ 0 };
+  };
+
+  /**
+      \brief Construct a FrameRing.
+      \param numSlots The maximum number of frames in the ring at once. Must
+             be a power of two.
+      \param arenaSize The number of bytes of payload storage.
+
+      Throws std::invalid_argument if either parameter is unusable.
+   */
+  FrameRing( size_t numSlots, size_t arenaSize );
+
+  // Shared between threads so neither copyable nor movable.
+  FrameRing( const FrameRing& ) = delete;
+  FrameRing& operator=( const FrameRing& ) = delete;
+
+  size_t numSlots() const { return slotMask + 1; }
+
+  /** \brief The largest payload guaranteed to fit once the ring drains. */
+  size_t maxPayloadSize() const { return arenaSize / 2; }
+
+  /** \brief Producer only. Copies a frame into the ring.
+      \param view The frame, typically from Decoder::decodeNextView. A masked
+             payload is unmasked as it is copied.
+      \return False, with nothing copied, if there is no free slot or not
+              enough free arena. The view stays valid until the next call to
+              the \a Decoder so it can simply be retried.
+   */
+  bool tryPush( const FrameView& view );
+
+  /** \brief Producer only. As tryPush() but yields until there is room.
+
+      Throws std::length_error if the payload is bigger than maxPayloadSize()
+      since it might never fit.
+   */
+  void push( const FrameView& view );
+
+  /** \brief Consumer only. The oldest frame, or null if the ring is empty. */
+  const Slot* front()
+  {
+    const uint64_t index{ consumer.readIndex.load( std::memory_order_relaxed ) };
+    if ( index == consumer.cachedWriteIndex )
+    {
+      consumer.cachedWriteIndex = producer.writeIndex.load( std::memory_order_acquire );
+      if ( index == consumer.cachedWriteIndex )
+      {
+        return nullptr;
+      }
+    }
+    return &slots[ index & slotMask ];
+  }
+
+  /** \brief Consumer only. Releases the frame from front(), and its payload,
+             back to the producer. The ring must not be empty.
+   */
+  void pop()
+  {
+    const uint64_t index{ consumer.readIndex.load( std::memory_order_relaxed ) };
+    consumer.arenaReleased.store( slots[ index & slotMask ].arenaEnd, std::memory_order_release );
+    consumer.readIndex.store( index + 1, std::memory_order_release );
+  }
+
+private:
+  Slot* claim( size_t numPayloadBytes );
+
+  const size_t slotMask;
+  const size_t arenaSize;
+  std::unique_ptr<Slot[]> slots;
+  std::unique_ptr<char[]> arena;
+
+  // Indices and arena positions only ever increase, wrapping is done when
+  // they are used.
+  struct alignas( 64 ) Producer
+  {
+    std::atomic<uint64_t> writeIndex{ 0 };
+    uint64_t arenaWritten{ 0 };
+    uint64_t cachedReadIndex{ 0 };
+    uint64_t cachedArenaReleased{ 0 };
+  } producer;
+
+  struct alignas( 64 ) Consumer
+  {
+    std::atomic<uint64_t> readIndex{ 0 };
+    std::atomic<uint64_t> arenaReleased{ 0 };
+    uint64_t cachedWriteIndex{ 0 };
+  } consumer;
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETRING_H
@@ -0,0 +1,131 @@
+#ifndef LB_ENCODING_WEBSOCKETSENDFILE_H
+#define LB_ENCODING_WEBSOCKETSENDFILE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocket.h>
+
+#include <sys/types.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief Sends the contents of a file as one or more unmasked WebSocket
+           frames using sendfile(2) for the payload bytes.
+
+    Intended for the server role where frames are not masked, which means the
+    payload bytes go on the wire exactly as they are stored in the file. The
+    kernel can therefore move them straight from the page cache to the socket
+    without ever copying them into user space.
+
+    The payload is split into frames of at most \a maxFramePayloadSize bytes.
+    The first frame carries the requested op code, subsequent frames are
+    continuation frames and the final frame has the FIN bit set. An empty file
+    results in a single empty frame.
+
+    Works with both blocking and non-blocking sockets. With a non-blocking
+    socket send() may return Status::eWouldBlock, in which case simply call it
+    again once the socket is writable. All progress, including a partially
+    written header, is retained between calls.
+
+    The file descriptor is not owned, it must remain open until the transfer
+    is complete. The file must contain at least \a numBytes bytes from
+    \a offset onwards.
+ */
+class FileSender
+{
+public:
+  static const size_t defaultMaxFramePayloadSize{ 1 << 20 };
+
+  /**
+      \brief Construct a FileSender. No I/O takes place until send() is called.
+      \param fileFd The file to send the payload bytes from.
+      \param offset The offset in the file of the first payload byte.
+      \param numBytes The total number of payload bytes across all frames.
+      \param opCode The op code of the first frame, typically binary.
+      \param maxFramePayloadSize The maximum payload size of each frame. Must
+             be non-zero.
+   */
+  FileSender( int fileFd
+            , off_t offset
+            , uint64_t numBytes
+            , Header::OpCode opCode = Header::OpCode::eBinary
+            , size_t maxFramePayloadSize = defaultMaxFramePayloadSize );
+
+  enum class Status
+  {
+    eComplete,   //!< All frames have been written to the socket.
+    eWouldBlock, //!< Non-blocking socket is full, call send() again later.
+    eError       //!< Check errno for the reason.
+  };
+  static std::string toString( Status );
+
+  /**
+      \brief Writes as many header and payload bytes to \a socketFd as possible.
+      \param socketFd The socket to write the frames to.
+      \return eComplete once everything is written, otherwise see Status.
+
+      Calling again after eComplete is harmless and simply returns eComplete.
+
+      If the file turns out to be shorter than promised eError is returned and
+      errno is set to ENODATA.
+   */
+  Status send( int socketFd );
+
+  /** \brief The number of payload bytes yet to be written to the socket. */
+  uint64_t numBytesRemaining() const { return numPayloadBytesRemaining; }
+
+private:
+  void startNextFrame();
+
+  int fileFd;
+  off_t offset;
+  uint64_t numPayloadBytesRemaining;
+  Header::OpCode opCode;
+  size_t maxFramePayloadSize;
+
+  // The current frame.
+  char headerBytes[ Header::maxSizeInBytes ];
+  uint8_t numHeaderBytes{ 0 };
+  uint8_t numHeaderBytesSent{ 0 };
+  uint64_t numFrameBytesRemaining{ 0 };
+  bool isFirstFrame{ true };
+  bool isFinalFrame{ false };
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETSENDFILE_H
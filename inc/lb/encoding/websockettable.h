@@ -0,0 +1,228 @@
+#ifndef LB_ENCODING_WEBSOCKETTABLE_H
+#define LB_ENCODING_WEBSOCKETTABLE_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <lb/encoding/websocket.h>
+
+#include <array>
+#include <vector>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+/** \brief The decoding state of many connections, stored column by column.
+
+    An alternative to one \a Decoder per connection for servers with a very
+    large number of connections. Each \a Decoder is a separate heap
+    allocation, plus its cache, so a pass over every connection touches a
+    cache line or two, and often a page, per connection. Here each piece of
+    state is held in its own array indexed by connection id, so a pass such
+    as forEachPending() that only needs to know which connections are part
+    way through a frame reads one byte per connection, contiguously.
+
+    Cached payload bytes of frames spanning reads live in buffers from a pool
+    shared by the whole table and are only held while a frame is pending.
+
+    Decoding behaves as for \a Decoder except that \a Decoder::Stats and first
+    byte times are not maintained.
+
+    Not thread safe. Different tables can of course be used on different
+    threads.
+ */
+class DecoderTable
+{
+public:
+  using Id = uint32_t;
+
+  /**
+      \brief Construct a DecoderTable.
+      \param numConnectionsReserved Room for this many connections up front.
+   */
+  DecoderTable( size_t numConnectionsReserved = 0 );
+
+  // Default move construction and move assignment. Copy forbidden.
+  DecoderTable( DecoderTable&& ) = default;
+  DecoderTable& operator=( DecoderTable&& ) = default;
+  DecoderTable( const DecoderTable& ) = delete;
+  DecoderTable& operator=( const DecoderTable& ) = delete;
+
+  /** \brief Adds a connection, reusing the id of a removed one if possible. */
+  Id add();
+
+  /** \brief Removes a connection, dropping any partial frame. */
+  void remove( Id );
+
+  /** \brief The number of connections. */
+  size_t size() const { return numConnections; }
+
+  /** \brief One past the highest id in use. */
+  size_t idLimit() const { return states.size(); }
+
+  /** \brief As Decoder::decodeNextView, for connection \a id.
+
+      A payload completed from the table's cache is valid until the next call
+      to any method of the table.
+
+      An \a id that was removed, or never added, is a bug in the caller. It
+      asserts in debug builds and gives Decoder::Step::eParseError otherwise.
+   */
+  Decoder::Step decodeNextView( Id id, const char*& src, size_t& numSrcBytes, FrameView& view );
+
+  /** \brief As Decoder::decode, for connection \a id.
+
+      Result::numExtra is the number of bytes cached for the pending frame.
+      An \a id not in use is treated as for decodeNextView().
+   */
+  Decoder::Result decode( Id id, const char* src, size_t numSrcBytes );
+
+  struct Job
+  {
+    Id id;
+    const char* src;
+    size_t numSrcBytes;
+  };
+
+  /** \brief Decodes each job in turn.
+      \param results Resized to match \a jobs, results[i] being for jobs[i].
+   */
+  void decode( const std::vector<Job>& jobs, std::vector<Decoder::Result>& results );
+
+  /** \brief Whether connection \a id is part way through a frame. */
+  bool hasPartialFrame( Id id ) const { return states[ id ] >= uint8_t( State::ePartialHeader ); }
+
+  /** \brief The number of bytes cached for connection \a id's pending frame. */
+  size_t numCachedBytes( Id id ) const;
+
+  /** \brief Calls \a f with the id of each connection part way through a
+             frame, in id order.
+   */
+  template< class F >
+  void forEachPending( F&& f ) const
+  {
+    const size_t limit{ states.size() };
+    for ( size_t id = 0; id < limit; ++id )
+    {
+      if ( states[ id ] >= uint8_t( State::ePartialHeader ) )
+      {
+        f( Id( id ) );
+      }
+    }
+  }
+
+  /** \brief Drops the partial frame, if any, of each of \a ids. */
+  void reset( Id id );
+  void reset( const std::vector<Id>& ids );
+
+  /** \brief Renumbers connections so that ids run from zero to size() - 1
+             and frees memory no longer needed.
+      \param onMove Called as onMove( oldId, newId ) for each connection
+             whose id changes, to let the caller update its own records.
+
+      Worth doing after a large number of connections have gone.
+   */
+  template< class F >
+  void compact( F&& onMove )
+  {
+    size_t to{ 0 };
+    size_t from{ states.size() };
+    while ( true )
+    {
+      while ( to < from && states[ to ] != uint8_t( State::eFree ) )
+      {
+        ++to;
+      }
+      while ( from > to && states[ from - 1 ] == uint8_t( State::eFree ) )
+      {
+        --from;
+      }
+      if ( to + 1 >= from )
+      {
+        break;
+      }
+      --from;
+      move( Id( from ), Id( to ) );
+      onMove( Id( from ), Id( to ) );
+    }
+    shrink();
+  }
+
+  /** \brief The number of bytes of heap memory the table holds. */
+  size_t memoryUsage() const;
+
+private:
+  enum class State : uint8_t
+  {
+    eFree,
+    eNothing,
+    ePartialHeader,
+    ePartialPayload
+  };
+
+  static constexpr uint32_t noBuffer{ UINT32_MAX };
+
+  Header loadHeader( Id id ) const;
+  void storeHeader( Id id, const Header& header );
+  void move( Id from, Id to );
+  void shrink();
+  uint32_t acquireBuffer();
+  void releaseBuffer( uint32_t buffer );
+
+  size_t numConnections{ 0 };
+  std::vector<Id> freeIds;
+
+  // The columns, indexed by connection id.
+  std::vector<uint8_t> states;
+  std::vector<uint8_t> numHeaderBytes;
+  std::vector<std::array<char, Header::maxSizeInBytes>> headerBytes;
+  std::vector<uint8_t> headerFlags;
+  std::vector<uint8_t> opCodes;
+  std::vector<uint64_t> payloadSizes;
+  std::vector<std::array<uint8_t, 4>> masks;
+  std::vector<uint32_t> payloadBuffers;
+
+  // Cached payloads, referred to by index from payloadBuffers.
+  std::vector<std::vector<char>> bufferPool;
+  std::vector<uint32_t> freeBuffers;
+
+  // Holding a payload handed out by decodeNextView().
+  uint32_t spentBuffer{ noBuffer };
+};
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_WEBSOCKETTABLE_H
@@ -17,8 +17,14 @@
 */
 
 #include <lb/encoding/base64.h>
+#include <lb/encoding/base64inline.h>
 
-#include <memory>
+#include "base64kernels.h"
+#include "dispatcher.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
 
 
 namespace lb
@@ -33,111 +39,364 @@ namespace base64
 {
 
 
-/** \brief A lookup array for the 64 base64 characters. */
-const char base64Lookup[ 65 ]
+// The dispatched functions' names for each alphabet the library supports,
+// whatever its padding.
+template< char c62, char c63 >
+struct Names;
+
+template<>
+struct Names<'+', '/'>
 {
-  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+  static constexpr const char* encode{ "base64::encode" };
+  static constexpr const char* decode{ "base64::decode" };
 };
 
-/**
-    \brief Converts 3 bytes of data to 4 bytes of base64 encoded data.
-    \param src The source bytes as an unsigned type to ensure bit shifting
-               yields zeros. Assumes 3 contiguous bytes can be accessed.
-    \param dst The destination buffer. Assumes that 4 contiguous bytes can be
-               written to.
+template<>
+struct Names<'-', '_'>
+{
+  static constexpr const char* encode{ "base64url::encode" };
+  static constexpr const char* decode{ "base64url::decode" };
+};
 
-    Endian-agnostic.
- */
-void encodeTriplet( const unsigned char* src, char* dst )
+
+// The baseline kernel, the scalar code for every whole triplet.
+template< char c62, char c63 >
+size_t encodeBlocks( const char* src, size_t numSrcChars, char* dst )
 {
-  dst[0] = base64Lookup[ (unsigned char)(   *src >> 2 ) ];
-  dst[1] = base64Lookup[ (unsigned char)( ( ( *src << 4 ) & 0x30 ) | ( *(src+1) >> 4 ) ) ];
-  dst[2] = base64Lookup[ (unsigned char)( ( ( *(src+1) << 2 ) & 0x3F ) | ( *(src+2) >> 6 ) ) ];
-  dst[3] = base64Lookup[ (unsigned char)( ( *(src+2) & 0x3F ) ) ];
+  const size_t numBlockChars{ numSrcChars - numSrcChars % 3 };
+  inlined::encode<Alphabet<c62, c63, true>>( src, numBlockChars, dst );
+  return numBlockChars;
 }
 
-/**
-    \brief Converts 1 byte of data to 4 bytes of base64 encoded data. The final
-           2 destination bytes are padding bytes i.e. "==".
-    \param src The source bytes as an unsigned type to ensure bit shifting
-               yields zeros. Assumes 3 contiguous bytes can be accessed.
-    \param dst The destination buffer. Assumes that 4 contiguous bytes can be
-               written to.
 
-    Endian-agnostic.
- */
-void encodeDoublet( const unsigned char* src, char* dst )
+namespace
 {
-  dst[0] = base64Lookup[ (unsigned char)(   *src >> 2 ) ];
-  dst[1] = base64Lookup[ (unsigned char)( ( ( *src << 4 ) & 0x30 ) | ( *(src+1) >> 4 ) ) ];
-  dst[2] = base64Lookup[ (unsigned char)( ( *(src+1) << 2 ) & 0x3F ) ];
-  dst[3] = '=';
+
+
+// The widest kernel the active tier allows. Probes report the number of bytes
+// each kernel encodes per iteration.
+template< char c62, char c63 >
+constinit dispatch::Dispatcher encodeKernels
+{ Names<c62, c63>::encode
+, std::array
+  { dispatch::Candidate<EncodeFunction>{ dispatch::Tier::eBaseline, "baseline", 3, encodeBlocks<c62, c63> }
+#if defined( __x86_64__ ) || defined( __i386__ )
+  , dispatch::Candidate<EncodeFunction>{ dispatch::Tier::eAvx2, "avx2", 24, encodeBlocksAvx2<c62, c63> }
+  , dispatch::Candidate<EncodeFunction>{ dispatch::Tier::eAvx512Vbmi, "avx512vbmi", 48, encodeBlocksAvx512Vbmi<c62, c63> }
+#endif
+  }
+};
+dispatch::SelectAtLoad encodeKernelsAtLoad{ encodeKernels<'+', '/'> };
+dispatch::SelectAtLoad urlEncodeKernelsAtLoad{ encodeKernels<'-', '_'> };
+
+
+} // End of anonymous namespace
+
+
+template< class Alphabet >
+void encode( const char* src, size_t numSrcChars, char* dst )
+{
+  // The kernel does what it can, the scalar code the remainder and padding.
+  const auto& kernel{ encodeKernels<Alphabet::char62, Alphabet::char63>.get() };
+  const size_t numEncoded{ kernel.function( src, numSrcChars, dst ) };
+  inlined::encode<Alphabet>( src + numEncoded, numSrcChars - numEncoded, dst + 4 * ( numEncoded / 3 ) );
 }
 
-/**
-    \brief Converts 2 bytes of data to 4 bytes of base64 encoded data. The final
-           destination byte is a padding byte i.e. '='.
-    \param src The source bytes as an unsigned type to ensure bit shifting
-               yields zeros. Assumes 3 contiguous bytes can be accessed.
-    \param dst The destination buffer. Assumes that 4 contiguous bytes can be
-               written to.
+template< class Alphabet >
+std::string encode( const std::string& src )
+{
+  if ( src.empty() )
+  {
+    return {};
+  }
 
-    Endian-agnostic.
- */
-void encodeSinglet( const unsigned char* src, char* dst )
+  const size_t requiredStorage{ encodedSize<Alphabet>( src.size() ) };
+
+  std::string dst( requiredStorage, '\0' );
+
+  encode<Alphabet>( src.c_str(), src.size(), dst.data() );
+
+  return dst;
+}
+
+
+
+std::string DecodeResult::toString( Status status )
 {
-  dst[0] = base64Lookup[ (unsigned char)(   *src >> 2 ) ];
-  dst[1] = base64Lookup[ (unsigned char)( ( *src << 4 ) & 0x30 ) ];
-  dst[2] = '=';
-  dst[3] = '=';
+  switch( status )
+  {
+  case Status::eSuccess:
+    return "Success";
+  case Status::eInvalidCharacter:
+    return "InvalidCharacter";
+  case Status::eInvalidPadding:
+    return "InvalidPadding";
+  case Status::eInvalidLength:
+    return "InvalidLength";
+  }
+  return "Unknown";
 }
 
-void encode( const char* src, size_t numSrcChars, char* dst )
+
+namespace
 {
-  const size_t extra{ numSrcChars % 3 };
-  const size_t numTriplets{ ( numSrcChars - extra ) / 3 };
 
-  unsigned char* usrc{ (unsigned char*)src };
 
-  for ( size_t i = 0; i < numTriplets; ++i, usrc += 3, dst += 4 )
+//! Marks the characters outside the alphabet in decodeLookup.
+const uint8_t invalid{ 0xFF };
+
+constexpr std::array<uint8_t, 256> makeDecodeLookup( const char* alphabet )
+{
+  std::array<uint8_t, 256> lookup{};
+  lookup.fill( invalid );
+  for ( uint8_t value = 0; value < 64; ++value )
   {
-    encodeTriplet( usrc, dst );
+    lookup[ (unsigned char)alphabet[ value ] ] = value;
   }
+  return lookup;
+}
+
+/** \brief The 6-bit value of each base64 character, invalid for the rest. */
+template< char c62, char c63 >
+constexpr std::array<uint8_t, 256> decodeLookup{ makeDecodeLookup( Alphabet<c62, c63, true>::lookup ) };
+
+template< char c62, char c63 >
+bool isValid( char c )
+{
+  return decodeLookup<c62, c63>[ (unsigned char)c ] != invalid;
+}
+
+// '=' is at least a base64 character, just in the wrong place.
+DecodeResult::Status invalidStatus( char c )
+{
+  return c == '=' ? DecodeResult::Status::eInvalidPadding
+                  : DecodeResult::Status::eInvalidCharacter;
+}
+
+
+} // End of anonymous namespace
 
-  switch( extra )
+
+// The baseline kernel. Decodes whole quartets up to the first holding a
+// character outside the alphabet, '=' included.
+template< char c62, char c63 >
+size_t decodeBlocks( const char* src, size_t numSrcChars, char* dst )
+{
+  const unsigned char* usrc{ (const unsigned char*)src };
+
+  size_t numDecoded{ 0 };
+  for ( ; numDecoded + 4 <= numSrcChars; numDecoded += 4, usrc += 4, dst += 3 )
   {
-  case 0:
-    break;
-  case 1:
-    encodeSinglet( usrc, dst );
-    break;
-  case 2:
-    encodeDoublet( usrc, dst );
-    break;
-  default: // Impossible
-    break;
+    const uint32_t a{ decodeLookup<c62, c63>[ usrc[0] ] };
+    const uint32_t b{ decodeLookup<c62, c63>[ usrc[1] ] };
+    const uint32_t c{ decodeLookup<c62, c63>[ usrc[2] ] };
+    const uint32_t d{ decodeLookup<c62, c63>[ usrc[3] ] };
+    if ( ( a | b | c | d ) & 0x80 )
+    {
+      break;
+    }
+
+    const uint32_t bits{ a << 18 | b << 12 | c << 6 | d };
+    dst[0] = char( bits >> 16 );
+    dst[1] = char( bits >>  8 );
+    dst[2] = char( bits );
   }
+
+  return numDecoded;
 }
 
-std::string encode( const std::string& src )
+
+namespace
 {
-  if ( src.empty() )
+
+
+// The widest kernel the active tier allows. Probes report the number of
+// characters each kernel decodes per iteration.
+template< char c62, char c63 >
+constinit dispatch::Dispatcher decodeKernels
+{ Names<c62, c63>::decode
+, std::array
+  { dispatch::Candidate<DecodeFunction>{ dispatch::Tier::eBaseline, "baseline", 4, decodeBlocks<c62, c63> }
+#if defined( __x86_64__ ) || defined( __i386__ )
+  , dispatch::Candidate<DecodeFunction>{ dispatch::Tier::eSse41, "sse4.1", 32, decodeBlocksSse41<c62, c63> }
+  , dispatch::Candidate<DecodeFunction>{ dispatch::Tier::eAvx2, "avx2", 32, decodeBlocksAvx2<c62, c63> }
+#endif
+  }
+};
+dispatch::SelectAtLoad decodeKernelsAtLoad{ decodeKernels<'+', '/'> };
+dispatch::SelectAtLoad urlDecodeKernelsAtLoad{ decodeKernels<'-', '_'> };
+
+/** \brief Decodes what follows the whole quartets, normally the final
+           quartet with any padding, or without it the final 2 to 4
+           characters.
+    \param position Where in \a src the final characters start.
+    \param dst Where their decoding goes.
+ */
+template< class Alphabet >
+DecodeResult decodeFinal( const char* src
+                        , size_t numSrcChars
+                        , size_t position
+                        , char* dst )
+{
+  const auto& lookup{ decodeLookup<Alphabet::char62, Alphabet::char63> };
+
+  const size_t numDstBytes{ position / 4 * 3 };
+  const size_t numFinalChars{ numSrcChars - position };
+
+  // The characters before any padding, most significant first.
+  size_t numChars{ 0 };
+  uint32_t bits{ 0 };
+  for ( ; numChars < numFinalChars; ++numChars )
+  {
+    const uint8_t value{ lookup[ (unsigned char)src[ position + numChars ] ] };
+    if ( value == invalid )
+    {
+      break;
+    }
+    bits |= uint32_t( value ) << ( 18 - 6 * numChars );
+  }
+
+  if ( numChars < numFinalChars )
+  {
+    const size_t padding{ position + numChars };
+    if ( !Alphabet::isPadded || src[ padding ] != '=' )
+    {
+      return { invalidStatus( src[ padding ] ), numDstBytes, padding };
+    }
+
+    // One or two '=' after at least two characters, and nothing after them.
+    if ( numChars < 2 )
+    {
+      return { DecodeResult::Status::eInvalidPadding, numDstBytes, padding };
+    }
+    for ( size_t i = padding + 1; i < numSrcChars; ++i )
+    {
+      if ( src[i] != '=' )
+      {
+        return { isValid<Alphabet::char62, Alphabet::char63>( src[i] ) ? DecodeResult::Status::eInvalidPadding
+                                                                       : DecodeResult::Status::eInvalidCharacter
+               , numDstBytes
+               , i };
+      }
+    }
+  }
+
+  // Without padding only a lone final character is too short.
+  if ( Alphabet::isPadded ? numFinalChars % 4 != 0 : numFinalChars % 4 == 1 )
+  {
+    return { DecodeResult::Status::eInvalidLength, numDstBytes, numSrcChars };
+  }
+
+  // A partial quartet leaves some bits of the last character unused, they
+  // must be zero.
+  const uint32_t unusedBits{ numChars == 2 ? 0x0000F000U
+                           : numChars == 3 ? 0x000000C0U
+                           : 0U };
+  if ( bits & unusedBits )
+  {
+    return { DecodeResult::Status::eInvalidPadding, numDstBytes, position + numChars - 1 };
+  }
+
+  const size_t numBytes{ numChars > 0 ? numChars - 1 : 0 };
+  for ( size_t i = 0; i < numBytes; ++i )
+  {
+    dst[i] = char( bits >> ( 16 - 8 * i ) );
+  }
+
+  return { DecodeResult::Status::eSuccess, numDstBytes + numBytes, 0 };
+}
+
+
+} // End of anonymous namespace
+
+
+template< class Alphabet >
+DecodeResult decode( const char* src, size_t numSrcChars, char* dst )
+{
+  constexpr char c62{ Alphabet::char62 };
+  constexpr char c63{ Alphabet::char63 };
+
+  // The final quartet, or whatever is left over, may hold padding so is
+  // never given to the kernels.
+  const size_t numFinalChars{ numSrcChars % 4 == 0 ? std::min<size_t>( numSrcChars, 4 )
+                                                   : numSrcChars % 4 };
+  const size_t numBodyChars{ numSrcChars - numFinalChars };
+
+  // A kernel stops short of any block with a character outside the alphabet
+  // in it, the scalar code then finds exactly where.
+  size_t numDecoded{ decodeKernels<c62, c63>.get().function( src, numBodyChars, dst ) };
+  numDecoded += decodeBlocks<c62, c63>( src + numDecoded
+                                      , numBodyChars - numDecoded
+                                      , dst + numDecoded / 4 * 3 );
+  if ( numDecoded < numBodyChars )
+  {
+    size_t position{ numDecoded };
+    while ( isValid<c62, c63>( src[ position ] ) )
+    {
+      ++position;
+    }
+    return { invalidStatus( src[ position ] ), numDecoded / 4 * 3, position };
+  }
+
+  return decodeFinal<Alphabet>( src, numSrcChars, numBodyChars, dst + numBodyChars / 4 * 3 );
+}
+
+template< class Alphabet >
+std::optional<std::string> decode( const std::string& src )
+{
+  std::string dst( 3 * src.size() / 4, '\0' );
+
+  const DecodeResult result{ decode<Alphabet>( src.data(), src.size(), dst.data() ) };
+  if ( result.status != DecodeResult::Status::eSuccess )
   {
     return {};
   }
 
-  const size_t requiredStorage{ 4 * ( (src.size()-1)/3 + 1) };
+  dst.resize( result.numDstBytes );
+  return dst;
+}
+
+
+template void encode<Standard>( const char*, size_t, char* );
+template void encode<StandardUnpadded>( const char*, size_t, char* );
+template void encode<Url>( const char*, size_t, char* );
+template void encode<UrlUnpadded>( const char*, size_t, char* );
 
-  std::unique_ptr<char[]> dst{ std::make_unique<char[]>( requiredStorage ) };
+template std::string encode<Standard>( const std::string& );
+template std::string encode<StandardUnpadded>( const std::string& );
+template std::string encode<Url>( const std::string& );
+template std::string encode<UrlUnpadded>( const std::string& );
 
-  encode( src.c_str(), src.size(), dst.get() );
+template DecodeResult decode<Standard>( const char*, size_t, char* );
+template DecodeResult decode<StandardUnpadded>( const char*, size_t, char* );
+template DecodeResult decode<Url>( const char*, size_t, char* );
+template DecodeResult decode<UrlUnpadded>( const char*, size_t, char* );
 
-  // std::string always takes a copy. Understandable, but unfortunate here. If
-  // only there was some sort of move semantics for passing C-style string
-  // ownership to std::string.
-  return { dst.get(), requiredStorage };
+template std::optional<std::string> decode<Standard>( const std::string& );
+template std::optional<std::string> decode<StandardUnpadded>( const std::string& );
+template std::optional<std::string> decode<Url>( const std::string& );
+template std::optional<std::string> decode<UrlUnpadded>( const std::string& );
+
+
+void encode( const char* src, size_t numSrcChars, char* dst )
+{
+  encode<Standard>( src, numSrcChars, dst );
 }
 
+std::string encode( const std::string& src )
+{
+  return encode<Standard>( src );
+}
+
+DecodeResult decode( const char* src, size_t numSrcChars, char* dst )
+{
+  return decode<Standard>( src, numSrcChars, dst );
+}
+
+std::optional<std::string> decode( const std::string& src )
+{
+  return decode<Standard>( src );
+}
 
 } // End of namespace base64
 
@@ -0,0 +1,195 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compiled with the AVX2 flags, see the Makefile. Only ever called once
+// base64::encode or base64::decode has checked the CPU supports AVX2.
+
+#include "base64kernels.h"
+
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+#include <immintrin.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+/** \brief Encodes 24 bytes to 32 characters per iteration.
+
+    Each 128-bit lane takes 12 input bytes, four groups of three, and
+    rearranges them so that each 32-bit word holds one group's four 6-bit
+    indices, split out with a multiply-shift. The indices become characters
+    by adding an offset that depends only on which range of the alphabet they
+    fall in, with a 16 entry shuffle for the few offsets there are. See
+    Wojciech Muła and Daniel Lemire, "Faster Base64 Encoding and Decoding
+    Using AVX2 Instructions".
+
+    Each iteration reads 28 bytes, the second lane's load overlapping the
+    first's, so the loop stops while that many remain.
+ */
+template< char c62, char c63 >
+size_t encodeBlocksAvx2( const char* src, size_t numSrcChars, char* dst )
+{
+  // The bytes of group k, b0 b1 b2, as b1 b0 b2 b1 in each 32-bit word.
+  const __m256i regroup{ _mm256_setr_epi8( 1, 0, 2, 1,  4,  3,  5,  4
+                                         , 7, 6, 8, 7, 10,  9, 11, 10
+                                         , 1, 0, 2, 1,  4,  3,  5,  4
+                                         , 7, 6, 8, 7, 10,  9, 11, 10 ) };
+
+  // The offset taking an index to its character, looked up by a shuffle on
+  // the index's range: 13 for 'A'..'Z', 0 for 'a'..'z', 1 - 10 for the
+  // digits, 11 for c62 and 12 for c63.
+  const __m256i offsets{ _mm256_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52
+                                         , '0' - 52, '0' - 52, '0' - 52, '0' - 52
+                                         , '0' - 52, '0' - 52, '0' - 52, c62 - 62
+                                         , c63 - 63, 'A', 0, 0
+                                         , 'a' - 26, '0' - 52, '0' - 52, '0' - 52
+                                         , '0' - 52, '0' - 52, '0' - 52, '0' - 52
+                                         , '0' - 52, '0' - 52, '0' - 52, c62 - 62
+                                         , c63 - 63, 'A', 0, 0 ) };
+
+  size_t numEncoded{ 0 };
+  for ( ; numEncoded + 28 <= numSrcChars; numEncoded += 24, dst += 32 )
+  {
+    const char* p{ src + numEncoded };
+    const __m128i low{ _mm_loadu_si128( (const __m128i*)p ) };
+    const __m128i high{ _mm_loadu_si128( (const __m128i*)( p + 12 ) ) };
+    const __m256i in{ _mm256_shuffle_epi8( _mm256_inserti128_si256( _mm256_castsi128_si256( low ), high, 1 )
+                                         , regroup ) };
+
+    // Indices 0 and 2 of each word shifted down into place by the high
+    // half of a multiply, 1 and 3 shifted up by the low half.
+    const __m256i first{ _mm256_mulhi_epu16( _mm256_and_si256( in, _mm256_set1_epi32( 0x0FC0FC00 ) )
+                                           , _mm256_set1_epi32( 0x04000040 ) ) };
+    const __m256i second{ _mm256_mullo_epi16( _mm256_and_si256( in, _mm256_set1_epi32( 0x003F03F0 ) )
+                                            , _mm256_set1_epi32( 0x01000010 ) ) };
+    const __m256i indices{ _mm256_or_si256( first, second ) };
+
+    __m256i range{ _mm256_subs_epu8( indices, _mm256_set1_epi8( 51 ) ) };
+    const __m256i isUpper{ _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), indices ) };
+    range = _mm256_or_si256( range, _mm256_and_si256( isUpper, _mm256_set1_epi8( 13 ) ) );
+
+    const __m256i chars{ _mm256_add_epi8( indices, _mm256_shuffle_epi8( offsets, range ) ) };
+    _mm256_storeu_si256( (__m256i*)dst, chars );
+  }
+
+  return numEncoded;
+}
+
+template size_t encodeBlocksAvx2<'+', '/'>( const char*, size_t, char* );
+template size_t encodeBlocksAvx2<'-', '_'>( const char*, size_t, char* );
+
+
+namespace
+{
+
+
+// As translate() in base64sse41.cpp, 32 characters at a time.
+template< char c62, char c63 >
+bool translate( __m256i& chars )
+{
+  static constexpr DecodeTables tables{ makeDecodeTables( c62, c63 ) };
+
+  const __m256i validLow{ _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i*)tables.validLow ) ) };
+  const __m256i validHigh{ _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i*)tables.validHigh ) ) };
+  const __m256i offsets{ _mm256_broadcastsi128_si256( _mm_loadu_si128( (const __m128i*)tables.offsets ) ) };
+
+  const __m256i nibble{ _mm256_set1_epi8( 0x2F ) };
+  const __m256i highNibbles{ _mm256_and_si256( _mm256_srli_epi32( chars, 4 ), nibble ) };
+  const __m256i lowNibbles{ _mm256_and_si256( chars, nibble ) };
+  if ( !_mm256_testz_si256( _mm256_shuffle_epi8( validLow, lowNibbles )
+                          , _mm256_shuffle_epi8( validHigh, highNibbles ) ) )
+  {
+    return false;
+  }
+
+  __m256i indices{ highNibbles };
+  if constexpr ( tables.shift62 != 0 )
+  {
+    const __m256i is62{ _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( c62 ) ) };
+    indices = _mm256_add_epi8( indices, _mm256_and_si256( is62, _mm256_set1_epi8( tables.shift62 ) ) );
+  }
+  if constexpr ( tables.shift63 != 0 )
+  {
+    const __m256i is63{ _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( c63 ) ) };
+    indices = _mm256_add_epi8( indices, _mm256_and_si256( is63, _mm256_set1_epi8( tables.shift63 ) ) );
+  }
+  chars = _mm256_add_epi8( chars, _mm256_shuffle_epi8( offsets, indices ) );
+  return true;
+}
+
+// Packs 32 6-bit values into 24 bytes at the bottom of the register.
+__m256i pack( __m256i values )
+{
+  const __m256i pairs{ _mm256_maddubs_epi16( values, _mm256_set1_epi32( 0x01400140 ) ) };
+  const __m256i quartets{ _mm256_madd_epi16( pairs, _mm256_set1_epi32( 0x00011000 ) ) };
+  const __m256i lanes{ _mm256_shuffle_epi8( quartets
+                                          , _mm256_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+                                                            , 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) ) };
+  return _mm256_permutevar8x32_epi32( lanes, _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 3, 7 ) );
+}
+
+
+} // End of anonymous namespace
+
+
+/** \brief Validates and decodes 32 characters to 24 bytes per iteration.
+
+    Each iteration stores 32 bytes of which 24 are wanted, so the loop stops
+    while there is room for that.
+ */
+template< char c62, char c63 >
+size_t decodeBlocksAvx2( const char* src, size_t numSrcChars, char* dst )
+{
+  size_t numDecoded{ 0 };
+  for ( ; numDecoded + 44 <= numSrcChars; numDecoded += 32, dst += 24 )
+  {
+    __m256i chars{ _mm256_loadu_si256( (const __m256i*)( src + numDecoded ) ) };
+    if ( !translate<c62, c63>( chars ) )
+    {
+      break;
+    }
+    _mm256_storeu_si256( (__m256i*)dst, pack( chars ) );
+  }
+
+  return numDecoded;
+}
+
+template size_t decodeBlocksAvx2<'+', '/'>( const char*, size_t, char* );
+template size_t decodeBlocksAvx2<'-', '_'>( const char*, size_t, char* );
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef LB_ENCODING_BASE64KERNELS_H
+#define LB_ENCODING_BASE64KERNELS_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. The base64 kernels for wider instruction
+// sets than the baseline, each in a translation unit of its own compiled with
+// the flags for that instruction set (see the Makefile).
+//
+// Those translation units must not use any inline function with external
+// linkage, which includes everything in base64inline.h and most of the
+// standard library. The linker keeps just one copy of such a function and it
+// could be the one compiled for the wider instruction set. That is why the
+// kernels only do whole blocks and leave the rest to the caller, and why any
+// helpers they have go in an anonymous namespace.
+//
+// The kernels are templates on the characters for 62 and 63, the only part
+// of an Alphabet they depend on, explicitly instantiated for those the
+// library supports in the translation unit that defines them.
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+/** \brief Signature shared by all the encoding kernels, see base64::encode.
+
+    Encodes whole blocks from the start of \a src, as many as it likes but
+    always a multiple of 3 bytes, and returns how many bytes of \a src it
+    encoded. The caller encodes the rest.
+ */
+using EncodeFunction = size_t (*)( const char* src
+                                 , size_t numSrcChars
+                                 , char* dst );
+
+/** \brief Signature shared by all the decoding kernels, see base64::decode.
+
+    Decodes whole blocks from the start of \a src, stopping short of any
+    block with a character outside the alphabet in it, padding included.
+    Returns how many characters of \a src it decoded, always a multiple of 4.
+    The caller decodes the rest and pins down any error.
+
+    May write past the bytes it decodes, but never beyond the first
+    3 * numSrcChars / 4 bytes of \a dst.
+ */
+using DecodeFunction = size_t (*)( const char* src
+                                 , size_t numSrcChars
+                                 , char* dst );
+
+// One per instruction set, only those built for this architecture exist.
+template< char c62, char c63 > size_t encodeBlocks          ( const char*, size_t, char* );
+template< char c62, char c63 > size_t encodeBlocksAvx2      ( const char*, size_t, char* );
+template< char c62, char c63 > size_t encodeBlocksAvx512Vbmi( const char*, size_t, char* );
+
+template< char c62, char c63 > size_t decodeBlocks     ( const char*, size_t, char* );
+template< char c62, char c63 > size_t decodeBlocksSse41( const char*, size_t, char* );
+template< char c62, char c63 > size_t decodeBlocksAvx2 ( const char*, size_t, char* );
+
+
+namespace
+{
+
+
+/** \brief The 64 characters in order of value for the alphabet ending
+           \a c62, \a c63, as Alphabet::lookup. */
+struct Characters
+{
+  char values[ 64 ];
+};
+
+constexpr Characters makeCharacters( char c62, char c63 )
+{
+  Characters characters{};
+  for ( int i = 0; i < 26; ++i )
+  {
+    characters.values[ i ] = char( 'A' + i );
+    characters.values[ 26 + i ] = char( 'a' + i );
+  }
+  for ( int i = 0; i < 10; ++i )
+  {
+    characters.values[ 52 + i ] = char( '0' + i );
+  }
+  characters.values[ 62 ] = c62;
+  characters.values[ 63 ] = c63;
+  return characters;
+}
+
+
+/**
+    \brief The shuffle tables the SSE4.1 and AVX2 decoders validate and
+           translate with, see translate() in base64sse41.cpp.
+
+    Looking up a character's high nibble in validHigh gives the bit for its
+    class, the high nibbles with the same set of valid low nibbles. Looking
+    up its low nibble in validLow gives the bits of the classes it is invalid
+    for. So a character is valid if the two have no bit in common.
+
+    Its value is then the character plus the offset at the index of its high
+    nibble, which is the same for all the letters or digits sharing it.
+    c62 and c63 get an index of their own where they share a high nibble
+    with other characters, that of an invalid high nibble, by adding their
+    shift to their high nibble.
+ */
+struct DecodeTables
+{
+  uint8_t validLow[ 16 ];
+  uint8_t validHigh[ 16 ];
+  int8_t offsets[ 16 ];
+  int8_t shift62;
+  int8_t shift63;
+};
+
+constexpr bool isAlphanumeric( int c )
+{
+  return ( '0' <= c && c <= '9' ) || ( 'A' <= c && c <= 'Z' ) || ( 'a' <= c && c <= 'z' );
+}
+
+constexpr DecodeTables makeDecodeTables( char c62, char c63 )
+{
+  // The valid low nibbles for each high nibble, as bit sets.
+  uint16_t valid[ 16 ]{};
+  for ( int c = 0; c < 128; ++c )
+  {
+    if ( isAlphanumeric( c ) || c == c62 || c == c63 )
+    {
+      valid[ c >> 4 ] |= uint16_t( 1 << ( c & 0xF ) );
+    }
+  }
+
+  DecodeTables tables{};
+
+  uint16_t classes[ 8 ]{};
+  int numClasses{ 0 };
+  for ( int high = 0; high < 16; ++high )
+  {
+    int k{ 0 };
+    while ( k < numClasses && classes[ k ] != valid[ high ] )
+    {
+      ++k;
+    }
+    if ( k == numClasses )
+    {
+      if ( numClasses == 8 )
+      {
+        throw "More classes of high nibble than bits in a byte";
+      }
+      classes[ numClasses++ ] = valid[ high ];
+    }
+    tables.validHigh[ high ] = uint8_t( 1 << k );
+  }
+  for ( int low = 0; low < 16; ++low )
+  {
+    for ( int k = 0; k < numClasses; ++k )
+    {
+      if ( !( classes[ k ] & ( 1 << low ) ) )
+      {
+        tables.validLow[ low ] |= uint8_t( 1 << k );
+      }
+    }
+  }
+
+  tables.offsets[ 3 ] = 52 - '0';
+  tables.offsets[ 4 ] = tables.offsets[ 5 ] = -'A';
+  tables.offsets[ 6 ] = tables.offsets[ 7 ] = 26 - 'a';
+
+  // c63 first so that, where the two share a high nibble, c62 keeps it.
+  uint16_t unplaced[ 16 ]{};
+  for ( int high = 0; high < 16; ++high )
+  {
+    unplaced[ high ] = valid[ high ];
+  }
+  bool isTaken[ 16 ]{};
+  const auto place = [&]( char c, int value, int8_t& shift )
+  {
+    const int high{ c >> 4 };
+    const uint16_t bit( 1 << ( c & 0xF ) );
+    if ( unplaced[ high ] == bit )
+    {
+      tables.offsets[ high ] = int8_t( value - c );
+      return;
+    }
+    unplaced[ high ] &= uint16_t( ~bit );
+
+    const int spareIndices[]{ 1, 0, 8, 9, 10, 11, 12, 13, 14, 15 };
+    for ( int index : spareIndices )
+    {
+      if ( !valid[ index ] && !isTaken[ index ] )
+      {
+        isTaken[ index ] = true;
+        tables.offsets[ index ] = int8_t( value - c );
+        shift = int8_t( index - high );
+        return;
+      }
+    }
+  };
+  place( c63, 63, tables.shift63 );
+  place( c62, 62, tables.shift62 );
+
+  return tables;
+}
+
+
+} // End of anonymous namespace
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_BASE64KERNELS_H
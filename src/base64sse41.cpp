@@ -0,0 +1,141 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compiled with the SSE4.1 flags, see the Makefile. Only ever called once
+// base64::decode has checked the CPU supports SSE4.1.
+
+#include "base64kernels.h"
+
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+#include <immintrin.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+namespace
+{
+
+
+/** \brief Replaces 16 characters with their 6-bit values.
+    \return False, leaving \a chars alone, if any is not in the alphabet.
+
+    The characters valid for each low nibble and each high nibble are bit
+    sets looked up with a shuffle, a character is valid if the two have
+    nothing in common. The value is then the character plus an offset that
+    depends only on the high nibble, other than for c62 or c63 where they
+    share a high nibble with other characters, e.g. '/' with '+'. See
+    DecodeTables and Wojciech Muła and Daniel Lemire, "Faster Base64
+    Encoding and Decoding Using AVX2 Instructions".
+ */
+template< char c62, char c63 >
+bool translate( __m128i& chars )
+{
+  static constexpr DecodeTables tables{ makeDecodeTables( c62, c63 ) };
+
+  const __m128i validLow{ _mm_loadu_si128( (const __m128i*)tables.validLow ) };
+  const __m128i validHigh{ _mm_loadu_si128( (const __m128i*)tables.validHigh ) };
+  const __m128i offsets{ _mm_loadu_si128( (const __m128i*)tables.offsets ) };
+
+  // Masking with 0x2F rather than 0x0F keeps bit 7 clear, all the shuffles
+  // care about.
+  const __m128i nibble{ _mm_set1_epi8( 0x2F ) };
+  const __m128i highNibbles{ _mm_and_si128( _mm_srli_epi32( chars, 4 ), nibble ) };
+  const __m128i lowNibbles{ _mm_and_si128( chars, nibble ) };
+  if ( !_mm_testz_si128( _mm_shuffle_epi8( validLow, lowNibbles )
+                       , _mm_shuffle_epi8( validHigh, highNibbles ) ) )
+  {
+    return false;
+  }
+
+  __m128i indices{ highNibbles };
+  if constexpr ( tables.shift62 != 0 )
+  {
+    const __m128i is62{ _mm_cmpeq_epi8( chars, _mm_set1_epi8( c62 ) ) };
+    indices = _mm_add_epi8( indices, _mm_and_si128( is62, _mm_set1_epi8( tables.shift62 ) ) );
+  }
+  if constexpr ( tables.shift63 != 0 )
+  {
+    const __m128i is63{ _mm_cmpeq_epi8( chars, _mm_set1_epi8( c63 ) ) };
+    indices = _mm_add_epi8( indices, _mm_and_si128( is63, _mm_set1_epi8( tables.shift63 ) ) );
+  }
+  chars = _mm_add_epi8( chars, _mm_shuffle_epi8( offsets, indices ) );
+  return true;
+}
+
+// Packs 16 6-bit values into 12 bytes at the bottom of the register.
+__m128i pack( __m128i values )
+{
+  const __m128i pairs{ _mm_maddubs_epi16( values, _mm_set1_epi32( 0x01400140 ) ) };
+  const __m128i quartets{ _mm_madd_epi16( pairs, _mm_set1_epi32( 0x00011000 ) ) };
+  return _mm_shuffle_epi8( quartets, _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 ) );
+}
+
+
+} // End of anonymous namespace
+
+
+/** \brief Validates and decodes 32 characters to 24 bytes per iteration, in
+           two halves.
+
+    Each half stores 16 bytes of which 12 are wanted, so the loop stops while
+    there is room for that.
+ */
+template< char c62, char c63 >
+size_t decodeBlocksSse41( const char* src, size_t numSrcChars, char* dst )
+{
+  size_t numDecoded{ 0 };
+  for ( ; numDecoded + 40 <= numSrcChars; numDecoded += 32, dst += 24 )
+  {
+    __m128i first{ _mm_loadu_si128( (const __m128i*)( src + numDecoded ) ) };
+    __m128i second{ _mm_loadu_si128( (const __m128i*)( src + numDecoded + 16 ) ) };
+    if ( !translate<c62, c63>( first ) || !translate<c62, c63>( second ) )
+    {
+      break;
+    }
+    _mm_storeu_si128( (__m128i*)dst, pack( first ) );
+    _mm_storeu_si128( (__m128i*)( dst + 12 ), pack( second ) );
+  }
+
+  return numDecoded;
+}
+
+template size_t decodeBlocksSse41<'+', '/'>( const char*, size_t, char* );
+template size_t decodeBlocksSse41<'-', '_'>( const char*, size_t, char* );
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif
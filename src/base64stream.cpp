@@ -0,0 +1,250 @@
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/base64stream.h>
+#include <lb/encoding/base64inline.h>
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace base64
+{
+
+
+template< class Alphabet >
+size_t Encoder<Alphabet>::update( const char* src, size_t numSrcChars, char* dst )
+{
+  size_t numDstChars{ 0 };
+
+  // Complete the triplet carried over from last time, if possible.
+  if ( numPending > 0 )
+  {
+    const size_t numTaken{ std::min( 3 - numPending, numSrcChars ) };
+    std::memcpy( pending + numPending, src, numTaken );
+    numPending += numTaken;
+    src += numTaken;
+    numSrcChars -= numTaken;
+
+    if ( numPending < 3 )
+    {
+      return 0;
+    }
+
+    inlined::encodeTriplet<Alphabet>( pending, dst );
+    numPending = 0;
+    numDstChars = 4;
+    dst += 4;
+  }
+
+  // The whole triplets go to the kernels, there is no padding among them.
+  const size_t numBlockChars{ numSrcChars - numSrcChars % 3 };
+  encode<Alphabet>( src, numBlockChars, dst );
+  numDstChars += 4 * ( numBlockChars / 3 );
+
+  numPending = numSrcChars - numBlockChars;
+  std::memcpy( pending, src + numBlockChars, numPending );
+
+  return numDstChars;
+}
+
+template< class Alphabet >
+std::string Encoder<Alphabet>::update( const std::string& src )
+{
+  std::string dst( updateSize( src.size() ), '\0' );
+  update( src.data(), src.size(), dst.data() );
+  return dst;
+}
+
+template< class Alphabet >
+size_t Encoder<Alphabet>::finish( char* dst )
+{
+  const size_t numDstChars{ encodedSize<Alphabet>( numPending ) };
+  encode<Alphabet>( (const char*)pending, numPending, dst );
+  numPending = 0;
+  return numDstChars;
+}
+
+template< class Alphabet >
+std::string Encoder<Alphabet>::finish()
+{
+  char dst[4];
+  return std::string( dst, finish( dst ) );
+}
+
+
+
+template< class Alphabet >
+DecodeResult Decoder<Alphabet>::fail( DecodeResult::Status status
+                                    , size_t errorPosition
+                                    , size_t numDstBytes )
+{
+  error = { status, 0, errorPosition };
+  return { status, numDstBytes, errorPosition };
+}
+
+// The padding should have ended the stream, blame it as decode() would.
+template< class Alphabet >
+DecodeResult Decoder<Alphabet>::failAfterPadding( size_t numDstBytes )
+{
+  return fail( DecodeResult::Status::eInvalidPadding, position - numPadding, numDstBytes );
+}
+
+template< class Alphabet >
+DecodeResult Decoder<Alphabet>::decodeQuartets( const char* src, size_t numSrcChars, char* dst )
+{
+  if ( numSrcChars == 0 )
+  {
+    return { DecodeResult::Status::eSuccess, 0, 0 };
+  }
+
+  // decode() allows padding in the last quartet only, exactly what is wanted.
+  const DecodeResult result{ decode<Alphabet>( src, numSrcChars, dst ) };
+  if ( result.status != DecodeResult::Status::eSuccess )
+  {
+    return fail( result.status, position + result.errorPosition, result.numDstBytes );
+  }
+
+  position += numSrcChars;
+  numPadding = ( src[ numSrcChars - 1 ] == '=' ) + ( src[ numSrcChars - 2 ] == '=' );
+  return result;
+}
+
+template< class Alphabet >
+DecodeResult Decoder<Alphabet>::update( const char* src, size_t numSrcChars, char* dst )
+{
+  if ( error.status != DecodeResult::Status::eSuccess )
+  {
+    return error;
+  }
+  if ( numPadding > 0 && numSrcChars > 0 )
+  {
+    return failAfterPadding( 0 );
+  }
+
+  size_t numDstBytes{ 0 };
+
+  // Complete the quartet carried over from last time, if possible.
+  if ( numPending > 0 )
+  {
+    const size_t numTaken{ std::min( 4 - numPending, numSrcChars ) };
+    std::memcpy( pending + numPending, src, numTaken );
+    numPending += numTaken;
+    src += numTaken;
+    numSrcChars -= numTaken;
+
+    if ( numPending < 4 )
+    {
+      return { DecodeResult::Status::eSuccess, 0, 0 };
+    }
+
+    numPending = 0;
+    const DecodeResult result{ decodeQuartets( pending, 4, dst ) };
+    if ( result.status != DecodeResult::Status::eSuccess )
+    {
+      return result;
+    }
+    numDstBytes = result.numDstBytes;
+    dst += numDstBytes;
+
+    if ( numPadding > 0 && numSrcChars > 0 )
+    {
+      return failAfterPadding( numDstBytes );
+    }
+  }
+
+  const size_t numQuartetChars{ numSrcChars - numSrcChars % 4 };
+  const DecodeResult result{ decodeQuartets( src, numQuartetChars, dst ) };
+  if ( result.status != DecodeResult::Status::eSuccess )
+  {
+    return { result.status, numDstBytes + result.numDstBytes, result.errorPosition };
+  }
+  numDstBytes += result.numDstBytes;
+
+  numPending = numSrcChars - numQuartetChars;
+  if ( numPadding > 0 && numPending > 0 )
+  {
+    return failAfterPadding( numDstBytes );
+  }
+  std::memcpy( pending, src + numQuartetChars, numPending );
+
+  return { DecodeResult::Status::eSuccess, numDstBytes, 0 };
+}
+
+template< class Alphabet >
+std::optional<std::string> Decoder<Alphabet>::update( const std::string& src )
+{
+  std::string dst( updateSize( src.size() ), '\0' );
+
+  const DecodeResult result{ update( src.data(), src.size(), dst.data() ) };
+  if ( result.status != DecodeResult::Status::eSuccess )
+  {
+    return {};
+  }
+
+  dst.resize( result.numDstBytes );
+  return dst;
+}
+
+template< class Alphabet >
+DecodeResult Decoder<Alphabet>::finish( char* dst )
+{
+  DecodeResult result{ error };
+  if ( result.status == DecodeResult::Status::eSuccess && numPending > 0 )
+  {
+    // A partial quartet, valid only without padding. decode() says why not
+    // exactly as it would for the whole stream.
+    result = decode<Alphabet>( pending, numPending, dst );
+    if ( result.status != DecodeResult::Status::eSuccess )
+    {
+      result.errorPosition += position;
+    }
+  }
+
+  *this = Decoder{};
+  return result;
+}
+
+
+
+template class Encoder<Standard>;
+template class Encoder<StandardUnpadded>;
+template class Encoder<Url>;
+template class Encoder<UrlUnpadded>;
+
+template class Decoder<Standard>;
+template class Decoder<StandardUnpadded>;
+template class Decoder<Url>;
+template class Decoder<UrlUnpadded>;
+
+
+} // End of namespace base64
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
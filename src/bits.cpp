@@ -16,6 +16,7 @@
 */
 
 #include <lb/encoding/bits.h>
+#include <lb/encoding/bitsinline.h>
 
 #include <iostream>
 
@@ -34,14 +35,7 @@ namespace bits
 
 void encode( char src, char* dst )
 {
-  *dst++ = ( src & 0x80 ) ? '1' : '0';
-  *dst++ = ( src & 0x40 ) ? '1' : '0';
-  *dst++ = ( src & 0x20 ) ? '1' : '0';
-  *dst++ = ( src & 0x10 ) ? '1' : '0';
-  *dst++ = ( src & 0x08 ) ? '1' : '0';
-  *dst++ = ( src & 0x04 ) ? '1' : '0';
-  *dst++ = ( src & 0x02 ) ? '1' : '0';
-  *dst   = ( src & 0x01 ) ? '1' : '0';
+  inlined::encode( src, dst );
 }
 
 Printer::Printer( char c )
@@ -0,0 +1,203 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/dispatch.h>
+
+#include "dispatcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace dispatch
+{
+
+
+std::string toString( Tier tier )
+{
+  switch ( tier )
+  {
+  case Tier::eBaseline:
+    return "baseline";
+  case Tier::eSse41:
+    return "sse4.1";
+  case Tier::eAvx2:
+    return "avx2";
+  case Tier::eAvx512:
+    return "avx512";
+  case Tier::eAvx512Vbmi:
+    return "avx512vbmi";
+  }
+  return "unknown";
+}
+
+std::optional<Tier> toTier( std::string_view name )
+{
+  for ( Tier tier : { Tier::eBaseline
+                    , Tier::eSse41
+                    , Tier::eAvx2
+                    , Tier::eAvx512
+                    , Tier::eAvx512Vbmi } )
+  {
+    if ( name == toString( tier ) )
+    {
+      return tier;
+    }
+  }
+  return {};
+}
+
+
+namespace
+{
+
+
+Tier detectTier()
+{
+#if defined( __x86_64__ ) || defined( __i386__ )
+  // Needed when called from a static initialiser. The checks for AVX and
+  // AVX-512 include the operating system saving their registers.
+  __builtin_cpu_init();
+  if ( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512bw" ) )
+  {
+    return __builtin_cpu_supports( "avx512vbmi" ) ? Tier::eAvx512Vbmi
+                                                  : Tier::eAvx512;
+  }
+  if ( __builtin_cpu_supports( "avx2" ) )
+  {
+    return Tier::eAvx2;
+  }
+  if ( __builtin_cpu_supports( "sse4.1" ) )
+  {
+    return Tier::eSse41;
+  }
+#endif
+  return Tier::eBaseline;
+}
+
+// The detected tier, lowered by LB_ENCODING_FORCE_TIER if set to a known name.
+Tier initialTier()
+{
+  const Tier detected{ detectedTier() };
+  const char* name{ std::getenv( "LB_ENCODING_FORCE_TIER" ) };
+  if ( !name )
+  {
+    return detected;
+  }
+  const auto forced{ toTier( name ) };
+  return forced ? std::min( *forced, detected ) : detected;
+}
+
+std::atomic<Tier>& currentTier()
+{
+  static std::atomic<Tier> tier{ initialTier() };
+  return tier;
+}
+
+// Every dispatcher resolved so far, most recent first.
+std::mutex registryMutex;
+DispatcherBase* registry{ nullptr };
+
+
+} // End of anonymous namespace
+
+
+Tier detectedTier()
+{
+  static const Tier tier{ detectTier() };
+  return tier;
+}
+
+Tier activeTier()
+{
+  return currentTier().load( std::memory_order_relaxed );
+}
+
+
+void DispatcherBase::resolve()
+{
+  select();
+
+  std::lock_guard lock{ registryMutex };
+  if ( !isRegistered )
+  {
+    next = registry;
+    registry = this;
+    isRegistered = true;
+  }
+}
+
+void forceTier( Tier tier )
+{
+  currentTier().store( std::min( tier, detectedTier() ), std::memory_order_relaxed );
+
+  std::lock_guard lock{ registryMutex };
+  for ( DispatcherBase* d = registry; d; d = d->next )
+  {
+    d->select();
+  }
+}
+
+
+std::vector<Kernel> selectedKernels()
+{
+  std::vector<Kernel> kernels;
+  {
+    std::lock_guard lock{ registryMutex };
+    for ( DispatcherBase* d = registry; d; d = d->next )
+    {
+      kernels.push_back( d->selected() );
+    }
+  }
+  std::sort( kernels.begin()
+           , kernels.end()
+           , []( const Kernel& a, const Kernel& b ) { return a.function < b.function; } );
+  return kernels;
+}
+
+std::string describe()
+{
+  std::string description{ "tier " + toString( activeTier() ) };
+  if ( activeTier() != detectedTier() )
+  {
+    description += " (detected " + toString( detectedTier() ) + ")";
+  }
+  description += ":";
+  for ( const Kernel& kernel : selectedKernels() )
+  {
+    description += " " + kernel.function + "=" + kernel.name;
+  }
+  return description;
+}
+
+
+} // End of namespace dispatch
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
@@ -0,0 +1,156 @@
+#ifndef LB_ENCODING_DISPATCHER_H
+#define LB_ENCODING_DISPATCHER_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. The plumbing behind every function with
+// more than one kernel.
+//
+// A Dispatcher holds the candidate kernels for one function, in increasing
+// order of tier starting with a baseline one, and a pointer to the best of
+// them for dispatch::activeTier(). It is constant initialised so it can be
+// used from any static initialiser, and selects its kernel the first time it
+// is used. Define a SelectAtLoad alongside it to do that while the library
+// loads instead, so that it is listed by dispatch::selectedKernels() from the
+// start.
+//
+// Calling through it costs one load and an indirect call, so dispatch at the
+// level of a whole buffer, never per byte.
+
+#include <lb/encoding/dispatch.h>
+
+#include "probes.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace dispatch
+{
+
+
+//! One kernel for a dispatched function.
+template< class Function >
+struct Candidate
+{
+  Tier tier;         //!< The tier the kernel requires
+  const char* name;
+  int id;            //!< Identifies the kernel in probes, e.g. its lane count
+  Function function;
+};
+
+
+class DispatcherBase
+{
+public:
+  constexpr DispatcherBase( const char* function ) : function{ function } {}
+
+  //! Selects the kernel for activeTier() and makes it known to forceTier()
+  //! and selectedKernels().
+  void resolve();
+
+  //! Selects the kernel for activeTier().
+  virtual void select() = 0;
+
+  //! Describes the selected kernel, only valid once resolved.
+  virtual Kernel selected() const = 0;
+
+  const char* const function;
+
+  // The list of resolved dispatchers, see dispatch.cpp.
+  DispatcherBase* next{ nullptr };
+  bool isRegistered{ false };
+};
+
+
+template< class Function, size_t N >
+class Dispatcher : public DispatcherBase
+{
+public:
+  constexpr Dispatcher( const char* function
+                      , std::array<Candidate<Function>, N> candidates )
+    : DispatcherBase{ function }
+    , candidates{ candidates }
+  {
+  }
+
+  //! The selected kernel, selecting it first if need be.
+  const Candidate<Function>& get()
+  {
+    const Candidate<Function>* kernel{ current.load( std::memory_order_acquire ) };
+    if ( !kernel )
+    {
+      resolve();
+      kernel = current.load( std::memory_order_acquire );
+    }
+    return *kernel;
+  }
+
+  void select() override
+  {
+    const Tier tier{ activeTier() };
+    const Candidate<Function>* kernel{ &candidates[0] };
+    for ( const auto& candidate : candidates )
+    {
+      if ( candidate.tier <= tier )
+      {
+        kernel = &candidate;
+      }
+    }
+    LB_PROBE2( kernel_select, function, kernel->id );
+    current.store( kernel, std::memory_order_release );
+  }
+
+  Kernel selected() const override
+  {
+    const Candidate<Function>* kernel{ current.load( std::memory_order_acquire ) };
+    return { function, kernel->name, kernel->tier };
+  }
+
+private:
+  const std::array<Candidate<Function>, N> candidates;
+  std::atomic<const Candidate<Function>*> current{ nullptr };
+};
+
+
+//! Resolves a Dispatcher during static initialisation, see above.
+struct SelectAtLoad
+{
+  SelectAtLoad( DispatcherBase& dispatcher ) { dispatcher.resolve(); }
+};
+
+
+} // End of namespace dispatch
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_DISPATCHER_H
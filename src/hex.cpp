@@ -16,8 +16,7 @@
 */
 
 #include <lb/encoding/hex.h>
-
-#include <memory>
+#include <lb/encoding/hexinline.h>
 
 
 namespace lb
@@ -34,46 +33,23 @@ namespace hex
 
 void encode( char src, char* dst )
 {
-  const auto firstDigit{ ( src & 0xF0 ) >> 4 };
-  if ( firstDigit < 10 )
-  {
-    dst[0] = '0' + firstDigit;
-  }
-  else
-  {
-    dst[0] = 'A' + firstDigit - 10;
-  }
-  const auto secondDigit{ src & 0x0F };
-  if ( secondDigit < 10 )
-  {
-    dst[1] = '0' + secondDigit;
-  }
-  else
-  {
-    dst[1] = 'A' + secondDigit - 10;
-  }
+  inlined::encode( src, dst );
 }
 
 void encode( const char* src, size_t numSrcBytes, char* dst )
 {
-  for ( size_t i = 0; i < numSrcBytes; ++i, ++src, dst += 2 )
-  {
-    encode( *src, dst );
-  }
+  inlined::encode( src, numSrcBytes, dst );
 }
 
 std::string encode( const std::string& src )
 {
   const size_t requiredStorage{ 2 * src.size() };
 
-  std::unique_ptr<char[]> dst{ std::make_unique<char[]>( requiredStorage ) };
+  std::string dst( requiredStorage, '\0' );
 
-  encode( src.c_str(), src.size(), dst.get() );
+  encode( src.c_str(), src.size(), dst.data() );
 
-  // std::string always takes a copy. Understandable, but unfortunate here. If
-  // only there was some sort of move semantics for passing C-style string
-  // ownership to std::string.
-  return { dst.get(), requiredStorage };
+  return dst;
 }
 
 } // End of namespace hex
@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compiled with the AVX2 flags, see the Makefile. Only ever called once
+// encodeMaskedPayload has checked the CPU supports AVX2.
+
+#include "maskmulti.h"
+
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+void maskPayload32( const char* src
+                   , size_t numSrcChars
+                   , const uint8_t mask[4]
+                   , char* dst )
+{
+  maskPayloadN<32>( src, numSrcChars, mask, dst );
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef LB_ENCODING_MASKMULTI_H
+#define LB_ENCODING_MASKMULTI_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. WebSocket payload masking N bytes at a
+// time.
+//
+// As with sha1multi.h the kernel is written once with GCC vector extensions
+// and included by one translation unit per instruction set, each compiled
+// with the flags for that instruction set (see the Makefile). Everything
+// lives in an anonymous namespace so that the differently compiled
+// instantiations can never be merged by the linker.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+//! Signature shared by all the masking kernels, see encodeMaskedPayload.
+using MaskFunction = void (*)( const char* src
+                             , size_t numSrcChars
+                             , const uint8_t mask[4]
+                             , char* dst );
+
+// One per vector width in bytes, only those built for this architecture exist.
+void maskPayload16( const char*, size_t, const uint8_t[4], char* );
+void maskPayload32( const char*, size_t, const uint8_t[4], char* );
+void maskPayload64( const char*, size_t, const uint8_t[4], char* );
+
+
+namespace
+{
+
+
+template< size_t N >
+struct Bytes
+{
+  typedef uint8_t Vector __attribute__(( vector_size( N ) ));
+};
+
+/** \brief XORs the repeating four byte \a mask over \a numSrcChars bytes, N
+           at a time.
+
+    \a dst may be the same as \a src. The bytes left over after the last whole
+    vector are done at half the width, down to 16, then one at a time.
+ */
+template< size_t N >
+inline void maskPayloadN( const char* src
+                        , size_t numSrcChars
+                        , const uint8_t mask[4]
+                        , char* dst )
+{
+  typedef typename Bytes<N>::Vector Vector;
+
+  Vector m;
+  for ( size_t i = 0; i < N; ++i )
+  {
+    m[i] = mask[ i % 4 ];
+  }
+
+  size_t i{ 0 };
+  for ( ; i + N <= numSrcChars; i += N )
+  {
+    Vector v;
+    std::memcpy( &v, src + i, N );
+    v ^= m;
+    std::memcpy( dst + i, &v, N );
+  }
+
+  // N is a multiple of four so the mask lines up again from i.
+  if constexpr ( N > 16 )
+  {
+    maskPayloadN<N/2>( src + i, numSrcChars - i, mask, dst + i );
+  }
+  else
+  {
+    for ( ; i < numSrcChars; ++i )
+    {
+      dst[i] = src[i] ^ mask[ i % 4 ];
+    }
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_MASKMULTI_H
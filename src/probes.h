@@ -0,0 +1,83 @@
+#ifndef LB_ENCODING_PROBES_H
+#define LB_ENCODING_PROBES_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. USDT (user level statically defined
+// tracing) probes under the provider name lbencoding.
+//
+// Each probe is a single nop in the instruction stream plus a note in the
+// ELF file describing where its arguments live, so an unattached probe costs
+// nothing. Tools such as bpftrace and perf patch in a breakpoint to attach:
+//
+//   bpftrace -e 'usdt:./liblbEncoding.so:lbencoding:frame_complete { @[arg0] = count(); }'
+//
+// The probes need sys/sdt.h (systemtap-sdt-devel on Fedora, systemtap-sdt-dev
+// on Debian). Without it, or when built with PROBES=0 (see the Makefile),
+// they compile to nothing.
+//
+// Probe arguments are evaluated whether a probe is attached or not so keep
+// them to values that are already to hand.
+//
+// The probes and their arguments:
+//
+//   kernel_select     function name, kernel id     dispatcher.h, as a
+//                                                  Dispatcher picks a kernel
+//   sha1_start        number of bytes              sha1.cpp, sha1::encode()
+//   sha1_finish       number of bytes
+//   sha1_batch_start  number of messages           sha1.cpp, encodeBatch()
+//   sha1_batch_finish number of messages
+//   frame_start       op code, payload size,       websocket.cpp, a frame
+//                     is masked                    header has been decoded
+//   frame_complete    op code, payload size        websocket.cpp, a whole
+//                                                  frame has been decoded
+//   partial_header    bytes buffered               websocket.cpp, input ran
+//   partial_payload   op code, payload size,       out part way through a
+//                     bytes buffered               header or a payload
+//   parse_error       Header::DecodeResult,        websocket.cpp, an invalid
+//                     bytes left in the buffer     frame header
+//   mask_kernel       kernel id, number of bytes   websocket.cpp,
+//                                                  encodeMaskedPayload()
+//
+// A kernel id is the bytes or lanes it handles per iteration, see the
+// Dispatcher definitions.
+
+#if !defined( LB_ENCODING_NO_PROBES ) && defined( __has_include )
+#if __has_include( <sys/sdt.h> )
+#define LB_ENCODING_HAS_PROBES
+#endif
+#endif
+
+#ifdef LB_ENCODING_HAS_PROBES
+
+#include <sys/sdt.h>
+
+#define LB_PROBE1( name, a )       DTRACE_PROBE1( lbencoding, name, a )
+#define LB_PROBE2( name, a, b )    DTRACE_PROBE2( lbencoding, name, a, b )
+#define LB_PROBE3( name, a, b, c ) DTRACE_PROBE3( lbencoding, name, a, b, c )
+
+#else
+
+#define LB_PROBE1( name, a )       do {} while ( false )
+#define LB_PROBE2( name, a, b )    do {} while ( false )
+#define LB_PROBE3( name, a, b, c ) do {} while ( false )
+
+#endif
+
+
+#endif // LB_ENCODING_PROBES_H
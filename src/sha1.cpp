@@ -18,9 +18,15 @@
 #include <lb/encoding/sha1.h>
 #include <lb/encoding/hex.h>
 
+#include "dispatcher.h"
+#include "probes.h"
+#include "sha1block.h"
+#include "sha1multi.h"
+
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
-#include <memory>
+#include <stdexcept>
 
 
 namespace lb
@@ -62,6 +68,8 @@ void encode( const char* src, size_t numSrcChars, char* dst )
   // This code has been written to be endian agnostic. It has only been tested
   // on a little endian system though...
 
+  LB_PROBE1( sha1_start, numSrcChars );
+
   // Message length in bits.
   const uint64_t ml = numSrcChars * 8;
 
@@ -76,156 +84,127 @@ void encode( const char* src, size_t numSrcChars, char* dst )
 
   const size_t N = ( ml + 1 + numZeroBits  + 64 )/ 8;
 
-  // Heap allocate for now. We could do variable sized array to get stack
-  // allocation for short strings I suppose. There are all sorts of things we
-  // could do to optimise this allocation but let's not be premature...
-  //
-  // Note that the memory will be initialised to zero so we do not have to
+  uint32_t h[5] = { initialHash[0]
+                  , initialHash[1]
+                  , initialHash[2]
+                  , initialHash[3]
+                  , initialHash[4] };
+
+  // Process the message in successive 512-bit chunks (64 bytes). Whole
+  // chunks of the message are processed where they are, only the final one
+  // or two chunks holding the padding are built up in a copy on the stack, so
+  // there is no allocation whatever the message size.
+  const size_t numWholeChunkBytes{ numSrcChars - numSrcChars % 64 };
+  const unsigned char* message{ reinterpret_cast<const unsigned char*>( src ) };
+  for ( size_t chunk = 0; chunk < numWholeChunkBytes; chunk += 64 )
+  {
+    processChunk( h, message + chunk );
+  }
+
+  // Note that the padding is initialised to zero so we do not have to
   // explcitily set numZeroBits to '0'.
-  std::unique_ptr<uint8_t[]> buffer{ std::make_unique<uint8_t[]>( N ) };
-
-  std::memcpy( buffer.get(), src, numSrcChars );
-  buffer.get()[ numSrcChars ] = 0x80; // set a '1' immediately after the message
-
-  buffer.get()[ N - 4 ] = (uint8_t)(ml >> 24);
-  buffer.get()[ N - 3 ] = (uint8_t)(ml >> 16);
-  buffer.get()[ N - 2 ] = (uint8_t)(ml >>  8);
-  buffer.get()[ N - 1 ] = (uint8_t)(ml >>  0);
-
-  // All constants are big endian. Within each word, the most significant byte
-  // is stored in the leftmost byte position.
-
-  // Big Endian representations
-  uint32_t h[5] = { 0x67452301    // little endian 0x01234567
-                  , 0xEFCDAB89    // little endian 0x89ABCDEF
-                  , 0x98BADCFE    // little endian 0xEFDCBA98
-                  , 0x10325476    // little endian 0x76543210
-                  , 0xC3D2E1F0 }; // little endian 0xF0E1D2C3
-
-  uint32_t bigEndianWords[80];
-
-  // Process the message in successive 512-bit chunks (64 bytes)
-  // Break chunk into sixteen 32-bit big-endian words w[i], 0 ≤ i ≤ 15 which
-  // we extend to 80 later.
-  //
-  // Note that the following loops are wasteful on big-endian architecture as
-  // we could just do std::memcpy( w, p, 64 ) but this way the code is endian
-  // agnostic.
-  uint32_t* p{ (uint32_t*)buffer.get() };
-  for ( size_t chunk = 0; chunk < N; chunk += 64 )
+  uint8_t padding[128] = {};
+  const size_t numPaddingBytes{ N - numWholeChunkBytes };
+  const size_t numTrailingChars{ numSrcChars - numWholeChunkBytes };
+
+  std::memcpy( padding, message + numWholeChunkBytes, numTrailingChars );
+  padding[ numTrailingChars ] = 0x80; // set a '1' immediately after the message
+
+  for ( size_t i = 1; i <= 8; ++i )
   {
-    uint8_t* w{ (uint8_t*)bigEndianWords };
+    padding[ numPaddingBytes - i ] = (uint8_t)( ml >> 8*(i-1) );
+  }
 
-    for ( int iw = 0; iw < 16; ++iw, p += 1 )
-    {
-      for ( int i = 0; i < 4; ++i, ++w )
-      {
-        *w = (uint8_t)(*p >> 8*(3-i));
-      }
-    }
+  for ( size_t chunk = 0; chunk < numPaddingBytes; chunk += 64 )
+  {
+    processChunk( h, padding + chunk );
+  }
 
-    // Message schedule: extend the sixteen 32-bit words into eighty 32-bit words:
-    uint32_t *bw = bigEndianWords;
-    for ( int i = 16; i < 80; ++i )
-    {
-      bw[i] = bw[i-3] ^ bw[i-8] ^ bw[i-14] ^ bw[i-16];
-      // Now left rotate the bits by one
-      bw[i] = ( bw[i] << 1 ) | ( bw[i] >> 31 );
-    }
+  storeDigest( h, dst );
 
-    // Initialize hash value for this chunk:
-    uint32_t a = h[0];
-    uint32_t b = h[1];
-    uint32_t c = h[2];
-    uint32_t d = h[3];
-    uint32_t e = h[4];
-    uint32_t k = 0x5A827999;
-    // Main loop. Manually unrolled.
+  LB_PROBE1( sha1_finish, numSrcChars );
+}
 
-    for ( int i = 0; i < 20; ++i )
-    {
-      uint32_t f = ( b & c ) | ( ( ~b ) & d );
-
-      const uint32_t temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + k + bw[i];
-      e = d;
-      d = c;
-      c = ( b << 30 ) | ( b >> 2 );
-      b = a;
-      a = temp;
-    }
 
-    k = 0x6ED9EBA1;
-    for ( int i = 20; i < 40; ++i )
-    {
-      uint32_t f = b ^ c ^ d;
-
-      const uint32_t temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + k + bw[i];
-      e = d;
-      d = c;
-      c = ( b << 30 ) | ( b >> 2 );
-      b = a;
-      a = temp;
-    }
+std::string encode( const std::string& src )
+{
+  const size_t requiredStorage{ 20 };
 
-    k = 0x8F1BBCDC;
-    for ( int i = 40; i < 60; ++i )
-    {
-      uint32_t f = ( b & c ) | ( b & d ) | ( c & d );
-
-      const uint32_t temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + k + bw[i];
-      e = d;
-      d = c;
-      c = ( b << 30 ) | ( b >> 2 );
-      b = a;
-      a = temp;
-    }
+  std::string dst( requiredStorage, '\0' );
 
-    k = 0xCA62C1D6;
-    for ( int i = 60; i < 80; ++i )
-    {
-      uint32_t f = b ^ c ^ d;
-
-      const uint32_t temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + k + bw[i];
-      e = d;
-      d = c;
-      c = ( b << 30 ) | ( b >> 2 );
-      b = a;
-      a = temp;
-    }
+  encode( src.c_str(), src.size(), dst.data() );
 
-    // Add this chunk's hash to result so far.
-    h[0] = h[0] + a;
-    h[1] = h[1] + b;
-    h[2] = h[2] + c;
-    h[3] = h[3] + d;
-    h[4] = h[4] + e;
-  }
+  return dst;
+}
 
-  // The final hash value (big-endian) is a 160-bit number of the form:
-  //
-  //  (h0 << 128) | (h1 << 96) | (h2 << 64) | (h3 << 32) | h4
-  for ( int i = 0; i < 5; ++i, dst += 4 )
-  {
-    dst[0] = (h[i] >> 24) & 0xFF;
-    dst[1] = (h[i] >> 16) & 0xFF;
-    dst[2] = (h[i] >>  8) & 0xFF;
-    dst[3] =  h[i]        & 0xFF;
-  }
+
+// The baseline kernel. Four lanes fit the SSE2 registers every x86-64 CPU has
+// and GCC falls back to plain scalar code on architectures without vectors.
+void encodeBatch4( const char* const* srcs
+                 , const size_t* numSrcChars
+                 , size_t numMessages
+                 , char* dst )
+{
+  encodeBatchN<4>( srcs, numSrcChars, numMessages, dst );
 }
 
 
-std::string encode( const std::string& src )
+namespace
 {
-  const size_t requiredStorage{ 20 };
 
-  std::unique_ptr<char[]> dst{ std::make_unique<char[]>( requiredStorage ) };
 
-  encode( src.c_str(), src.size(), dst.get() );
+// The widest kernel the active tier allows. Sixteen lanes only need AVX-512F
+// but there are no CPUs worth picking out that have it without AVX-512BW.
+constinit dispatch::Dispatcher batchKernels
+{ "sha1::encodeBatch"
+, std::array
+  { dispatch::Candidate<BatchFunction>{ dispatch::Tier::eBaseline, "baseline", 4, encodeBatch4 }
+#if defined( __x86_64__ ) || defined( __i386__ )
+  , dispatch::Candidate<BatchFunction>{ dispatch::Tier::eAvx2, "avx2", 8, encodeBatch8 }
+  , dispatch::Candidate<BatchFunction>{ dispatch::Tier::eAvx512, "avx512", 16, encodeBatch16 }
+#endif
+  }
+};
+dispatch::SelectAtLoad batchKernelsAtLoad{ batchKernels };
+
+
+} // End of anonymous namespace
+
 
-  // std::string always takes a copy. Understandable, but unfortunate here. If
-  // only there was some sort of move semantics for passing C-style string
-  // ownership to std::string.
-  return { dst.get(), requiredStorage };
+void encodeBatch( const char* const* srcs
+                , const size_t* numSrcChars
+                , size_t numMessages
+                , char* dst )
+{
+  const BatchFunction batchFunction{ batchKernels.get().function };
+
+  LB_PROBE1( sha1_batch_start, numMessages );
+  batchFunction( srcs, numSrcChars, numMessages, dst );
+  LB_PROBE1( sha1_batch_finish, numMessages );
+}
+
+void encodeBatch( std::span<const std::string_view> srcs, std::span<char> dst )
+{
+  if ( dst.size() / 20 < srcs.size() )
+  {
+    throw std::length_error( "SHA1 batch destination too small" );
+  }
+
+  // A multiple of every lane count.
+  const size_t groupSize{ 64 };
+  const char* groupSrcs[ groupSize ];
+  size_t groupNumSrcChars[ groupSize ];
+
+  for ( size_t first = 0; first < srcs.size(); first += groupSize )
+  {
+    const size_t numMessages{ std::min( groupSize, srcs.size() - first ) };
+    for ( size_t i = 0; i < numMessages; ++i )
+    {
+      groupSrcs[i] = srcs[ first + i ].data();
+      groupNumSrcChars[i] = srcs[ first + i ].size();
+    }
+    encodeBatch( groupSrcs, groupNumSrcChars, numMessages, dst.data() + 20 * first );
+  }
 }
 
 
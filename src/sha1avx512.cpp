@@ -0,0 +1,57 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Compiled with the AVX-512 flags, see the Makefile. Only ever called once
+// sha1::encodeBatch has checked the CPU supports AVX-512.
+
+#include "sha1multi.h"
+
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace sha1
+{
+
+
+void encodeBatch16( const char* const* srcs
+                  , const size_t* numSrcChars
+                  , size_t numMessages
+                  , char* dst )
+{
+  encodeBatchN<16>( srcs, numSrcChars, numMessages, dst );
+}
+
+
+} // End of namespace sha1
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif
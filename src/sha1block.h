@@ -0,0 +1,210 @@
+#ifndef LB_ENCODING_SHA1BLOCK_H
+#define LB_ENCODING_SHA1BLOCK_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. The SHA1 building blocks shared by the
+// general purpose sha1::encode and the fixed size special cases elsewhere in
+// the library.
+//
+// The anonymous namespace gives each translation unit its own copy. Some of
+// those translation units are compiled for wider instruction sets than
+// others and we must not let the linker pick one of their copies for all.
+
+#include <cstdint>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace sha1
+{
+
+
+namespace
+{
+
+
+// All constants are big endian. Within each word, the most significant byte
+// is stored in the leftmost byte position.
+constexpr uint32_t initialHash[5] = { 0x67452301    // little endian 0x01234567
+                                    , 0xEFCDAB89    // little endian 0x89ABCDEF
+                                    , 0x98BADCFE    // little endian 0xEFDCBA98
+                                    , 0x10325476    // little endian 0x76543210
+                                    , 0xC3D2E1F0 }; // little endian 0xF0E1D2C3
+
+constexpr uint32_t rotateLeft( uint32_t x, int n )
+{
+  return ( x << n ) | ( x >> ( 32 - n ) );
+}
+
+//! The constant k added in round \a i.
+constexpr uint32_t roundConstant( int i )
+{
+  return i < 20 ? 0x5A827999
+       : i < 40 ? 0x6ED9EBA1
+       : i < 60 ? 0x8F1BBCDC
+       :          0xCA62C1D6;
+}
+
+/** \brief Reads a big endian word from four bytes.
+
+    Endian agnostic. Compilers recognise the pattern and emit a single load
+    (plus a byte swap on little endian architectures).
+ */
+inline uint32_t loadBigEndian( const unsigned char* p )
+{
+  return ( uint32_t( p[0] ) << 24 )
+       | ( uint32_t( p[1] ) << 16 )
+       | ( uint32_t( p[2] ) <<  8 )
+       |   uint32_t( p[3] );
+}
+
+/** \brief Message schedule: extend the sixteen 32-bit words in \a w into
+           eighty 32-bit words and add the round constant to each.
+
+    Adding the round constants here rather than in the rounds makes no
+    difference to the general case but means a constant schedule can have
+    them folded in at compile time.
+ */
+constexpr void extendSchedule( uint32_t w[80] )
+{
+  for ( int i = 16; i < 80; ++i )
+  {
+    w[i] = rotateLeft( w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16], 1 );
+  }
+  for ( int i = 0; i < 80; ++i )
+  {
+    w[i] += roundConstant( i );
+  }
+}
+
+/** \brief Runs the eighty rounds for one 512-bit chunk and adds the chunk's
+           hash into \a h.
+    \param h The hash so far.
+    \param wk The chunk's message schedule with round constants added, see
+              extendSchedule().
+ */
+inline void compress( uint32_t h[5], const uint32_t wk[80] )
+{
+  uint32_t a = h[0];
+  uint32_t b = h[1];
+  uint32_t c = h[2];
+  uint32_t d = h[3];
+  uint32_t e = h[4];
+
+  for ( int i = 0; i < 20; ++i )
+  {
+    const uint32_t f = ( b & c ) | ( ( ~b ) & d );
+    const uint32_t temp = rotateLeft( a, 5 ) + f + e + wk[i];
+    e = d;
+    d = c;
+    c = rotateLeft( b, 30 );
+    b = a;
+    a = temp;
+  }
+
+  for ( int i = 20; i < 40; ++i )
+  {
+    const uint32_t f = b ^ c ^ d;
+    const uint32_t temp = rotateLeft( a, 5 ) + f + e + wk[i];
+    e = d;
+    d = c;
+    c = rotateLeft( b, 30 );
+    b = a;
+    a = temp;
+  }
+
+  for ( int i = 40; i < 60; ++i )
+  {
+    const uint32_t f = ( b & c ) | ( b & d ) | ( c & d );
+    const uint32_t temp = rotateLeft( a, 5 ) + f + e + wk[i];
+    e = d;
+    d = c;
+    c = rotateLeft( b, 30 );
+    b = a;
+    a = temp;
+  }
+
+  for ( int i = 60; i < 80; ++i )
+  {
+    const uint32_t f = b ^ c ^ d;
+    const uint32_t temp = rotateLeft( a, 5 ) + f + e + wk[i];
+    e = d;
+    d = c;
+    c = rotateLeft( b, 30 );
+    b = a;
+    a = temp;
+  }
+
+  // Add this chunk's hash to result so far.
+  h[0] += a;
+  h[1] += b;
+  h[2] += c;
+  h[3] += d;
+  h[4] += e;
+}
+
+/** \brief Hashes one 64 byte chunk of (already padded) message into \a h. */
+inline void processChunk( uint32_t h[5], const unsigned char* chunk )
+{
+  uint32_t w[80];
+  for ( int i = 0; i < 16; ++i, chunk += 4 )
+  {
+    w[i] = loadBigEndian( chunk );
+  }
+  extendSchedule( w );
+  compress( h, w );
+}
+
+/** \brief Writes the final hash \a h as the 20 byte digest.
+
+    The final hash value (big-endian) is a 160-bit number of the form:
+
+      (h0 << 128) | (h1 << 96) | (h2 << 64) | (h3 << 32) | h4
+ */
+inline void storeDigest( const uint32_t h[5], char* dst )
+{
+  for ( int i = 0; i < 5; ++i, dst += 4 )
+  {
+    dst[0] = (h[i] >> 24) & 0xFF;
+    dst[1] = (h[i] >> 16) & 0xFF;
+    dst[2] = (h[i] >>  8) & 0xFF;
+    dst[3] =  h[i]        & 0xFF;
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+} // End of namespace sha1
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_SHA1BLOCK_H
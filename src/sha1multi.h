@@ -0,0 +1,256 @@
+#ifndef LB_ENCODING_SHA1MULTI_H
+#define LB_ENCODING_SHA1MULTI_H
+
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Internal header, not installed. Multi-buffer SHA1: hashes N independent
+// messages at once with message i in lane i of each vector register.
+//
+// The kernel is written once with GCC vector extensions and included by one
+// translation unit per instruction set, each compiled with the flags for that
+// instruction set (see the Makefile). Everything lives in an anonymous
+// namespace so that the differently compiled instantiations can never be
+// merged by the linker.
+
+#include "sha1block.h"
+
+#include <cstddef>
+#include <cstring>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace sha1
+{
+
+
+//! Signature shared by all the batch kernels, see sha1::encodeBatch.
+using BatchFunction = void (*)( const char* const* srcs
+                              , const size_t* numSrcChars
+                              , size_t numMessages
+                              , char* dst );
+
+// One per instruction set, only those built for this architecture exist.
+void encodeBatch4 ( const char* const*, const size_t*, size_t, char* );
+void encodeBatch8 ( const char* const*, const size_t*, size_t, char* );
+void encodeBatch16( const char* const*, const size_t*, size_t, char* );
+
+
+namespace
+{
+
+
+template< int N >
+struct Lanes
+{
+  typedef uint32_t Vector __attribute__(( vector_size( 4 * N ) ));
+};
+
+// Read by lanes with no message, or whose message is finished, so that every
+// lane loads initialised memory. Their results are discarded.
+const unsigned char zeroChunk[64]{};
+
+/** \brief Hashes up to N messages, one per lane.
+
+    Messages of differing lengths are fine. Each lane only has its hash updated
+    for the chunks that belong to its message, so the cost is that of the
+    longest message in the group.
+ */
+template< int N >
+inline void encodeGroup( const char* const* srcs
+                       , const size_t* numSrcChars
+                       , size_t numMessages
+                       , char* dst )
+{
+  typedef typename Lanes<N>::Vector V;
+
+  // The final one or two chunks of each message hold the padding and length
+  // so are assembled here. The chunks before that are read in place.
+  unsigned char tails[N][128];
+  const unsigned char* starts[N];
+  size_t numFullChunks[N];
+  uint32_t numChunks[N];
+  size_t maxChunks{ 0 };
+
+  for ( int lane = 0; lane < N; ++lane )
+  {
+    if ( size_t( lane ) >= numMessages )
+    {
+      starts[lane] = zeroChunk;
+      numFullChunks[lane] = 0;
+      numChunks[lane] = 0;
+      continue;
+    }
+
+    const size_t size{ numSrcChars[lane] };
+    const size_t numTailBytes{ size % 64 };
+    starts[lane] = (const unsigned char*)srcs[lane];
+    numFullChunks[lane] = size / 64;
+    numChunks[lane] = numFullChunks[lane] + ( numTailBytes < 56 ? 1 : 2 );
+    if ( numChunks[lane] > maxChunks )
+    {
+      maxChunks = numChunks[lane];
+    }
+
+    unsigned char* tail{ tails[lane] };
+    const size_t numPaddedBytes{ 64 * ( numChunks[lane] - numFullChunks[lane] ) };
+    std::memset( tail, 0, numPaddedBytes );
+    std::memcpy( tail, starts[lane] + 64 * numFullChunks[lane], numTailBytes );
+    tail[ numTailBytes ] = 0x80;
+    const uint64_t ml{ uint64_t( size ) * 8 };
+    for ( int i = 1; i <= 8; ++i )
+    {
+      tail[ numPaddedBytes - i ] = (uint8_t)( ml >> 8*(i-1) );
+    }
+  }
+
+  V h[5];
+  for ( int i = 0; i < 5; ++i )
+  {
+    h[i] = V{} + initialHash[i];
+  }
+
+  V chunkLimit;
+  for ( int lane = 0; lane < N; ++lane )
+  {
+    chunkLimit[lane] = numChunks[lane];
+  }
+
+  for ( size_t chunk = 0; chunk < maxChunks; ++chunk )
+  {
+    // Transpose the chunk's words so that w[i] holds word i of every lane.
+    uint32_t words[16][N];
+    for ( int lane = 0; lane < N; ++lane )
+    {
+      const unsigned char* p;
+      if ( chunk < numFullChunks[lane] )
+      {
+        p = starts[lane] + 64 * chunk;
+      }
+      else if ( chunk < numChunks[lane] )
+      {
+        p = tails[lane] + 64 * ( chunk - numFullChunks[lane] );
+      }
+      else
+      {
+        p = zeroChunk;
+      }
+      for ( int i = 0; i < 16; ++i, p += 4 )
+      {
+        words[i][lane] = loadBigEndian( p );
+      }
+    }
+
+    V w[80];
+    for ( int i = 0; i < 16; ++i )
+    {
+      std::memcpy( &w[i], words[i], sizeof(V) );
+    }
+    for ( int i = 16; i < 80; ++i )
+    {
+      const V x{ w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16] };
+      w[i] = ( x << 1 ) | ( x >> 31 );
+    }
+
+    V a = h[0];
+    V b = h[1];
+    V c = h[2];
+    V d = h[3];
+    V e = h[4];
+
+    auto round = [&]( int i, const V& f )
+    {
+      const V temp = ( ( a << 5 ) | ( a >> 27 ) ) + f + e + roundConstant( i ) + w[i];
+      e = d;
+      d = c;
+      c = ( b << 30 ) | ( b >> 2 );
+      b = a;
+      a = temp;
+    };
+
+    for ( int i = 0; i < 20; ++i )
+    {
+      round( i, ( b & c ) | ( ( ~b ) & d ) );
+    }
+    for ( int i = 20; i < 40; ++i )
+    {
+      round( i, b ^ c ^ d );
+    }
+    for ( int i = 40; i < 60; ++i )
+    {
+      round( i, ( b & c ) | ( b & d ) | ( c & d ) );
+    }
+    for ( int i = 60; i < 80; ++i )
+    {
+      round( i, b ^ c ^ d );
+    }
+
+    // Only lanes whose message has this chunk take the result.
+    const V active = (V)( ( V{} + uint32_t( chunk ) ) < chunkLimit );
+    h[0] += a & active;
+    h[1] += b & active;
+    h[2] += c & active;
+    h[3] += d & active;
+    h[4] += e & active;
+  }
+
+  for ( size_t lane = 0; lane < numMessages && lane < size_t( N ); ++lane, dst += 20 )
+  {
+    const uint32_t laneHash[5] = { h[0][lane], h[1][lane], h[2][lane], h[3][lane], h[4][lane] };
+    storeDigest( laneHash, dst );
+  }
+}
+
+template< int N >
+inline void encodeBatchN( const char* const* srcs
+                        , const size_t* numSrcChars
+                        , size_t numMessages
+                        , char* dst )
+{
+  while ( numMessages > 0 )
+  {
+    encodeGroup<N>( srcs, numSrcChars, numMessages, dst );
+
+    const size_t numDone{ numMessages < size_t( N ) ? numMessages : size_t( N ) };
+    srcs        += numDone;
+    numSrcChars += numDone;
+    numMessages -= numDone;
+    dst         += 20 * numDone;
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+} // End of namespace sha1
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
+
+
+#endif // LB_ENCODING_SHA1MULTI_H
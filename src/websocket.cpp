@@ -17,10 +17,25 @@
 
 #include <lb/encoding/websocket.h>
 
+#include "dispatcher.h"
+#include "maskmulti.h"
+#include "probes.h"
+
 #include <arpa/inet.h>
+#include <algorithm>
+#include <iterator>
 #include <stdexcept>
 
 
+// Statistics cost a few increments per call to Decoder::decode, which is next
+// to nothing, but can still be compiled out.
+#ifdef LB_ENCODING_WEBSOCKET_STATS
+#define WEBSOCKET_STATS( statement ) statement
+#else
+#define WEBSOCKET_STATS( statement )
+#endif
+
+
 namespace lb
 {
 
@@ -33,6 +48,39 @@ namespace websocket
 {
 
 
+// The baseline kernel, 16 bytes at a time in SSE2 registers or as plain
+// scalar code on architectures without vectors.
+void maskPayload16( const char* src
+                  , size_t numSrcChars
+                  , const uint8_t mask[4]
+                  , char* dst )
+{
+  maskPayloadN<16>( src, numSrcChars, mask, dst );
+}
+
+
+namespace
+{
+
+
+// The widest kernel the active tier allows. The mask_kernel probe reports the
+// width in bytes.
+constinit dispatch::Dispatcher maskKernels
+{ "websocket::encodeMaskedPayload"
+, std::array
+  { dispatch::Candidate<MaskFunction>{ dispatch::Tier::eBaseline, "baseline", 16, maskPayload16 }
+#if defined( __x86_64__ ) || defined( __i386__ )
+  , dispatch::Candidate<MaskFunction>{ dispatch::Tier::eAvx2, "avx2", 32, maskPayload32 }
+  , dispatch::Candidate<MaskFunction>{ dispatch::Tier::eAvx512, "avx512", 64, maskPayload64 }
+#endif
+  }
+};
+dispatch::SelectAtLoad maskKernelsAtLoad{ maskKernels };
+
+
+} // End of anonymous namespace
+
+
 struct Decoder::Private
 {
   Private( size_t cacheReserveSize )
@@ -42,8 +90,27 @@ struct Decoder::Private
 
   Decoder::Result decode( const char* p, size_t numBytes );
 
+  // One frame at most, with the bookkeeping common to all the decode methods.
+  // On eFrame view's payload is still masked and points either into p or
+  // into partialData, where it stays until the next step.
+  Step step( const char*& p
+           , size_t& numBytes
+           , FrameView& view
+           , std::chrono::steady_clock::time_point now );
+  Step advance( const char*& p
+              , size_t& numBytes
+              , FrameView& view
+              , std::chrono::steady_clock::time_point now );
+
+  // As step but the payload is copied and unmasked into frame.
+  Step step( const char*& p
+           , size_t& numBytes
+           , Frame& frame
+           , std::chrono::steady_clock::time_point now );
+
   bool decodeHeader( const char*& buffer, size_t& numBufferBytes );
-  bool decodePayload( const char*& buffer, size_t& numBufferBytes );
+
+  void cache( const char* p, size_t numBytes );
 
   enum class Status
   {
@@ -58,15 +125,23 @@ struct Decoder::Private
       This will either be enitrely header data or entirely payload data. If
       the latter then the header wiil be stored in \a header.
 
-      We want to be able to mask the payload data in place so we cannot use a
-      a std::string, instead use a std::vector as that will give us non-const
-      access to the contiguous memory.
+      Only the bytes that belong to the pending header or payload are ever
+      copied in, anything after is decoded from the caller's buffer. Decoding
+      therefore never reads from this while also appending to it.
+
+      A payload completed here is handed out in place so is only cleared at
+      the start of the following step.
    */
   std::vector<char> partialData;
+  bool isPartialDataSpent{ false };
 
   // Only valid once we get to ePartialPayload
   Header header;
-  std::string payload;
+
+  Stats stats;
+
+  bool isRecordingFirstByteTimes{ false };
+  std::chrono::steady_clock::time_point firstByteTime;
 };
 
 
@@ -340,93 +415,279 @@ Decoder::Result Decoder::decode( const char* p, size_t numBytes )
   return d->decode( p, numBytes );
 }
 
+Decoder::Step Decoder::decodeNext( const char*& src, size_t& numSrcBytes, Frame& frame )
+{
+  const auto now{ d->isRecordingFirstByteTimes ? std::chrono::steady_clock::now()
+                                               : std::chrono::steady_clock::time_point{} };
+  return d->step( src, numSrcBytes, frame, now );
+}
+
+Decoder::Step Decoder::decodeNextView( const char*& src, size_t& numSrcBytes, FrameView& view )
+{
+  const auto now{ d->isRecordingFirstByteTimes ? std::chrono::steady_clock::now()
+                                               : std::chrono::steady_clock::time_point{} };
+  return d->step( src, numSrcBytes, view, now );
+}
+
+// static
+std::string Decoder::toString( Step step )
+{
+  switch ( step )
+  {
+  case Step::eFrame:
+    return "Frame";
+  case Step::eNeedMore:
+    return "NeedMore";
+  case Step::eParseError:
+    return "ParseError";
+  }
+  return "Unknown";
+}
+
+void Decoder::setRecordFirstByteTimes( bool record )
+{
+  d->isRecordingFirstByteTimes = record;
+}
+
+bool Decoder::hasPartialFrame() const
+{
+  return d->status != Private::Status::eNothing;
+}
+
+const Decoder::Stats& Decoder::stats() const
+{
+  return d->stats;
+}
+
+// static
+bool Decoder::statsEnabled()
+{
+#ifdef LB_ENCODING_WEBSOCKET_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+Decoder::Stats& Decoder::Stats::operator+=( const Stats& rhs )
+{
+  numBytesIn += rhs.numBytesIn;
+  for ( size_t i = 0; i < std::size( numFrames ); ++i )
+  {
+    numFrames[i] += rhs.numFrames[i];
+  }
+  numPartialHeaders  += rhs.numPartialHeaders;
+  numPartialPayloads += rhs.numPartialPayloads;
+  numBytesCopied     += rhs.numBytesCopied;
+  peakBufferedBytes = std::max( peakBufferedBytes, rhs.peakBufferedBytes );
+  for ( size_t i = 0; i < std::size( numParseErrors ); ++i )
+  {
+    numParseErrors[i] += rhs.numParseErrors[i];
+  }
+  return *this;
+}
+
 Decoder::Result Decoder::Private::decode( const char* p, size_t numBytes )
 {
   Result result;
 
+  const auto now{ isRecordingFirstByteTimes ? std::chrono::steady_clock::now()
+                                            : std::chrono::steady_clock::time_point{} };
+
+  // Where the bytes after the last complete frame start.
+  const char* extraStart{ p };
+  Frame frame;
+
+  while ( numBytes > 0 )
+  {
+    const Status statusBefore{ status };
+
+    switch ( step( p, numBytes, frame, now ) )
+    {
+    case Step::eFrame:
+      result.frames.push_back( std::move( frame ) );
+      result.numExtra = 0;
+      extraStart = p;
+      break;
+
+    case Step::eNeedMore:
+      // Once a header is complete only the payload bytes count as extra.
+      result.numExtra = ( status == Status::ePartialPayload && statusBefore != Status::ePartialPayload )
+                      ? partialData.size()
+                      : size_t( p - extraStart );
+      break;
+
+    case Step::eParseError:
+      result.parseError = true;
+      result.numExtra = numBytes;
+      return result;
+    }
+  }
+
+  return result;
+}
+
+Decoder::Step Decoder::Private::step( const char*& p
+                                    , size_t& numBytes
+                                    , FrameView& view
+                                    , std::chrono::steady_clock::time_point now )
+{
+  if ( isPartialDataSpent )
+  {
+    partialData.clear();
+    isPartialDataSpent = false;
+  }
+
+  if ( numBytes == 0 )
+  {
+    return Step::eNeedMore;
+  }
+
+  const char* const start{ p };
+  const Step result{ advance( p, numBytes, view, now ) };
+
+  // After a parse error the remaining bytes are of no use to anyone but they
+  // were still passed in.
+  WEBSOCKET_STATS( stats.numBytesIn += ( p - start ) + ( result == Step::eParseError ? numBytes : 0 ) );
+
+  if ( result == Step::eFrame )
+  {
+    WEBSOCKET_STATS( ++stats.numFrames[ size_t( header.opCode ) ] );
+    LB_PROBE2( frame_complete, int( header.opCode ), header.payloadSize );
+  }
+  else if ( result == Step::eNeedMore )
+  {
+    WEBSOCKET_STATS( stats.numPartialHeaders  += ( status == Status::ePartialHeader  ) );
+    WEBSOCKET_STATS( stats.numPartialPayloads += ( status == Status::ePartialPayload ) );
+
+    if ( status == Status::ePartialHeader )
+    {
+      LB_PROBE1( partial_header, partialData.size() );
+    }
+    else
+    {
+      LB_PROBE3( partial_payload, int( header.opCode ), header.payloadSize, partialData.size() );
+    }
+  }
+
+  return result;
+}
+
+Decoder::Step Decoder::Private::step( const char*& p
+                                    , size_t& numBytes
+                                    , Frame& frame
+                                    , std::chrono::steady_clock::time_point now )
+{
+  FrameView view;
+  const Step result{ step( p, numBytes, view, now ) };
+  if ( result == Step::eFrame )
+  {
+    frame.header = view.header;
+    frame.firstByteTime = view.firstByteTime;
+    if ( view.header.isMasked )
+    {
+      frame.payload.resize( view.header.payloadSize );
+      decodeMaskedPayload( view.payload, view.header.payloadSize, view.header.mask, frame.payload.data() );
+    }
+    else
+    {
+      frame.payload.assign( view.payload, view.header.payloadSize );
+    }
+  }
+  return result;
+}
+
+Decoder::Step Decoder::Private::advance( const char*& p
+                                       , size_t& numBytes
+                                       , FrameView& view
+                                       , std::chrono::steady_clock::time_point now )
+{
   try
   {
-    while ( numBytes > 0 )
+    switch ( status )
     {
-      switch( status )
+    case Status::eNothing:
+      firstByteTime = now;
+      if ( !decodeHeader( p, numBytes ) )
       {
-      case Status::eNothing:
-        if ( !decodeHeader( p, numBytes ) )
-        {
-          status = Status::ePartialHeader;
-          partialData.insert( partialData.end(), p, p + numBytes );
-          result.numExtra = numBytes;
-          numBytes = 0;
-          continue;
-        }
-        if ( !decodePayload( p, numBytes ) )
-        {
-          status = Status::ePartialPayload;
-          partialData.insert( partialData.end(), p, p + numBytes );
-          result.numExtra = numBytes;
-          numBytes = 0;
-          continue;
-        }
-        break;
-
-      case Status::ePartialHeader:
-        partialData.insert( partialData.end(), p, p + numBytes );
-        p = &partialData[0];
-        result.numExtra = numBytes;
-        numBytes = partialData.size();
-        if ( !decodeHeader( p, numBytes ) )
-        {
-          numBytes = 0;
-          continue;
-        }
-        result.numExtra = numBytes;
-        if ( !decodePayload( p, numBytes ) )
-        {
-          // Remove the header bytes from partialData so that it contains just
-          // the partial payload.
-          std::vector<char> tmpPartial;
-          tmpPartial.insert( tmpPartial.end(), p, p + numBytes );
-          partialData.clear();
-          partialData.swap( tmpPartial );
-
-          status = Status::ePartialPayload;
-          result.numExtra = numBytes;
-          numBytes = 0;
-          continue;
-        }
-        break;
-
-      case Status::ePartialPayload:
-        partialData.insert( partialData.end(), p, p + numBytes );
-        p = &partialData[0];
-        result.numExtra = numBytes;
-        numBytes = partialData.size();
-        if ( !decodePayload( p, numBytes ) )
-        {
-          numBytes = 0;
-          continue;
-        }
-        break;
+        status = Status::ePartialHeader;
+        cache( p, numBytes );
+        p += numBytes;
+        numBytes = 0;
+        return Step::eNeedMore;
       }
+      break;
 
-      // Any code path that did not produce a full frame did a continue so if
-      // we got here, i.e. from a switch break, then we have a full frame.
+    case Status::ePartialHeader:
+    {
+      // Top up the cached header bytes, never beyond the longest possible
+      // header, and decode from the cache. The header's bytes are then
+      // skipped in p and everything after is decoded in place.
+      const size_t numCached{ partialData.size() };
+      const size_t numTaken{ std::min( numBytes, Header::maxSizeInBytes - numCached ) };
+      cache( p, numTaken );
+      const char* cached{ partialData.data() };
+      size_t numCachedBytes{ partialData.size() };
+      if ( !decodeHeader( cached, numCachedBytes ) )
+      {
+        p        += numTaken;
+        numBytes -= numTaken;
+        return Step::eNeedMore;
+      }
+      const size_t numUsed{ header.encodedSizeInBytes() - numCached };
+      p        += numUsed;
+      numBytes -= numUsed;
       partialData.clear();
+      break;
+    }
+
+    case Status::ePartialPayload:
+    {
+      const size_t numTaken( std::min<uint64_t>( numBytes, header.payloadSize - partialData.size() ) );
+      cache( p, numTaken );
+      p        += numTaken;
+      numBytes -= numTaken;
+      if ( partialData.size() < header.payloadSize )
+      {
+        return Step::eNeedMore;
+      }
+      view.payload = partialData.data();
+      isPartialDataSpent = true;
       status = Status::eNothing;
-      result.numExtra = 0;
+      view.header = header;
+      view.firstByteTime = firstByteTime;
+      return Step::eFrame;
+    }
+    }
 
-      result.frames.emplace_back();
-      std::swap( result.frames.back().header,  header );
-      std::swap( result.frames.back().payload, payload );
+    if ( numBytes < header.payloadSize )
+    {
+      status = Status::ePartialPayload;
+      cache( p, numBytes );
+      p += numBytes;
+      numBytes = 0;
+      return Step::eNeedMore;
     }
+    view.payload = p;
+    p        += header.payloadSize;
+    numBytes -= header.payloadSize;
+    status = Status::eNothing;
+    view.header = header;
+    view.firstByteTime = firstByteTime;
+    return Step::eFrame;
   }
   catch( const std::runtime_error& e )
   {
-    result.parseError = true;
-    result.numExtra = numBytes;
+    return Step::eParseError;
   }
+}
 
-  return result;
+void Decoder::Private::cache( const char* p, size_t numBytes )
+{
+  partialData.insert( partialData.end(), p, p + numBytes );
+
+  WEBSOCKET_STATS( stats.numBytesCopied += numBytes );
+  WEBSOCKET_STATS( stats.peakBufferedBytes = std::max<uint64_t>( stats.peakBufferedBytes, partialData.size() ) );
 }
 
 // Buffer and numBufferBytes only incremented on a true return
@@ -437,13 +698,20 @@ bool Decoder::Private::decodeHeader( const char*& buffer, size_t& numBufferBytes
   case Header::DecodeResult::eIncomplete:
     break;
   case Header::DecodeResult::eInvalidOpCode:
+    WEBSOCKET_STATS( ++stats.numParseErrors[ size_t( Header::DecodeResult::eInvalidOpCode ) ] );
+    LB_PROBE2( parse_error, int( Header::DecodeResult::eInvalidOpCode ), numBufferBytes );
     throw std::runtime_error{ "Failed to deserialise frame header. Invalid op code." };
   case Header::DecodeResult::ePayloadSizeInflatedEncoding:
+    WEBSOCKET_STATS( ++stats.numParseErrors[ size_t( Header::DecodeResult::ePayloadSizeInflatedEncoding ) ] );
+    LB_PROBE2( parse_error, int( Header::DecodeResult::ePayloadSizeInflatedEncoding ), numBufferBytes );
     throw std::runtime_error{ "Failed to deserialise frame header. Payload size using inflated encoding." };
   case Header::DecodeResult::ePayloadSizeEighthByteMSBNotZero:
+    WEBSOCKET_STATS( ++stats.numParseErrors[ size_t( Header::DecodeResult::ePayloadSizeEighthByteMSBNotZero ) ] );
+    LB_PROBE2( parse_error, int( Header::DecodeResult::ePayloadSizeEighthByteMSBNotZero ), numBufferBytes );
     throw std::runtime_error{ "Failed to deserialise frame header. Eight byte payload size most signigicant bit is non-zero." };
   case Header::DecodeResult::eSuccess:
   {
+    LB_PROBE3( frame_start, int( header.opCode ), header.payloadSize, header.isMasked );
     const auto numHeaderBytes{ header.encodedSizeInBytes() };
     buffer += numHeaderBytes;
     numBufferBytes -= numHeaderBytes;
@@ -454,47 +722,14 @@ bool Decoder::Private::decodeHeader( const char*& buffer, size_t& numBufferBytes
   return false;
 }
 
-// Buffer and numBufferBytes only incremented on a true return
-bool Decoder::Private::decodePayload( const char*& buffer, size_t& numBufferBytes )
-{
-  if ( numBufferBytes < header.payloadSize )
-  {
-    return false;
-  }
-
-  // Take a (single) copy of the bytes.
-  payload.assign( buffer, header.payloadSize );
-
-  if ( header.isMasked )
-  {
-    encodeMaskedPayload( payload, header.mask );
-  }
-
-  buffer         += header.payloadSize;
-  numBufferBytes -= header.payloadSize;
-
-  return true;
-}
-
 void encodeMaskedPayload( const char* src
                         , size_t numSrcChars
                         , const uint8_t mask[4]
                         , char* dst )
 {
-  const size_t numTrailingBytes{ numSrcChars % 4 };
-  const size_t numQuartets{ ( numSrcChars - numTrailingBytes ) / 4 };
-  for ( size_t q = 0; q < numQuartets; ++q )
-  {
-    *dst = *src ^ mask[0]; ++src; ++dst;
-    *dst = *src ^ mask[1]; ++src; ++dst;
-    *dst = *src ^ mask[2]; ++src; ++dst;
-    *dst = *src ^ mask[3]; ++src; ++dst;
-  }
-
-  for ( size_t t = 0; t < numTrailingBytes; ++t, ++src, ++dst )
-  {
-    *dst = *src ^ mask[t];
-  }
+  const auto& kernel{ maskKernels.get() };
+  LB_PROBE2( mask_kernel, kernel.id, numSrcChars );
+  kernel.function( src, numSrcChars, mask, dst );
 }
 
 void decodeMaskedPayload( const char* src
@@ -508,21 +743,7 @@ void decodeMaskedPayload( const char* src
 void encodeMaskedPayload( std::string& src
                         , const uint8_t mask[4] )
 {
-  const size_t numTrailingBytes{ src.size() % 4 };
-  const size_t numQuartets{ ( src.size() - numTrailingBytes ) / 4 };
-  size_t i = 0;
-  for ( size_t q = 0; q < numQuartets; ++q )
-  {
-    src[i] = src[i] ^ mask[0]; ++i;
-    src[i] = src[i] ^ mask[1]; ++i;
-    src[i] = src[i] ^ mask[2]; ++i;
-    src[i] = src[i] ^ mask[3]; ++i;
-  }
-
-  for ( size_t t = 0; t < numTrailingBytes; ++t, ++i )
-  {
-    src[i] = src[i] ^ mask[t];
-  }
+  encodeMaskedPayload( src.data(), src.size(), mask, src.data() );
 }
 
 void decodeMaskedPayload( std::string& src
@@ -539,15 +760,11 @@ std::string encodeMaskedPayload( const std::string& src
     return {};
   }
 
-  std::unique_ptr<char[]> dst{ std::make_unique<char[]>( src.size() ) };
+  std::string dst( src.size(), '\0' );
 
-  encodeMaskedPayload( src.c_str(), src.size(), mask, dst.get() );
+  encodeMaskedPayload( src.c_str(), src.size(), mask, dst.data() );
 
-  // std::string always takes a copy. Understandable, but unfortunate here. If
-  // only there was some sort of move semantics for passing C-style string
-  // ownership to std::string. Of course we provide the in-place overload so
-  // only use this if you really want a copy.
-  return { dst.get(), src.size() };
+  return dst;
 }
 
 std::string decodeMaskedPayload( const std::string& src
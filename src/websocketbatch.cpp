@@ -0,0 +1,196 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketbatch.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+FrameBatcher::FrameBatcher( size_t flushThreshold )
+  : flushThreshold{ flushThreshold }
+{
+}
+
+// static
+std::string FrameBatcher::toString( Status status )
+{
+  switch ( status )
+  {
+  case Status::eComplete:
+    return "Complete";
+  case Status::eWouldBlock:
+    return "WouldBlock";
+  case Status::eError:
+    return "Error";
+  }
+  return "Unknown";
+}
+
+char* FrameBatcher::reserve( size_t numBytes )
+{
+  if ( end + numBytes <= capacity )
+  {
+    return storage.get() + end;
+  }
+
+  // Slide the unwritten bytes down to the start before considering growing.
+  if ( begin > 0 )
+  {
+    std::memmove( storage.get(), storage.get() + begin, end - begin );
+    for ( size_t i = firstFrame; i < frameEnds.size(); ++i )
+    {
+      frameEnds[i] -= begin;
+    }
+    frameEnds.erase( frameEnds.begin(), frameEnds.begin() + firstFrame );
+    firstFrame = 0;
+    end -= begin;
+    begin = 0;
+
+    if ( end + numBytes <= capacity )
+    {
+      return storage.get() + end;
+    }
+  }
+
+  size_t newCapacity{ capacity > 0 ? 2 * capacity : 4096 };
+  while ( newCapacity < end + numBytes )
+  {
+    newCapacity *= 2;
+  }
+  std::unique_ptr<char[]> newStorage{ new char[ newCapacity ] };
+  if ( end > 0 )
+  {
+    std::memcpy( newStorage.get(), storage.get(), end );
+  }
+  storage = std::move( newStorage );
+  capacity = newCapacity;
+
+  return storage.get() + end;
+}
+
+bool FrameBatcher::append( const Header& header, const char* payload )
+{
+  const size_t numHeaderBytes{ header.encodedSizeInBytes() };
+  char* dst{ reserve( numHeaderBytes + header.payloadSize ) };
+
+  header.encode( dst );
+  dst += numHeaderBytes;
+  if ( header.isMasked )
+  {
+    encodeMaskedPayload( payload, header.payloadSize, header.mask, dst );
+  }
+  else if ( header.payloadSize > 0 )
+  {
+    std::memcpy( dst, payload, header.payloadSize );
+  }
+
+  end += numHeaderBytes + header.payloadSize;
+  frameEnds.push_back( end );
+
+  return isFlushDue();
+}
+
+bool FrameBatcher::append( const Header& header, const std::string& payload )
+{
+  if ( payload.size() != header.payloadSize )
+  {
+    throw std::invalid_argument( "FrameBatcher payload size does not match its header" );
+  }
+  return append( header, payload.data() );
+}
+
+size_t FrameBatcher::consume( size_t numBytes )
+{
+  begin += std::min( numBytes, size() );
+
+  // Frames complete in order so only the front of the queue need be checked.
+  const size_t numFramesBefore{ numFrames() };
+  while ( firstFrame < frameEnds.size() && frameEnds[ firstFrame ] <= begin )
+  {
+    ++firstFrame;
+  }
+  const size_t numFramesCompleted{ numFramesBefore - numFrames() };
+
+  if ( begin == end )
+  {
+    clear();
+  }
+
+  return numFramesCompleted;
+}
+
+FrameBatcher::Status FrameBatcher::flush( int socketFd, size_t* numFramesWritten )
+{
+  size_t numFramesCompleted{ 0 };
+  Status status{ Status::eComplete };
+
+  while ( !empty() )
+  {
+    const ssize_t n{ ::send( socketFd, data(), size(), MSG_NOSIGNAL ) };
+    if ( n < 0 )
+    {
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+      status = ( errno == EAGAIN || errno == EWOULDBLOCK ) ? Status::eWouldBlock
+                                                           : Status::eError;
+      break;
+    }
+    numFramesCompleted += consume( n );
+  }
+
+  if ( numFramesWritten )
+  {
+    *numFramesWritten = numFramesCompleted;
+  }
+  return status;
+}
+
+void FrameBatcher::clear()
+{
+  begin = 0;
+  end = 0;
+  frameEnds.clear();
+  firstFrame = 0;
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
@@ -0,0 +1,281 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketgroup.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+// The jobs [begin,end) still to be done by one thread, packed into one word
+// so that the owner taking from the front and thieves taking from the back
+// can both do so with a single compare and swap.
+struct alignas( 64 ) JobRun
+{
+  static uint64_t pack( uint32_t begin, uint32_t end ) { return uint64_t( begin ) << 32 | end; }
+  static uint32_t begin( uint64_t run ) { return uint32_t( run >> 32 ); }
+  static uint32_t end( uint64_t run ) { return uint32_t( run ); }
+
+  std::atomic<uint64_t> run{ 0 };
+};
+
+
+struct DecoderGroup::Private
+{
+  Private( size_t numThreads );
+  ~Private();
+
+  void work( size_t self );
+  bool takeFront( size_t self, uint32_t& job );
+  bool steal( size_t self );
+  void worker( size_t self );
+
+  const size_t numThreads;
+  std::unique_ptr<JobRun[]> runs;
+
+  // The current batch.
+  const Job* jobs{ nullptr };
+  Decoder::Result* results{ nullptr };
+  std::exception_ptr exception;
+  std::mutex exceptionMutex;
+
+  // Wakes the pool for each batch. Every pool thread checks in to every
+  // batch so that none is still looking at one when the next is set up.
+  std::mutex mutex;
+  std::condition_variable startBatch;
+  std::condition_variable batchDone;
+  uint64_t generation{ 0 };
+  size_t numBusy{ 0 };
+  bool isStopping{ false };
+
+  std::vector<std::thread> threads;
+};
+
+DecoderGroup::Private::Private( size_t numThreads )
+  : numThreads{ numThreads }
+  , runs{ new JobRun[ numThreads ] }
+{
+  threads.reserve( numThreads - 1 );
+  for ( size_t i = 1; i < numThreads; ++i )
+  {
+    threads.emplace_back( &Private::worker, this, i );
+  }
+}
+
+DecoderGroup::Private::~Private()
+{
+  {
+    std::lock_guard lock{ mutex };
+    isStopping = true;
+  }
+  startBatch.notify_all();
+  for ( auto& thread : threads )
+  {
+    thread.join();
+  }
+}
+
+bool DecoderGroup::Private::takeFront( size_t self, uint32_t& job )
+{
+  std::atomic<uint64_t>& run{ runs[ self ].run };
+  uint64_t current{ run.load( std::memory_order_acquire ) };
+  while ( JobRun::begin( current ) < JobRun::end( current ) )
+  {
+    if ( run.compare_exchange_weak( current
+                                  , JobRun::pack( JobRun::begin( current ) + 1, JobRun::end( current ) )
+                                  , std::memory_order_acq_rel ) )
+    {
+      job = JobRun::begin( current );
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DecoderGroup::Private::steal( size_t self )
+{
+  for ( size_t i = 1; i < numThreads; ++i )
+  {
+    std::atomic<uint64_t>& victim{ runs[ ( self + i ) % numThreads ].run };
+    uint64_t current{ victim.load( std::memory_order_acquire ) };
+    while ( JobRun::begin( current ) < JobRun::end( current ) )
+    {
+      const uint32_t begin{ JobRun::begin( current ) };
+      const uint32_t end{ JobRun::end( current ) };
+      const uint32_t middle{ end - ( end - begin + 1 ) / 2 };
+      if ( victim.compare_exchange_weak( current
+                                       , JobRun::pack( begin, middle )
+                                       , std::memory_order_acq_rel ) )
+      {
+        // Our own run is empty so no thief can be changing it.
+        runs[ self ].run.store( JobRun::pack( middle, end ), std::memory_order_release );
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void DecoderGroup::Private::work( size_t self )
+{
+  do
+  {
+    uint32_t job;
+    while ( takeFront( self, job ) )
+    {
+      try
+      {
+        results[ job ] = jobs[ job ].decoder->decode( jobs[ job ].src, jobs[ job ].numSrcBytes );
+      }
+      catch ( ... )
+      {
+        std::lock_guard lock{ exceptionMutex };
+        if ( !exception )
+        {
+          exception = std::current_exception();
+        }
+      }
+    }
+  }
+  while ( steal( self ) );
+}
+
+void DecoderGroup::Private::worker( size_t self )
+{
+  uint64_t seen{ 0 };
+  while ( true )
+  {
+    {
+      std::unique_lock lock{ mutex };
+      startBatch.wait( lock, [&]() { return isStopping || generation != seen; } );
+      if ( isStopping )
+      {
+        return;
+      }
+      seen = generation;
+    }
+
+    work( self );
+
+    bool isLast;
+    {
+      std::lock_guard lock{ mutex };
+      isLast = --numBusy == 0;
+    }
+    if ( isLast )
+    {
+      batchDone.notify_one();
+    }
+  }
+}
+
+
+DecoderGroup::DecoderGroup( size_t numThreads )
+  : d{ std::make_unique<Private>( numThreads > 0 ? numThreads
+                                                 : std::max( 1U, std::thread::hardware_concurrency() ) ) }
+{
+}
+
+DecoderGroup::~DecoderGroup() = default;
+
+size_t DecoderGroup::numThreads() const
+{
+  return d->numThreads;
+}
+
+void DecoderGroup::decode( const std::vector<Job>& jobs, std::vector<Decoder::Result>& results )
+{
+  if ( jobs.size() > UINT32_MAX )
+  {
+    throw std::length_error( "DecoderGroup batch too big" );
+  }
+
+  results.resize( jobs.size() );
+  if ( jobs.empty() )
+  {
+    return;
+  }
+
+  d->jobs = jobs.data();
+  d->results = results.data();
+  d->exception = nullptr;
+
+  // Contiguous runs so that neighbouring jobs, and results, stay together.
+  const size_t numThreads{ d->numThreads };
+  for ( size_t i = 0; i < numThreads; ++i )
+  {
+    d->runs[ i ].run.store( JobRun::pack( uint32_t( jobs.size() * i / numThreads )
+                                        , uint32_t( jobs.size() * ( i + 1 ) / numThreads ) )
+                          , std::memory_order_relaxed );
+  }
+
+  if ( numThreads > 1 )
+  {
+    {
+      std::lock_guard lock{ d->mutex };
+      ++d->generation;
+      d->numBusy = numThreads - 1;
+    }
+    d->startBatch.notify_all();
+  }
+
+  d->work( 0 );
+
+  if ( numThreads > 1 )
+  {
+    std::unique_lock lock{ d->mutex };
+    d->batchDone.wait( lock, [this]() { return d->numBusy == 0; } );
+  }
+
+  if ( d->exception )
+  {
+    std::rethrow_exception( d->exception );
+  }
+}
+
+std::vector<Decoder::Result> DecoderGroup::decode( const std::vector<Job>& jobs )
+{
+  std::vector<Decoder::Result> results;
+  decode( jobs, results );
+  return results;
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
@@ -0,0 +1,529 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websockethandshake.h>
+#include <lb/encoding/base64.h>
+
+#include "sha1block.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+namespace handshake
+{
+
+
+constexpr char guid[ 36 ]
+{
+  '2', '5', '8', 'E', 'A', 'F', 'A', '5', '-',
+  'E', '9', '1', '4', '-',
+  '4', '7', 'D', 'A', '-',
+  '9', '5', 'C', 'A', '-',
+  'C', '5', 'A', 'B', '0', 'D', 'C', '8', '5', 'B', '1', '1'
+};
+
+
+namespace
+{
+
+
+/** \brief Finds the first carriage return in [p, end).
+    \return A pointer to the carriage return or \a end if there is none.
+
+    Header lines are typically a few tens of bytes so checking sixteen at a
+    time saves a good deal of branching over a byte by byte loop.
+ */
+const char* findCarriageReturn( const char* p, const char* end )
+{
+#ifdef __SSE2__
+  const __m128i cr{ _mm_set1_epi8( '\r' ) };
+  for ( ; end - p >= 16; p += 16 )
+  {
+    const __m128i chunk{ _mm_loadu_si128( (const __m128i*)p ) };
+    const int matches{ _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, cr ) ) };
+    if ( matches != 0 )
+    {
+      return p + __builtin_ctz( matches );
+    }
+  }
+#endif
+  for ( ; p < end; ++p )
+  {
+    if ( *p == '\r' )
+    {
+      return p;
+    }
+  }
+  return end;
+}
+
+char toLower( char c )
+{
+  return ( c >= 'A' && c <= 'Z' ) ? c + ( 'a' - 'A' ) : c;
+}
+
+/** \brief Case insensitive comparison of \a s to \a lower which must already
+           be in lower case.
+ */
+bool equalsLower( std::string_view s, std::string_view lower )
+{
+  if ( s.size() != lower.size() )
+  {
+    return false;
+  }
+  for ( size_t i = 0; i < s.size(); ++i )
+  {
+    if ( toLower( s[i] ) != lower[i] )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool isWhitespace( char c )
+{
+  return c == ' ' || c == '\t';
+}
+
+std::string_view trim( std::string_view s )
+{
+  while ( !s.empty() && isWhitespace( s.front() ) )
+  {
+    s.remove_prefix( 1 );
+  }
+  while ( !s.empty() && isWhitespace( s.back() ) )
+  {
+    s.remove_suffix( 1 );
+  }
+  return s;
+}
+
+/** \brief Whether the comma separated list \a list contains \a lowerToken,
+           ignoring case.
+ */
+bool containsToken( std::string_view list, std::string_view lowerToken )
+{
+  while ( !list.empty() )
+  {
+    const size_t comma{ list.find( ',' ) };
+    if ( equalsLower( trim( list.substr( 0, comma ) ), lowerToken ) )
+    {
+      return true;
+    }
+    if ( comma == std::string_view::npos )
+    {
+      break;
+    }
+    list.remove_prefix( comma + 1 );
+  }
+  return false;
+}
+
+bool isBase64( char c )
+{
+  return ( c >= 'A' && c <= 'Z' )
+      || ( c >= 'a' && c <= 'z' )
+      || ( c >= '0' && c <= '9' )
+      || c == '+' || c == '/';
+}
+
+/** \brief A valid key is 16 bytes base64 encoded, which is always 22 base64
+           characters followed by two padding characters.
+ */
+bool isValidKey( std::string_view key )
+{
+  if ( key.size() != keySize || key[22] != '=' || key[23] != '=' )
+  {
+    return false;
+  }
+  for ( size_t i = 0; i < 22; ++i )
+  {
+    if ( !isBase64( key[i] ) )
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** \brief Stores \a value in the \a request field for the header \a name, if
+           it is one we are interested in.
+
+    Switching on the length first means most names are rejected or matched
+    with a single comparison.
+ */
+void storeHeader( std::string_view name, std::string_view value, Request& request )
+{
+  switch ( name.size() )
+  {
+  case 4:
+    if ( equalsLower( name, "host" ) )
+    {
+      request.host = value;
+    }
+    break;
+  case 6:
+    if ( equalsLower( name, "origin" ) )
+    {
+      request.origin = value;
+    }
+    break;
+  case 7:
+    if ( equalsLower( name, "upgrade" ) )
+    {
+      request.upgrade = value;
+    }
+    break;
+  case 10:
+    if ( equalsLower( name, "connection" ) )
+    {
+      request.connection = value;
+    }
+    break;
+  case 17:
+    if ( equalsLower( name, "sec-websocket-key" ) )
+    {
+      request.key = value;
+    }
+    break;
+  case 21:
+    if ( equalsLower( name, "sec-websocket-version" ) )
+    {
+      request.version = value;
+    }
+    break;
+  case 22:
+    if ( equalsLower( name, "sec-websocket-protocol" ) )
+    {
+      request.protocols = value;
+    }
+    break;
+  case 24:
+    if ( equalsLower( name, "sec-websocket-extensions" ) )
+    {
+      request.extensions = value;
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+std::string toString( ParseResult pr )
+{
+  switch ( pr )
+  {
+  case ParseResult::eSuccess:
+    return "Success";
+  case ParseResult::eIncomplete:
+    return "Incomplete";
+  case ParseResult::eMalformed:
+    return "Malformed";
+  case ParseResult::eNotGet:
+    return "NotGet";
+  case ParseResult::eMissingHost:
+    return "MissingHost";
+  case ParseResult::eNotUpgrade:
+    return "NotUpgrade";
+  case ParseResult::eNotConnectionUpgrade:
+    return "NotConnectionUpgrade";
+  case ParseResult::eInvalidKey:
+    return "InvalidKey";
+  case ParseResult::eUnsupportedVersion:
+    return "UnsupportedVersion";
+  }
+  return "Unknown";
+}
+
+ParseResult parse( const char* src, size_t numSrcBytes, Request& request )
+{
+  request = Request{};
+
+  const char* p{ src };
+  const char* const end{ src + numSrcBytes };
+
+  // Request line
+  const char* cr{ findCarriageReturn( p, end ) };
+  if ( end - cr < 2 )
+  {
+    return ParseResult::eIncomplete;
+  }
+  if ( cr[1] != '\n' )
+  {
+    return ParseResult::eMalformed;
+  }
+  {
+    std::string_view line( p, cr - p );
+    const size_t firstSpace{ line.find( ' ' ) };
+    const size_t lastSpace{ line.rfind( ' ' ) };
+    if ( firstSpace == std::string_view::npos || firstSpace == lastSpace )
+    {
+      return ParseResult::eMalformed;
+    }
+    request.method = line.substr( 0, firstSpace );
+    request.target = line.substr( firstSpace + 1, lastSpace - firstSpace - 1 );
+    if ( line.substr( lastSpace + 1 ) != "HTTP/1.1" || request.target.empty() )
+    {
+      return ParseResult::eMalformed;
+    }
+  }
+  p = cr + 2;
+
+  // Header lines up to and including the empty line
+  while ( true )
+  {
+    cr = findCarriageReturn( p, end );
+    if ( end - cr < 2 )
+    {
+      return ParseResult::eIncomplete;
+    }
+    if ( cr[1] != '\n' )
+    {
+      return ParseResult::eMalformed;
+    }
+    if ( cr == p )
+    {
+      p = cr + 2;
+      break;
+    }
+
+    std::string_view line( p, cr - p );
+    const size_t colon{ line.find( ':' ) };
+    // Obsolete line folding is not permitted, nor is whitespace before the
+    // colon (RFC 7230 Section 3.2.4).
+    if ( colon == std::string_view::npos || colon == 0 || isWhitespace( line[0] )
+      || isWhitespace( line[ colon - 1 ] ) )
+    {
+      return ParseResult::eMalformed;
+    }
+    storeHeader( line.substr( 0, colon ), trim( line.substr( colon + 1 ) ), request );
+
+    p = cr + 2;
+  }
+  request.numBytes = p - src;
+
+  // Now check we have everything RFC 6455 Section 4.2.1 requires.
+  if ( request.method != "GET" )
+  {
+    return ParseResult::eNotGet;
+  }
+  if ( request.host.empty() )
+  {
+    return ParseResult::eMissingHost;
+  }
+  if ( !containsToken( request.upgrade, "websocket" ) )
+  {
+    return ParseResult::eNotUpgrade;
+  }
+  if ( !containsToken( request.connection, "upgrade" ) )
+  {
+    return ParseResult::eNotConnectionUpgrade;
+  }
+  if ( !isValidKey( request.key ) )
+  {
+    return ParseResult::eInvalidKey;
+  }
+  if ( request.version != "13" )
+  {
+    return ParseResult::eUnsupportedVersion;
+  }
+
+  return ParseResult::eSuccess;
+}
+
+// The accept key is always the SHA1 of the 24 character key followed by the
+// 36 character GUID. That is 60 bytes, so with the padding byte and the length
+// word it always occupies exactly two chunks:
+//
+//   chunk 0: key (words 0-5), GUID (words 6-14), 0x80000000 (word 15)
+//   chunk 1: zeros (words 0-13), message length of 480 bits (words 14-15)
+//
+// Everything except the key is known at compile time, so rather than go via
+// the general purpose sha1::encode we fold the constant parts in here.
+
+constexpr size_t acceptKeyMessageSize{ keySize + sizeof(guid) };
+static_assert( acceptKeyMessageSize == 60, "Accept key message must fit two chunks" );
+
+constexpr uint32_t guidWord( size_t i )
+{
+  return ( uint32_t( (unsigned char)guid[ 4*i     ] ) << 24 )
+       | ( uint32_t( (unsigned char)guid[ 4*i + 1 ] ) << 16 )
+       | ( uint32_t( (unsigned char)guid[ 4*i + 2 ] ) <<  8 )
+       |   uint32_t( (unsigned char)guid[ 4*i + 3 ] );
+}
+
+//! Words 6-15 of chunk 0.
+constexpr uint32_t acceptKeyConstantWords[10]
+{
+  guidWord( 0 ), guidWord( 1 ), guidWord( 2 ), guidWord( 3 ), guidWord( 4 ),
+  guidWord( 5 ), guidWord( 6 ), guidWord( 7 ), guidWord( 8 ),
+  0x80000000
+};
+
+struct Schedule
+{
+  uint32_t wk[80];
+};
+
+constexpr Schedule makeFinalChunkSchedule()
+{
+  Schedule s{};
+  s.wk[15] = acceptKeyMessageSize * 8;
+  sha1::extendSchedule( s.wk );
+  return s;
+}
+
+//! The whole of chunk 1's message schedule, round constants included.
+constexpr Schedule finalChunkSchedule{ makeFinalChunkSchedule() };
+
+void computeAcceptKey( const char key[ keySize ], char dst[ acceptKeySize ] )
+{
+  uint32_t h[5] = { sha1::initialHash[0]
+                  , sha1::initialHash[1]
+                  , sha1::initialHash[2]
+                  , sha1::initialHash[3]
+                  , sha1::initialHash[4] };
+
+  uint32_t wk[80];
+  const unsigned char* ukey{ (const unsigned char*)key };
+  for ( int i = 0; i < 6; ++i, ukey += 4 )
+  {
+    wk[i] = sha1::loadBigEndian( ukey );
+  }
+  for ( int i = 6; i < 16; ++i )
+  {
+    wk[i] = acceptKeyConstantWords[ i - 6 ];
+  }
+  sha1::extendSchedule( wk );
+  sha1::compress( h, wk );
+
+  sha1::compress( h, finalChunkSchedule.wk );
+
+  char digest[20];
+  sha1::storeDigest( h, digest );
+
+  base64::encode( digest, sizeof(digest), dst );
+}
+
+// Response pieces. Sizes below exclude the null terminators.
+const char responseStart[]
+{
+  "HTTP/1.1 101 Switching Protocols\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: Upgrade\r\n"
+  "Sec-WebSocket-Accept: "
+};
+const char responseProtocol[]{ "\r\nSec-WebSocket-Protocol: " };
+const char responseEnd[]{ "\r\n\r\n" };
+
+size_t encodedResponseSize( std::string_view protocol )
+{
+  size_t size{ sizeof(responseStart) - 1 + acceptKeySize + sizeof(responseEnd) - 1 };
+  if ( !protocol.empty() )
+  {
+    size += sizeof(responseProtocol) - 1 + protocol.size();
+  }
+  return size;
+}
+
+size_t encodeResponse( const Request& request
+                     , char* dst
+                     , std::string_view protocol )
+{
+  char* p{ dst };
+
+  std::memcpy( p, responseStart, sizeof(responseStart) - 1 );
+  p += sizeof(responseStart) - 1;
+
+  computeAcceptKey( request.key.data(), p );
+  p += acceptKeySize;
+
+  if ( !protocol.empty() )
+  {
+    std::memcpy( p, responseProtocol, sizeof(responseProtocol) - 1 );
+    p += sizeof(responseProtocol) - 1;
+    std::memcpy( p, protocol.data(), protocol.size() );
+    p += protocol.size();
+  }
+
+  std::memcpy( p, responseEnd, sizeof(responseEnd) - 1 );
+  p += sizeof(responseEnd) - 1;
+
+  return p - dst;
+}
+
+std::string_view errorResponse( ParseResult pr )
+{
+  switch ( pr )
+  {
+  case ParseResult::eSuccess:
+  case ParseResult::eIncomplete:
+    return {};
+  case ParseResult::eNotGet:
+    return "HTTP/1.1 405 Method Not Allowed\r\n"
+           "Allow: GET\r\n"
+           "Content-Length: 0\r\n"
+           "\r\n";
+  case ParseResult::eUnsupportedVersion:
+    return "HTTP/1.1 426 Upgrade Required\r\n"
+           "Sec-WebSocket-Version: 13\r\n"
+           "Content-Length: 0\r\n"
+           "\r\n";
+  case ParseResult::eMalformed:
+  case ParseResult::eMissingHost:
+  case ParseResult::eNotUpgrade:
+  case ParseResult::eNotConnectionUpgrade:
+  case ParseResult::eInvalidKey:
+    break;
+  }
+  return "HTTP/1.1 400 Bad Request\r\n"
+         "Content-Length: 0\r\n"
+         "\r\n";
+}
+
+
+} // End of namespace handshake
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
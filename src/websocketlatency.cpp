@@ -0,0 +1,97 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketlatency.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+// static
+uint64_t LatencyHistogram::highestValueIn( size_t index )
+{
+  const size_t numLinearBuckets{ size_t( 1 ) << subBucketBits };
+  if ( index < numLinearBuckets )
+  {
+    return index;
+  }
+  const int shift{ int( index >> ( subBucketBits - 1 ) ) - 1 };
+  const uint64_t subBucket{ index - ( size_t( shift ) << ( subBucketBits - 1 ) ) };
+  // Wraps to the maximum for the very last bucket.
+  return ( ( subBucket + 1 ) << shift ) - 1;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile( double percent ) const
+{
+  if ( numValues == 0 )
+  {
+    return 0;
+  }
+
+  const double fraction{ std::clamp( percent, 0.0, 100.0 ) / 100.0 };
+  const uint64_t rank{ std::max<uint64_t>( 1, uint64_t( std::ceil( fraction * numValues ) ) ) };
+
+  uint64_t numSeen{ 0 };
+  for ( size_t i = 0; i < numBuckets; ++i )
+  {
+    numSeen += counts[i];
+    if ( numSeen >= rank )
+    {
+      return std::min( highestValueIn( i ), max );
+    }
+  }
+  return max;
+}
+
+LatencyHistogram& LatencyHistogram::operator+=( const LatencyHistogram& rhs )
+{
+  for ( size_t i = 0; i < numBuckets; ++i )
+  {
+    counts[i] += rhs.counts[i];
+  }
+  numValues += rhs.numValues;
+  sum += rhs.sum;
+  min = std::min( min, rhs.min );
+  max = std::max( max, rhs.max );
+  return *this;
+}
+
+void LatencyHistogram::reset()
+{
+  *this = LatencyHistogram{};
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
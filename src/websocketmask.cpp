@@ -0,0 +1,273 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketmask.h>
+
+#include <cerrno>
+#include <stdexcept>
+
+#include <pthread.h>
+#include <sys/random.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+// Take a new key from the kernel after this much output.
+const uint64_t reseedIntervalBytes{ 4 << 20 };
+
+// The ChaCha20 block function is run on this many blocks at once, one per
+// lane of a vector, which GCC maps onto SSE2/NEON registers.
+const int numLanes{ 4 };
+typedef uint32_t ChaChaVector __attribute__(( vector_size( 4 * numLanes ) ));
+
+// "expand 32-byte k"
+const uint32_t chachaConstants[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+
+
+// Initialised as the library is loaded.
+const bool MaskGenerator::isForkHandlerRegistered
+{ pthread_atfork( nullptr, nullptr, [](){ ++numForks; } ) == 0 };
+
+unsigned MaskGenerator::numForks{ 0 };
+
+
+namespace
+{
+
+
+void fillFromKernel( uint8_t* dst, size_t numBytes )
+{
+  while ( numBytes > 0 )
+  {
+    const ssize_t n{ getrandom( dst, numBytes, 0 ) };
+    if ( n < 0 )
+    {
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+      throw std::runtime_error{ "Failed to seed mask generator. getrandom failed." };
+    }
+    dst      += n;
+    numBytes -= n;
+  }
+}
+
+uint32_t loadLittleEndian( const uint8_t* p )
+{
+  return   uint32_t( p[0] )
+       | ( uint32_t( p[1] ) <<  8 )
+       | ( uint32_t( p[2] ) << 16 )
+       | ( uint32_t( p[3] ) << 24 );
+}
+
+void storeLittleEndian( uint32_t x, uint8_t* p )
+{
+  p[0] =   x         & 0xFF;
+  p[1] = ( x >>  8 ) & 0xFF;
+  p[2] = ( x >> 16 ) & 0xFF;
+  p[3] = ( x >> 24 ) & 0xFF;
+}
+
+inline ChaChaVector rotateLeft( ChaChaVector x, int n )
+{
+  return ( x << n ) | ( x >> ( 32 - n ) );
+}
+
+inline void quarterRound( ChaChaVector& a, ChaChaVector& b, ChaChaVector& c, ChaChaVector& d )
+{
+  a += b; d ^= a; d = rotateLeft( d, 16 );
+  c += d; b ^= c; b = rotateLeft( b, 12 );
+  a += b; d ^= a; d = rotateLeft( d,  8 );
+  c += d; b ^= c; b = rotateLeft( b,  7 );
+}
+
+/** \brief ChaCha20 (RFC 8439) keystream blocks \a counter to \a counter + 3
+           with a zero nonce, written to \a dst. */
+void chachaBlocks( const uint32_t key[8], uint32_t counter, uint8_t dst[64 * numLanes] )
+{
+  ChaChaVector input[16];
+  for ( int i = 0; i < 4; ++i )
+  {
+    input[i] = ChaChaVector{} + chachaConstants[i];
+  }
+  for ( int i = 0; i < 8; ++i )
+  {
+    input[4 + i] = ChaChaVector{} + key[i];
+  }
+  input[12] = ChaChaVector{ 0, 1, 2, 3 } + counter;
+  input[13] = ChaChaVector{};
+  input[14] = ChaChaVector{};
+  input[15] = ChaChaVector{};
+
+  ChaChaVector x[16];
+  for ( int i = 0; i < 16; ++i )
+  {
+    x[i] = input[i];
+  }
+
+  for ( int i = 0; i < 10; ++i )
+  {
+    // Column rounds
+    quarterRound( x[0], x[4], x[ 8], x[12] );
+    quarterRound( x[1], x[5], x[ 9], x[13] );
+    quarterRound( x[2], x[6], x[10], x[14] );
+    quarterRound( x[3], x[7], x[11], x[15] );
+    // Diagonal rounds
+    quarterRound( x[0], x[5], x[10], x[15] );
+    quarterRound( x[1], x[6], x[11], x[12] );
+    quarterRound( x[2], x[7], x[ 8], x[13] );
+    quarterRound( x[3], x[4], x[ 9], x[14] );
+  }
+
+  for ( int i = 0; i < 16; ++i )
+  {
+    x[i] += input[i];
+  }
+
+  for ( int lane = 0; lane < numLanes; ++lane )
+  {
+    for ( int i = 0; i < 16; ++i )
+    {
+      storeLittleEndian( x[i][lane], dst + 64 * lane + 4 * i );
+    }
+  }
+}
+
+
+} // End of anonymous namespace
+
+
+MaskGenerator::MaskGenerator()
+  : forkGeneration{ numForks }
+  , isSystemSeeded{ true }
+{
+  uint8_t seed[keySize];
+  fillFromKernel( seed, keySize );
+  for ( int i = 0; i < 8; ++i )
+  {
+    key[i] = loadLittleEndian( seed + 4 * i );
+  }
+  explicit_bzero( seed, keySize );
+}
+
+MaskGenerator::MaskGenerator( const uint8_t seed[keySize] )
+  : forkGeneration{ numForks }
+  , isSystemSeeded{ false }
+{
+  for ( int i = 0; i < 8; ++i )
+  {
+    key[i] = loadLittleEndian( seed + 4 * i );
+  }
+}
+
+MaskGenerator::~MaskGenerator()
+{
+  explicit_bzero( key, sizeof(key) );
+  explicit_bzero( buffer, sizeof(buffer) );
+}
+
+void MaskGenerator::refill()
+{
+  if ( isSystemSeeded
+    && ( forkGeneration != numForks || numBytesSinceSeed >= reseedIntervalBytes ) )
+  {
+    uint8_t seed[keySize];
+    fillFromKernel( seed, keySize );
+    for ( int i = 0; i < 8; ++i )
+    {
+      key[i] = loadLittleEndian( seed + 4 * i );
+    }
+    explicit_bzero( seed, keySize );
+    numBytesSinceSeed = 0;
+  }
+  forkGeneration = numForks;
+
+  // Every key is used for exactly one refill so the nonce and counter can
+  // always start from zero.
+  for ( size_t block = 0; block < bufferSize / 64; block += numLanes )
+  {
+    chachaBlocks( key, block, buffer + 64 * block );
+  }
+
+  // Fast key erasure: the start of the output becomes the next key.
+  for ( int i = 0; i < 8; ++i )
+  {
+    key[i] = loadLittleEndian( buffer + 4 * i );
+  }
+  std::memset( buffer, 0, keySize );
+
+  numAvailable = bufferSize - keySize;
+  numBytesSinceSeed += numAvailable;
+}
+
+
+namespace
+{
+
+
+// Constructing a thread_local object on first use puts a guard check, and in
+// a shared library a call to __tls_get_addr, on every access. Going through a
+// trivially initialised pointer in the static TLS block avoids both, see
+// generateMask() for what that costs.
+thread_local MaskGenerator* threadGenerator __attribute__(( tls_model( "initial-exec" ) )){ nullptr };
+
+MaskGenerator* createThreadGenerator()
+{
+  thread_local MaskGenerator generator;
+  threadGenerator = &generator;
+  return threadGenerator;
+}
+
+
+} // End of anonymous namespace
+
+
+void generateMask( uint8_t mask[4] )
+{
+  MaskGenerator* generator{ threadGenerator };
+  if ( !generator )
+  {
+    generator = createThreadGenerator();
+  }
+  generator->next( mask );
+}
+
+void setRandomMask( Header& header )
+{
+  header.isMasked = true;
+  generateMask( header.mask );
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
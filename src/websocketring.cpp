@@ -0,0 +1,151 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketring.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+namespace
+{
+
+
+size_t checkNumSlots( size_t numSlots )
+{
+  if ( numSlots == 0 || ( numSlots & ( numSlots - 1 ) ) != 0 )
+  {
+    throw std::invalid_argument( "FrameRing number of slots must be a power of two" );
+  }
+  return numSlots;
+}
+
+size_t checkArenaSize( size_t arenaSize )
+{
+  if ( arenaSize == 0 )
+  {
+    throw std::invalid_argument( "FrameRing arena size must be non-zero" );
+  }
+  return arenaSize;
+}
+
+
+} // End of anonymous namespace
+
+
+FrameRing::FrameRing( size_t numSlots, size_t arenaSize )
+  : slotMask{ checkNumSlots( numSlots ) - 1 }
+  , arenaSize{ checkArenaSize( arenaSize ) }
+  , slots{ new Slot[ numSlots ] }
+  , arena{ new char[ arenaSize ] }
+{
+}
+
+FrameRing::Slot* FrameRing::claim( size_t numPayloadBytes )
+{
+  const uint64_t index{ producer.writeIndex.load( std::memory_order_relaxed ) };
+  if ( index - producer.cachedReadIndex > slotMask )
+  {
+    producer.cachedReadIndex = consumer.readIndex.load( std::memory_order_acquire );
+    if ( index - producer.cachedReadIndex > slotMask )
+    {
+      return nullptr;
+    }
+  }
+
+  // Payloads are contiguous so one that would wrap starts at the beginning.
+  uint64_t start{ producer.arenaWritten };
+  const size_t offset{ size_t( start % arenaSize ) };
+  if ( offset + numPayloadBytes > arenaSize )
+  {
+    start += arenaSize - offset;
+  }
+  const uint64_t end{ start + numPayloadBytes };
+  if ( end - producer.cachedArenaReleased > arenaSize )
+  {
+    producer.cachedArenaReleased = consumer.arenaReleased.load( std::memory_order_acquire );
+    if ( end - producer.cachedArenaReleased > arenaSize )
+    {
+      return nullptr;
+    }
+  }
+
+  Slot& slot{ slots[ index & slotMask ] };
+  slot.payload = arena.get() + start % arenaSize;
+  slot.arenaEnd = end;
+  return &slot;
+}
+
+bool FrameRing::tryPush( const FrameView& view )
+{
+  const size_t numPayloadBytes( view.header.payloadSize );
+  Slot* slot{ claim( numPayloadBytes ) };
+  if ( !slot )
+  {
+    return false;
+  }
+
+  if ( view.header.isMasked )
+  {
+    decodeMaskedPayload( view.payload, numPayloadBytes, view.header.mask, slot->payload );
+  }
+  else if ( numPayloadBytes > 0 )
+  {
+    std::memcpy( slot->payload, view.payload, numPayloadBytes );
+  }
+  slot->header = view.header;
+  slot->firstByteTime = view.firstByteTime;
+
+  producer.arenaWritten = slot->arenaEnd;
+  producer.writeIndex.store( producer.writeIndex.load( std::memory_order_relaxed ) + 1
+                           , std::memory_order_release );
+  return true;
+}
+
+void FrameRing::push( const FrameView& view )
+{
+  if ( view.header.payloadSize > maxPayloadSize() )
+  {
+    throw std::length_error( "FrameRing payload bigger than half the arena" );
+  }
+  while ( !tryPush( view ) )
+  {
+    std::this_thread::yield();
+  }
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
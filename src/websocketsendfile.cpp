@@ -0,0 +1,151 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websocketsendfile.h>
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+// Linux transfers at most this many bytes in a single sendfile call.
+const size_t maxSendfileBytes{ 0x7FFFF000 };
+
+
+FileSender::FileSender( int fileFd
+                      , off_t offset
+                      , uint64_t numBytes
+                      , Header::OpCode opCode
+                      , size_t maxFramePayloadSize )
+  : fileFd{ fileFd }
+  , offset{ offset }
+  , numPayloadBytesRemaining{ numBytes }
+  , opCode{ opCode }
+  , maxFramePayloadSize{ std::max<size_t>( maxFramePayloadSize, 1 ) }
+{
+}
+
+// static
+std::string FileSender::toString( Status status )
+{
+  switch ( status )
+  {
+  case Status::eComplete:
+    return "Complete";
+  case Status::eWouldBlock:
+    return "WouldBlock";
+  case Status::eError:
+    return "Error";
+  }
+  return "Unknown";
+}
+
+void FileSender::startNextFrame()
+{
+  Header header;
+  header.opCode = isFirstFrame ? opCode : Header::OpCode::eContinuation;
+  header.payloadSize = std::min<uint64_t>( numPayloadBytesRemaining, maxFramePayloadSize );
+  header.fin = ( header.payloadSize == numPayloadBytesRemaining );
+  header.encode( headerBytes );
+
+  numHeaderBytes = header.encodedSizeInBytes();
+  numHeaderBytesSent = 0;
+  numFrameBytesRemaining = header.payloadSize;
+  isFirstFrame = false;
+  isFinalFrame = header.fin;
+}
+
+FileSender::Status FileSender::send( int socketFd )
+{
+  while ( true )
+  {
+    if ( numHeaderBytesSent < numHeaderBytes )
+    {
+      // Tell the kernel more is coming so that the header does not go out in
+      // a segment of its own ahead of the payload.
+      const int flags{ MSG_NOSIGNAL | ( numFrameBytesRemaining > 0 ? MSG_MORE : 0 ) };
+      const ssize_t n{ ::send( socketFd
+                             , headerBytes + numHeaderBytesSent
+                             , numHeaderBytes - numHeaderBytesSent
+                             , flags ) };
+      if ( n < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return ( errno == EAGAIN || errno == EWOULDBLOCK ) ? Status::eWouldBlock
+                                                           : Status::eError;
+      }
+      numHeaderBytesSent += n;
+    }
+    else if ( numFrameBytesRemaining > 0 )
+    {
+      const size_t count{ std::min<uint64_t>( numFrameBytesRemaining, maxSendfileBytes ) };
+      const ssize_t n{ ::sendfile( socketFd, fileFd, &offset, count ) };
+      if ( n < 0 )
+      {
+        if ( errno == EINTR )
+        {
+          continue;
+        }
+        return ( errno == EAGAIN || errno == EWOULDBLOCK ) ? Status::eWouldBlock
+                                                           : Status::eError;
+      }
+      if ( n == 0 )
+      {
+        // End of file reached before the promised number of bytes. The header
+        // has already gone out so the connection is beyond saving.
+        errno = ENODATA;
+        return Status::eError;
+      }
+      numFrameBytesRemaining   -= n;
+      numPayloadBytesRemaining -= n;
+    }
+    else if ( isFinalFrame )
+    {
+      return Status::eComplete;
+    }
+    else
+    {
+      startNextFrame();
+    }
+  }
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb
@@ -0,0 +1,410 @@
+/*
+    Copyright (C) 2023  Paul Fotheringham (LinuxBrickie)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <lb/encoding/websockettable.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+
+namespace lb
+{
+
+
+namespace encoding
+{
+
+
+namespace websocket
+{
+
+
+// Bits of DecoderTable::headerFlags.
+enum : uint8_t
+{
+  headerFlagFin      = 0x01,
+  headerFlagRsv1     = 0x02,
+  headerFlagRsv2     = 0x04,
+  headerFlagRsv3     = 0x08,
+  headerFlagIsMasked = 0x10
+};
+
+template< class T >
+size_t columnBytes( const std::vector<T>& column )
+{
+  return column.capacity() * sizeof( T );
+}
+
+
+DecoderTable::DecoderTable( size_t numConnectionsReserved )
+{
+  states.reserve( numConnectionsReserved );
+  numHeaderBytes.reserve( numConnectionsReserved );
+  headerBytes.reserve( numConnectionsReserved );
+  headerFlags.reserve( numConnectionsReserved );
+  opCodes.reserve( numConnectionsReserved );
+  payloadSizes.reserve( numConnectionsReserved );
+  masks.reserve( numConnectionsReserved );
+  payloadBuffers.reserve( numConnectionsReserved );
+}
+
+DecoderTable::Id DecoderTable::add()
+{
+  ++numConnections;
+
+  if ( !freeIds.empty() )
+  {
+    const Id id{ freeIds.back() };
+    freeIds.pop_back();
+    states[ id ] = uint8_t( State::eNothing );
+    return id;
+  }
+
+  const Id id( states.size() );
+  states.push_back( uint8_t( State::eNothing ) );
+  numHeaderBytes.push_back( 0 );
+  headerBytes.emplace_back();
+  headerFlags.push_back( 0 );
+  opCodes.push_back( 0 );
+  payloadSizes.push_back( 0 );
+  masks.emplace_back();
+  payloadBuffers.push_back( noBuffer );
+  return id;
+}
+
+void DecoderTable::remove( Id id )
+{
+  reset( id );
+  states[ id ] = uint8_t( State::eFree );
+  freeIds.push_back( id );
+  --numConnections;
+}
+
+Header DecoderTable::loadHeader( Id id ) const
+{
+  Header header;
+  const uint8_t flags{ headerFlags[ id ] };
+  header.fin      = flags & headerFlagFin;
+  header.rsv1     = flags & headerFlagRsv1;
+  header.rsv2     = flags & headerFlagRsv2;
+  header.rsv3     = flags & headerFlagRsv3;
+  header.isMasked = flags & headerFlagIsMasked;
+  header.opCode = Header::OpCode( opCodes[ id ] );
+  header.payloadSize = payloadSizes[ id ];
+  std::memcpy( header.mask, masks[ id ].data(), 4 );
+  return header;
+}
+
+void DecoderTable::storeHeader( Id id, const Header& header )
+{
+  headerFlags[ id ] = ( header.fin      ? headerFlagFin      : 0 )
+                    | ( header.rsv1     ? headerFlagRsv1     : 0 )
+                    | ( header.rsv2     ? headerFlagRsv2     : 0 )
+                    | ( header.rsv3     ? headerFlagRsv3     : 0 )
+                    | ( header.isMasked ? headerFlagIsMasked : 0 );
+  opCodes[ id ] = uint8_t( header.opCode );
+  payloadSizes[ id ] = header.payloadSize;
+  std::memcpy( masks[ id ].data(), header.mask, 4 );
+}
+
+uint32_t DecoderTable::acquireBuffer()
+{
+  if ( !freeBuffers.empty() )
+  {
+    const uint32_t buffer{ freeBuffers.back() };
+    freeBuffers.pop_back();
+    return buffer;
+  }
+  bufferPool.emplace_back();
+  return uint32_t( bufferPool.size() - 1 );
+}
+
+void DecoderTable::releaseBuffer( uint32_t buffer )
+{
+  bufferPool[ buffer ].clear();
+  freeBuffers.push_back( buffer );
+}
+
+Decoder::Step DecoderTable::decodeNextView( Id id, const char*& src, size_t& numSrcBytes, FrameView& view )
+{
+  if ( spentBuffer != noBuffer )
+  {
+    releaseBuffer( spentBuffer );
+    spentBuffer = noBuffer;
+  }
+
+  // Decoding would quietly bring a removed connection back to life.
+  if ( id >= states.size() || State( states[ id ] ) == State::eFree )
+  {
+    assert( !"DecoderTable::decodeNextView with an id not in use" );
+    return Decoder::Step::eParseError;
+  }
+
+  if ( numSrcBytes == 0 )
+  {
+    return Decoder::Step::eNeedMore;
+  }
+
+  Header header;
+
+  switch ( State( states[ id ] ) )
+  {
+  case State::eFree: // Refused above
+    return Decoder::Step::eParseError;
+
+  case State::eNothing:
+    switch ( header.decode( src, numSrcBytes ) )
+    {
+    case Header::DecodeResult::eSuccess:
+      src         += header.encodedSizeInBytes();
+      numSrcBytes -= header.encodedSizeInBytes();
+      break;
+    case Header::DecodeResult::eIncomplete:
+      std::memcpy( headerBytes[ id ].data(), src, numSrcBytes );
+      numHeaderBytes[ id ] = uint8_t( numSrcBytes );
+      states[ id ] = uint8_t( State::ePartialHeader );
+      src += numSrcBytes;
+      numSrcBytes = 0;
+      return Decoder::Step::eNeedMore;
+    default:
+      return Decoder::Step::eParseError;
+    }
+    break;
+
+  case State::ePartialHeader:
+  {
+    // As Decoder, top up the cached header bytes and decode from there.
+    const size_t numCached{ numHeaderBytes[ id ] };
+    const size_t numTaken{ std::min( numSrcBytes, Header::maxSizeInBytes - numCached ) };
+    std::memcpy( headerBytes[ id ].data() + numCached, src, numTaken );
+    switch ( header.decode( headerBytes[ id ].data(), numCached + numTaken ) )
+    {
+    case Header::DecodeResult::eSuccess:
+    {
+      const size_t numUsed{ header.encodedSizeInBytes() - numCached };
+      src         += numUsed;
+      numSrcBytes -= numUsed;
+      numHeaderBytes[ id ] = 0;
+      break;
+    }
+    case Header::DecodeResult::eIncomplete:
+      numHeaderBytes[ id ] = uint8_t( numCached + numTaken );
+      src         += numTaken;
+      numSrcBytes -= numTaken;
+      return Decoder::Step::eNeedMore;
+    default:
+      return Decoder::Step::eParseError;
+    }
+    break;
+  }
+
+  case State::ePartialPayload:
+  {
+    header = loadHeader( id );
+    std::vector<char>& cached{ bufferPool[ payloadBuffers[ id ] ] };
+    const size_t numTaken( std::min<uint64_t>( numSrcBytes, header.payloadSize - cached.size() ) );
+    cached.insert( cached.end(), src, src + numTaken );
+    src         += numTaken;
+    numSrcBytes -= numTaken;
+    if ( cached.size() < header.payloadSize )
+    {
+      return Decoder::Step::eNeedMore;
+    }
+    view.header = header;
+    view.payload = cached.data();
+    view.firstByteTime = {};
+    spentBuffer = std::exchange( payloadBuffers[ id ], noBuffer );
+    states[ id ] = uint8_t( State::eNothing );
+    return Decoder::Step::eFrame;
+  }
+  }
+
+  if ( numSrcBytes < header.payloadSize )
+  {
+    storeHeader( id, header );
+    const uint32_t buffer{ acquireBuffer() };
+    bufferPool[ buffer ].assign( src, src + numSrcBytes );
+    payloadBuffers[ id ] = buffer;
+    states[ id ] = uint8_t( State::ePartialPayload );
+    src += numSrcBytes;
+    numSrcBytes = 0;
+    return Decoder::Step::eNeedMore;
+  }
+
+  view.header = header;
+  view.payload = src;
+  view.firstByteTime = {};
+  src         += header.payloadSize;
+  numSrcBytes -= header.payloadSize;
+  states[ id ] = uint8_t( State::eNothing );
+  return Decoder::Step::eFrame;
+}
+
+Decoder::Result DecoderTable::decode( Id id, const char* src, size_t numSrcBytes )
+{
+  Decoder::Result result;
+  FrameView view;
+
+  while ( true )
+  {
+    switch ( decodeNextView( id, src, numSrcBytes, view ) )
+    {
+    case Decoder::Step::eFrame:
+    {
+      Frame& frame{ result.frames.emplace_back() };
+      frame.header = view.header;
+      if ( view.header.isMasked )
+      {
+        frame.payload.resize( view.header.payloadSize );
+        decodeMaskedPayload( view.payload, view.header.payloadSize, view.header.mask, frame.payload.data() );
+      }
+      else
+      {
+        frame.payload.assign( view.payload, view.header.payloadSize );
+      }
+      break;
+    }
+    case Decoder::Step::eNeedMore:
+      result.numExtra = numCachedBytes( id );
+      return result;
+    case Decoder::Step::eParseError:
+      result.parseError = true;
+      result.numExtra = numSrcBytes;
+      return result;
+    }
+  }
+}
+
+void DecoderTable::decode( const std::vector<Job>& jobs, std::vector<Decoder::Result>& results )
+{
+  results.resize( jobs.size() );
+  for ( size_t i = 0; i < jobs.size(); ++i )
+  {
+    results[ i ] = decode( jobs[ i ].id, jobs[ i ].src, jobs[ i ].numSrcBytes );
+  }
+}
+
+size_t DecoderTable::numCachedBytes( Id id ) const
+{
+  switch ( State( states[ id ] ) )
+  {
+  case State::ePartialHeader:
+    return numHeaderBytes[ id ];
+  case State::ePartialPayload:
+    return bufferPool[ payloadBuffers[ id ] ].size();
+  default:
+    return 0;
+  }
+}
+
+void DecoderTable::reset( Id id )
+{
+  if ( payloadBuffers[ id ] != noBuffer )
+  {
+    releaseBuffer( std::exchange( payloadBuffers[ id ], noBuffer ) );
+  }
+  numHeaderBytes[ id ] = 0;
+  if ( states[ id ] != uint8_t( State::eFree ) )
+  {
+    states[ id ] = uint8_t( State::eNothing );
+  }
+}
+
+void DecoderTable::reset( const std::vector<Id>& ids )
+{
+  for ( Id id : ids )
+  {
+    reset( id );
+  }
+}
+
+void DecoderTable::move( Id from, Id to )
+{
+  states[ to ]         = std::exchange( states[ from ], uint8_t( State::eFree ) );
+  numHeaderBytes[ to ] = numHeaderBytes[ from ];
+  headerBytes[ to ]    = headerBytes[ from ];
+  headerFlags[ to ]    = headerFlags[ from ];
+  opCodes[ to ]        = opCodes[ from ];
+  payloadSizes[ to ]   = payloadSizes[ from ];
+  masks[ to ]          = masks[ from ];
+  payloadBuffers[ to ] = std::exchange( payloadBuffers[ from ], noBuffer );
+}
+
+void DecoderTable::shrink()
+{
+  freeIds.clear();
+  freeIds.shrink_to_fit();
+
+  states.resize( numConnections );
+  numHeaderBytes.resize( numConnections );
+  headerBytes.resize( numConnections );
+  headerFlags.resize( numConnections );
+  opCodes.resize( numConnections );
+  payloadSizes.resize( numConnections );
+  masks.resize( numConnections );
+  payloadBuffers.resize( numConnections );
+
+  states.shrink_to_fit();
+  numHeaderBytes.shrink_to_fit();
+  headerBytes.shrink_to_fit();
+  headerFlags.shrink_to_fit();
+  opCodes.shrink_to_fit();
+  payloadSizes.shrink_to_fit();
+  masks.shrink_to_fit();
+  payloadBuffers.shrink_to_fit();
+
+  // Pooled buffers not holding a pending payload give their memory back.
+  if ( spentBuffer != noBuffer )
+  {
+    releaseBuffer( std::exchange( spentBuffer, noBuffer ) );
+  }
+  for ( uint32_t buffer : freeBuffers )
+  {
+    std::vector<char>().swap( bufferPool[ buffer ] );
+  }
+}
+
+size_t DecoderTable::memoryUsage() const
+{
+  size_t numBytes{ columnBytes( freeIds )
+                 + columnBytes( states )
+                 + columnBytes( numHeaderBytes )
+                 + columnBytes( headerBytes )
+                 + columnBytes( headerFlags )
+                 + columnBytes( opCodes )
+                 + columnBytes( payloadSizes )
+                 + columnBytes( masks )
+                 + columnBytes( payloadBuffers )
+                 + columnBytes( bufferPool )
+                 + columnBytes( freeBuffers ) };
+  for ( const auto& buffer : bufferPool )
+  {
+    numBytes += buffer.capacity();
+  }
+  return numBytes;
+}
+
+
+} // End of namespace websocket
+
+
+} // End of namespace encoding
+
+
+} // End of namespace lb